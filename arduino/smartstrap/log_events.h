@@ -0,0 +1,31 @@
+#pragma once
+
+// Every debug log event of the sketch, as STRAP_LOG_EVENT(id, format). Only the IDs are compiled
+// in; the formats are for host/tools/binlog_decode -a, which fills in the record's two arguments:
+//  %d decimal, %x hex, %a strap attribute name
+// Append new events at the end, so captures from older sketches still decode.
+
+#define STRAP_LOG_EVENTS \
+  STRAP_LOG_EVENT(StrapLogBoot, "Booted") \
+  STRAP_LOG_EVENT(StrapLogRead, "Read of %a") \
+  STRAP_LOG_EVENT(StrapLogWrite, "Write of %a, %d bytes") \
+  STRAP_LOG_EVENT(StrapLogUnexpectedType, "Request for %a of unexpected type %d") \
+  STRAP_LOG_EVENT(StrapLogUnexpectedLength, "Write of %a of unexpected length %d") \
+  STRAP_LOG_EVENT(StrapLogUnknownAttribute, "Write of unknown attribute %x refused") \
+  STRAP_LOG_EVENT(StrapLogLocalRoutes, "Took over %d routes from the watch") \
+  STRAP_LOG_EVENT(StrapLogAdcOverrun, "Lost %d input sample sets, loop() fell behind")
+
+#define STRAP_LOG_EVENT(id, format) id,
+enum {
+  STRAP_LOG_EVENTS
+};
+#undef STRAP_LOG_EVENT
+
+// Record layout, little endian:
+//  [0] STRAP_LOG_SYNC
+//  [1] event
+//  [2..3] millis(), low 16 bits
+//  [4..5] first argument
+//  [6..7] second argument
+#define STRAP_LOG_SYNC 0xb1
+#define STRAP_LOG_RECORD_LENGTH 8
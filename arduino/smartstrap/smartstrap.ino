@@ -1,6 +1,29 @@
 #include <Arduino.h>
 #include <ArduinoPebbleSerial.h>
 
+#include "log_events.h"
+
+// Debug log on the USB serial port, as 8-byte binary records for host/tools/binlog_decode -a
+// rather than formatted lines: a record fits the serial transmit buffer, so logging a request
+// does not wait for the USB host. Levels above LOG_LEVEL compile to nothing. On the littleBits
+// Arduino (ATmega32U4) Serial is USB CDC; pins 0 and 1, the top input and output, belong to
+// Serial1, which the sketch never opens, so logging leaves them alone.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_DEBUG 2
+#define LOG_LEVEL LOG_LEVEL_NONE
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(event, a, b) log_event(event, a, b)
+#else
+#define LOG_ERROR(event, a, b)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(event, a, b) log_event(event, a, b)
+#else
+#define LOG_DEBUG(event, a, b)
+#endif
+
 static const uint16_t SERVICE_ID = 0x1001;
 
 static const uint16_t TOP_INPUT_ATTRIBUTE_ID = 0x0001;
@@ -9,12 +32,95 @@ static const uint16_t CENTER_INPUT_ATTRIBUTE_ID = 0x0003;
 static const uint16_t CENTER_OUTPUT_ATTRIBUTE_ID = 0x0004;
 static const uint16_t BOTTOM_INPUT_ATTRIBUTE_ID = 0x0005;
 static const uint16_t BOTTOM_OUTPUT_ATTRIBUTE_ID = 0x0006;
+static const uint16_t ALL_INPUTS_ATTRIBUTE_ID = 0x0007;
+static const uint16_t ALL_OUTPUTS_ATTRIBUTE_ID = 0x0008;
+static const uint16_t STREAM_ATTRIBUTE_ID = 0x0009;
+static const uint16_t STREAM_CONFIG_ATTRIBUTE_ID = 0x000A;
+static const uint16_t NOTIFY_CONFIG_ATTRIBUTE_ID = 0x000B;
+static const uint16_t LOCAL_ROUTES_ATTRIBUTE_ID = 0x000C;
 
 // Analog input is 0-1024.
 // Inputs are mapped to 0-255.
 static const size_t INPUT_ATTRIBUTE_LENGTH = 1;
 static const size_t OUTPUT_ATTRIBUTE_LENGTH = 1;
 
+// All inputs in one frame, little endian:
+// top, center, bottom, uint16 sequence, uint32 millis() of the notify.
+static const size_t ALL_INPUTS_ATTRIBUTE_LENGTH = 9;
+
+// Several outputs in one write, acknowledged once:
+// mask (bit 0 top, bit 1 center, bit 2 bottom), then top, center, bottom values.
+static const size_t ALL_OUTPUTS_ATTRIBUTE_LENGTH = 4;
+static const uint8_t TOP_OUTPUT_MASK = 1 << 0;
+static const uint8_t CENTER_OUTPUT_MASK = 1 << 1;
+static const uint8_t BOTTOM_OUTPUT_MASK = 1 << 2;
+
+// Streaming mode samples every input at a fixed period and delivers the samples in blocks:
+// uint16 block sequence, sample count, samples lost to overflow since the last block,
+// then top, center, bottom for each sample.
+static const size_t STREAM_HEADER_LENGTH = 4;
+static const size_t STREAM_SAMPLE_LENGTH = 3;
+static const uint8_t STREAM_MAX_SAMPLES = 16;
+static const size_t STREAM_ATTRIBUTE_LENGTH = STREAM_HEADER_LENGTH + STREAM_SAMPLE_LENGTH * STREAM_MAX_SAMPLES;
+
+// Written by the watch: sample period in milliseconds (0 turns streaming off), samples per block.
+static const size_t STREAM_CONFIG_ATTRIBUTE_LENGTH = 2;
+
+// Samples waiting to be read. Must be a power of two that divides 256.
+static const uint8_t STREAM_RING_SIZE = 64;
+// Notify again if the watch has not read the last block by then.
+static const uint32_t STREAM_RENOTIFY_MILLISECONDS = 100;
+
+// Written by the watch, little endian. For each of top, center and bottom:
+// deadband, uint16 minimum interval between notifies in milliseconds,
+// uint16 maximum interval after which a change inside the deadband is still notified (0 never).
+// Then notifies per second on average (0 unlimited) and notifies allowed in a burst.
+static const size_t NOTIFY_CONFIG_ATTRIBUTE_LENGTH = 17;
+static const size_t NOTIFY_SCHEDULE_LENGTH = 5;
+
+// Routes the sketch runs by itself once the watch stops driving the outputs. Written by the watch,
+// little endian: uint16 lease in milliseconds during which routing is left to the watch (0 hands
+// it over straight away), number of routes, then for each route: input mask, output mask,
+// combine (0 max, 1 min), transform type, threshold, high threshold, binary, steps,
+// signed steepness in tenths, int16 gain in sixteenths, int16 offset.
+static const size_t LOCAL_ROUTES_HEADER_LENGTH = 3;
+static const size_t LOCAL_ROUTE_LENGTH = 13;
+static const uint8_t LOCAL_ROUTES_MAX = 8;
+static const size_t LOCAL_ROUTES_ATTRIBUTE_LENGTH = LOCAL_ROUTES_HEADER_LENGTH + LOCAL_ROUTE_LENGTH * LOCAL_ROUTES_MAX;
+
+// Transform types, numbered as in pebble/src/strap/router.h.
+static const uint8_t TRANSFORM_INVERT = 1;
+static const uint8_t TRANSFORM_GATE = 2;
+static const uint8_t TRANSFORM_GAIN_OFFSET = 3;
+static const uint8_t TRANSFORM_CURVE = 4;
+static const uint8_t TRANSFORM_HYSTERESIS = 5;
+static const uint8_t TRANSFORM_QUANTIZE = 6;
+// The watch bends the curve exponentially; here it is a parabola, fully bent from this steepness.
+static const uint8_t CURVE_FULL_STEEPNESS = 30;
+
+// Inputs are indexed top, center, bottom.
+static const uint8_t NUM_INPUTS = 3;
+static const uint8_t TOP_INPUT = 0;
+static const uint8_t CENTER_INPUT = 1;
+static const uint8_t BOTTOM_INPUT = 2;
+
+// Token bucket pacing all notifies, in thousandths of a notify.
+static const uint32_t NOTIFY_TOKEN = 1000;
+
+// Analog inputs are filtered before change detection, in 16 bit fixed point:
+// the 10 bit ADC reading shifted left by FILTER_FIXED_SHIFT.
+static const uint8_t FILTER_FIXED_SHIFT = 6;
+// Fixed point back to the 0-255 attribute value.
+static const uint8_t FILTER_OUTPUT_SHIFT = 8;
+static const uint8_t FILTER_MAX_MEDIAN_TAPS = 5;
+
+// Sample sets converted by the ADC interrupt and waiting for loop().
+// Must be a power of two that divides 256.
+static const uint8_t ADC_RING_SIZE = 16;
+// Timer0 compare match point, any value works: the interrupt fires once per Timer0
+// overflow (about 1 kHz) without disturbing millis().
+static const uint8_t ADC_TIMER_COMPARE = 128;
+
 static const uint16_t SERVICES[] = {SERVICE_ID};
 static const uint8_t NUM_SERVICES = 1;
 
@@ -30,17 +136,134 @@ static const uint8_t CENTER_OUTPUT_PIN = 5;
 static const uint8_t BOTTOM_INPUT_PIN = A1;
 static const uint8_t BOTTOM_OUTPUT_PIN = 9;
 
-static uint8_t last_top_value_notified;
-static uint8_t last_center_value_notified;
-static uint8_t last_bottom_value_notified;
+typedef struct {
+  uint8_t deadband;
+  uint16_t min_interval;
+  uint16_t max_interval;
+} NotifySchedule;
+
+typedef struct {
+  // 1 << oversample_shift readings are summed and decimated into one sample,
+  // up to FILTER_FIXED_SHIFT.
+  uint8_t oversample_shift;
+  // Odd number of samples of the median glitch filter, 1 skips it.
+  uint8_t median_taps;
+  // Exponential moving average weight of a new sample, 1 / (1 << ema_shift), 0 skips it.
+  uint8_t ema_shift;
+} FilterConfig;
+
+typedef struct {
+  uint16_t history[FILTER_MAX_MEDIAN_TAPS];
+  uint8_t history_next;
+  uint8_t history_count;
+  bool ema_primed;
+  uint16_t ema;
+} FilterState;
+
+typedef struct {
+  uint8_t inputs;
+  uint8_t outputs;
+  uint8_t combine;
+  uint8_t transform;
+  uint8_t threshold;
+  uint8_t threshold_high;
+  bool binary;
+  uint8_t steps;
+  int8_t steepness;
+  int16_t gain;
+  int16_t offset;
+} LocalRoute;
+
+// Indexed like the inputs. The top input is digital and is not filtered.
+static const FilterConfig FILTER_CONFIGS[NUM_INPUTS] = {
+  {0, 1, 0},
+  {2, 3, 2},
+  {2, 3, 2},
+};
+static FilterState filter_states[NUM_INPUTS];
+
+// One sample set per timer tick. The top input holds its final 0 or 255 value,
+// the analog inputs their oversampled readings in filter fixed point.
+typedef struct {
+  uint16_t values[NUM_INPUTS];
+} AdcSample;
+
+// Single producer (the ADC interrupt), single consumer (loop()) ring.
+// The free running 8 bit indices are written by one side each and read atomically,
+// so neither side ever disables interrupts.
+static volatile AdcSample adc_ring[ADC_RING_SIZE];
+static volatile uint8_t adc_head;
+static volatile uint8_t adc_tail;
+// Sample sets lost because loop() fell behind, free running like the indices.
+static volatile uint8_t adc_overrun;
+
+// Interrupt only state of the conversion burst in progress.
+static AdcSample adc_burst;
+static uint8_t adc_input;
+static uint8_t adc_conversions;
+static uint16_t adc_sum;
+static volatile bool adc_busy;
+
+// Latest filtered value of every input.
+static uint8_t input_values[NUM_INPUTS];
+
+static NotifySchedule notify_schedules[NUM_INPUTS];
+static uint8_t last_values_notified[NUM_INPUTS];
+static uint32_t notified_times[NUM_INPUTS];
+
+static uint8_t notify_rate;
+static uint8_t notify_burst;
+static uint32_t notify_tokens;
+static uint32_t notify_tokens_time;
+
+// Bumped on every notify so the watch can tell how many frames it missed.
+static uint16_t all_inputs_sequence;
+static uint32_t all_inputs_notified_time;
+
+static uint8_t stream_ring[STREAM_RING_SIZE][STREAM_SAMPLE_LENGTH];
+// Free running indices, wrapped with STREAM_RING_SIZE - 1.
+static uint8_t stream_head;
+static uint8_t stream_tail;
+static uint8_t stream_overflow;
+static uint16_t stream_sequence;
+static uint8_t stream_sample_period;
+static uint8_t stream_block_samples;
+static uint32_t stream_sample_time;
+static bool stream_notified;
+static uint32_t stream_notified_time;
+
+static LocalRoute local_routes[LOCAL_ROUTES_MAX];
+static uint8_t local_route_count;
+// Value each route last produced, held by the hysteresis transform.
+static uint8_t local_route_values[LOCAL_ROUTES_MAX];
+// Routing is left to the watch for local_lease milliseconds from local_lease_time.
+static uint32_t local_lease_time;
+static uint16_t local_lease;
+static bool local_routing;
+static uint8_t local_inputs[NUM_INPUTS];
 
 // Pebble tether is connected to this pin for software serial mode.
 static const uint8_t PEBBLE_DATA_PIN = 10;
-static uint8_t buffer[GET_PAYLOAD_BUFFER_SIZE(4)];
+static uint8_t buffer[GET_PAYLOAD_BUFFER_SIZE(
+    STREAM_ATTRIBUTE_LENGTH > LOCAL_ROUTES_ATTRIBUTE_LENGTH ? STREAM_ATTRIBUTE_LENGTH : LOCAL_ROUTES_ATTRIBUTE_LENGTH)];
+
+#if LOG_LEVEL > LOG_LEVEL_NONE
+void log_event(uint8_t event, uint16_t a, uint16_t b) {
+  const uint16_t now = millis();
+  const uint8_t record[STRAP_LOG_RECORD_LENGTH] = {
+    STRAP_LOG_SYNC, event, (uint8_t)now, (uint8_t)(now >> 8),
+    (uint8_t)a, (uint8_t)(a >> 8), (uint8_t)b, (uint8_t)(b >> 8),
+  };
+  Serial.write(record, sizeof(record));
+}
+#endif
 
 void setup() {
-  Serial.begin(9600);
-  Serial.println("Hello from Arduino at heart");
+#if LOG_LEVEL > LOG_LEVEL_NONE
+  // Nothing is written to the port without logging
+  Serial.begin(115200);
+#endif
+  LOG_DEBUG(StrapLogBoot, 0, 0);
   
   //setup light for "connected" indicator.
   pinMode(CONNECTED_OUTPUT_PIN, OUTPUT);
@@ -52,71 +275,489 @@ void setup() {
   pinMode(CENTER_OUTPUT_PIN, OUTPUT);
   pinMode(BOTTOM_OUTPUT_PIN, OUTPUT);
 
-  last_top_value_notified = 0;
-  last_center_value_notified = 0;
-  last_bottom_value_notified = 0;
+  // the top input is digital, any change is worth a notify
+  notify_schedules[TOP_INPUT] = (NotifySchedule){0, 50, 0};
+  notify_schedules[CENTER_INPUT] = (NotifySchedule){2, 50, 500};
+  notify_schedules[BOTTOM_INPUT] = (NotifySchedule){2, 50, 500};
+  notify_rate = 20;
+  notify_burst = 4;
+  notify_tokens = notify_burst * NOTIFY_TOKEN;
+  notify_tokens_time = millis();
+  for (uint8_t i = 0; i < NUM_INPUTS; i++) {
+    last_values_notified[i] = 0;
+    notified_times[i] = notify_tokens_time;
+  }
+  all_inputs_sequence = 0;
+  all_inputs_notified_time = 0;
+  stream_sample_period = 0;
 
   //write LittleBits to LOW state.
   digitalWrite(TOP_OUTPUT_PIN, LOW);
   analogWrite(CENTER_OUTPUT_PIN, 0);
   analogWrite(BOTTOM_OUTPUT_PIN, 0);
   
+  adc_begin();
+
   // Setup the Pebble smartstrap connection using one wire software serial
   ArduinoPebbleSerial::begin_software(PEBBLE_DATA_PIN, buffer, sizeof(buffer), Baud57600, SERVICES, NUM_SERVICES);
 }
 
+uint8_t stream_count() {
+  return stream_head - stream_tail;
+}
+
+void stream_reset(uint8_t sample_period, uint8_t block_samples) {
+  stream_head = 0;
+  stream_tail = 0;
+  stream_overflow = 0;
+  stream_sample_period = sample_period;
+  stream_block_samples = constrain(block_samples, 1, STREAM_MAX_SAMPLES);
+  stream_sample_time = millis();
+  stream_notified = false;
+}
+
+void stream_push(uint8_t top_value, uint8_t center_value, uint8_t bottom_value) {
+  if (stream_count() == STREAM_RING_SIZE) {
+    // drop the oldest sample, the watch is told how many were lost
+    stream_tail++;
+    if (stream_overflow < 255) {
+      stream_overflow++;
+    }
+  }
+
+  uint8_t *sample = stream_ring[stream_head & (STREAM_RING_SIZE - 1)];
+  sample[0] = top_value;
+  sample[1] = center_value;
+  sample[2] = bottom_value;
+  stream_head++;
+}
+
+uint16_t filter_median(FilterState *state, uint8_t taps, uint16_t sample) {
+  state->history[state->history_next] = sample;
+  if (++state->history_next == taps) {
+    state->history_next = 0;
+  }
+  if (state->history_count < taps) {
+    state->history_count++;
+  }
+
+  // insertion sort, there are only a handful of taps
+  uint16_t sorted[FILTER_MAX_MEDIAN_TAPS];
+  for (uint8_t i = 0; i < state->history_count; i++) {
+    const uint16_t value = state->history[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = value;
+  }
+  return sorted[state->history_count / 2];
+}
+
+uint16_t filter_ema(FilterState *state, uint8_t ema_shift, uint16_t sample) {
+  if (!state->ema_primed) {
+    state->ema = sample;
+    state->ema_primed = true;
+  } else {
+    state->ema += ((int32_t)sample - state->ema) >> ema_shift;
+  }
+  return state->ema;
+}
+
+// Median and EMA over an oversampled reading. Integer math only.
+uint8_t filter_input(uint8_t input, uint16_t value) {
+  const FilterConfig *config = &FILTER_CONFIGS[input];
+  FilterState *state = &filter_states[input];
+
+  if (config->median_taps > 1) {
+    value = filter_median(state, config->median_taps, value);
+  }
+  if (config->ema_shift) {
+    value = filter_ema(state, config->ema_shift, value);
+  }
+  return value >> FILTER_OUTPUT_SHIFT;
+}
+
+uint8_t adc_channel(uint8_t pin) {
+  if (pin >= A0) {
+    pin -= A0;
+  }
+#if defined(analogPinToChannel)
+  return analogPinToChannel(pin);
+#else
+  return pin;
+#endif
+}
+
+void adc_start_input(uint8_t input, uint8_t pin) {
+  const uint8_t channel = adc_channel(pin);
+  adc_input = input;
+  adc_conversions = 1 << FILTER_CONFIGS[input].oversample_shift;
+  adc_sum = 0;
+  // AVcc reference, same as analogRead()
+  ADMUX = _BV(REFS0) | (channel & 0x07);
+#if defined(MUX5)
+  ADCSRB = (ADCSRB & ~_BV(MUX5)) | (((channel >> 3) & 0x01) << MUX5);
+#endif
+  ADCSRA |= _BV(ADSC);
+}
+
+void adc_begin() {
+  adc_head = 0;
+  adc_tail = 0;
+  adc_overrun = 0;
+  adc_busy = false;
+  // ADC on, interrupt on completion, 16 MHz / 128: about 104 us per conversion,
+  // so a burst of the default 2 x 4 conversions fits well within a timer tick.
+  ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+  OCR0A = ADC_TIMER_COMPARE;
+  TIMSK0 |= _BV(OCIE0A);
+}
+
+// Starts a burst: the top input is read here, the analog inputs are converted
+// back to back by the ADC interrupt.
+ISR(TIMER0_COMPA_vect) {
+  if (adc_busy) {
+    // the previous burst is still converting, skip this tick
+    return;
+  }
+  adc_busy = true;
+  adc_burst.values[TOP_INPUT] = (digitalRead(TOP_INPUT_PIN) == HIGH) ? 0 : 255;
+  adc_start_input(CENTER_INPUT, CENTER_INPUT_PIN);
+}
+
+ISR(ADC_vect) {
+  adc_sum += ADC;
+  if (--adc_conversions) {
+    ADCSRA |= _BV(ADSC);
+    return;
+  }
+
+  // decimate into filter fixed point
+  adc_burst.values[adc_input] = adc_sum << (FILTER_FIXED_SHIFT - FILTER_CONFIGS[adc_input].oversample_shift);
+  if (adc_input == CENTER_INPUT) {
+    adc_start_input(BOTTOM_INPUT, BOTTOM_INPUT_PIN);
+    return;
+  }
+
+  if ((uint8_t)(adc_head - adc_tail) == ADC_RING_SIZE) {
+    adc_overrun++;
+  } else {
+    volatile AdcSample *sample = &adc_ring[adc_head & (ADC_RING_SIZE - 1)];
+    for (uint8_t i = 0; i < NUM_INPUTS; i++) {
+      sample->values[i] = adc_burst.values[i];
+    }
+    // publish only once the sample set is complete
+    adc_head++;
+  }
+  adc_busy = false;
+}
+
+// Runs every sample set converted since the last call through the filters.
+void adc_drain() {
+  const uint8_t head = adc_head;
+  while (adc_tail != head) {
+    volatile AdcSample *sample = &adc_ring[adc_tail & (ADC_RING_SIZE - 1)];
+    input_values[TOP_INPUT] = sample->values[TOP_INPUT];
+    input_values[CENTER_INPUT] = filter_input(CENTER_INPUT, sample->values[CENTER_INPUT]);
+    input_values[BOTTOM_INPUT] = filter_input(BOTTOM_INPUT, sample->values[BOTTOM_INPUT]);
+    adc_tail++;
+  }
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+  // Logs the sample sets lost since the last call
+  static uint8_t adc_overrun_logged;
+  const uint8_t overrun = adc_overrun;
+  if (overrun != adc_overrun_logged) {
+    LOG_ERROR(StrapLogAdcOverrun, (uint8_t)(overrun - adc_overrun_logged), 0);
+    adc_overrun_logged = overrun;
+  }
+#endif
+}
+
+void notify_configure(const uint8_t *config) {
+  for (uint8_t i = 0; i < NUM_INPUTS; i++) {
+    const uint8_t *schedule = &config[i * NOTIFY_SCHEDULE_LENGTH];
+    notify_schedules[i].deadband = schedule[0];
+    notify_schedules[i].min_interval = schedule[1] | (schedule[2] << 8);
+    notify_schedules[i].max_interval = schedule[3] | (schedule[4] << 8);
+  }
+  notify_rate = config[NUM_INPUTS * NOTIFY_SCHEDULE_LENGTH];
+  notify_burst = constrain(config[NUM_INPUTS * NOTIFY_SCHEDULE_LENGTH + 1], 1, 255);
+  notify_tokens = min(notify_tokens, notify_burst * NOTIFY_TOKEN);
+}
+
+void notify_refill_tokens(uint32_t current_time) {
+  const uint32_t capacity = notify_burst * NOTIFY_TOKEN;
+  // cap the elapsed time so the product below cannot overflow
+  const uint32_t elapsed = min(current_time - notify_tokens_time, (uint32_t)60000);
+  notify_tokens_time = current_time;
+  if (notify_rate == 0) {
+    notify_tokens = capacity;
+  } else {
+    // rate per second is rate thousandths per millisecond
+    notify_tokens = min(notify_tokens + elapsed * notify_rate, capacity);
+  }
+}
+
+bool should_notify_input(uint8_t input, uint8_t new_value, uint32_t current_time) {
+  const NotifySchedule *schedule = &notify_schedules[input];
+  const uint8_t difference = abs(new_value - last_values_notified[input]);
+  if (difference == 0) {
+    return false;
+  }
+
+  const uint32_t elapsed = current_time - notified_times[input];
+  if (elapsed < schedule->min_interval) {
+    // still pending, checked again on the next loop
+    return false;
+  }
+  if (difference > schedule->deadband) {
+    return true;
+  }
+  // Settle: a value that came to rest inside the deadband is still delivered eventually,
+  // so the watch never keeps a stale last value.
+  return schedule->max_interval && elapsed >= schedule->max_interval;
+}
+
+void handle_stream_request() {
+  uint8_t block[STREAM_ATTRIBUTE_LENGTH];
+  uint8_t count = min(stream_count(), STREAM_MAX_SAMPLES);
+
+  block[0] = (uint8_t)stream_sequence;
+  block[1] = (uint8_t)(stream_sequence >> 8);
+  block[2] = count;
+  block[3] = stream_overflow;
+  for (uint8_t i = 0; i < count; i++) {
+    memcpy(&block[STREAM_HEADER_LENGTH + i * STREAM_SAMPLE_LENGTH],
+           stream_ring[stream_tail & (STREAM_RING_SIZE - 1)], STREAM_SAMPLE_LENGTH);
+    stream_tail++;
+  }
+
+  stream_sequence++;
+  stream_overflow = 0;
+  stream_notified = false;
+  ArduinoPebbleSerial::write(true, block, STREAM_HEADER_LENGTH + count * STREAM_SAMPLE_LENGTH);
+}
+
 void handle_input_request(RequestType type, size_t length, uint16_t attribute_id) {
-  Serial.println("Arduino -> SmartStrap (START)");
   if (type != RequestTypeRead) {
     // unexpected request type
+    LOG_ERROR(StrapLogUnexpectedType, attribute_id, type);
+    return;
+  }
+  LOG_DEBUG(StrapLogRead, attribute_id, 0);
+
+  if (attribute_id == STREAM_ATTRIBUTE_ID) {
+    handle_stream_request();
+    return;
+  }
+
+  if (attribute_id == ALL_INPUTS_ATTRIBUTE_ID) {
+    const uint8_t frame[ALL_INPUTS_ATTRIBUTE_LENGTH] = {
+      last_values_notified[TOP_INPUT],
+      last_values_notified[CENTER_INPUT],
+      last_values_notified[BOTTOM_INPUT],
+      (uint8_t)all_inputs_sequence,
+      (uint8_t)(all_inputs_sequence >> 8),
+      (uint8_t)all_inputs_notified_time,
+      (uint8_t)(all_inputs_notified_time >> 8),
+      (uint8_t)(all_inputs_notified_time >> 16),
+      (uint8_t)(all_inputs_notified_time >> 24),
+    };
+    ArduinoPebbleSerial::write(true, frame, sizeof(frame));
     return;
   }
 
   int inputValue = 0;
   switch (attribute_id) {
     case TOP_INPUT_ATTRIBUTE_ID:
-      inputValue = last_top_value_notified;
+      inputValue = last_values_notified[TOP_INPUT];
       break;
     case CENTER_INPUT_ATTRIBUTE_ID:
-      inputValue = last_center_value_notified;
+      inputValue = last_values_notified[CENTER_INPUT];
       break;
     case BOTTOM_INPUT_ATTRIBUTE_ID:
-      inputValue = last_bottom_value_notified;
+      inputValue = last_values_notified[BOTTOM_INPUT];
       break;
     default:
       break; 
   }
   const uint8_t mapInputValue = inputValue;
   ArduinoPebbleSerial::write(true, (uint8_t *)&mapInputValue, sizeof(mapInputValue));
-  Serial.println("Arduino -> SmartStrap (SUCCESS)");
+}
+
+void set_top_output(uint8_t value) {
+  if (value > 0) {
+    digitalWrite(TOP_OUTPUT_PIN, HIGH);
+  } else {
+    digitalWrite(TOP_OUTPUT_PIN, LOW);
+  }
+}
+
+void set_center_output(uint8_t value) {
+  analogWrite(CENTER_OUTPUT_PIN, value);
+}
+
+void set_bottom_output(uint8_t value) {
+  analogWrite(BOTTOM_OUTPUT_PIN, value);
+}
+
+void local_routes_configure(const uint8_t *config) {
+  local_lease = config[0] | (config[1] << 8);
+  local_lease_time = millis();
+  local_routing = false;
+  local_route_count = config[2];
+  for (uint8_t r = 0; r < local_route_count; r++) {
+    const uint8_t *route = &config[LOCAL_ROUTES_HEADER_LENGTH + r * LOCAL_ROUTE_LENGTH];
+    local_routes[r] = (LocalRoute){
+      route[0], route[1], route[2], route[3], route[4], route[5], route[6] != 0, route[7],
+      (int8_t)route[8], (int16_t)(route[9] | (route[10] << 8)), (int16_t)(route[11] | (route[12] << 8)),
+    };
+    local_route_values[r] = 0;
+  }
+}
+
+// The transforms of the watch's route table, computed per value instead of looked up.
+uint8_t local_transform(uint8_t r, uint8_t value) {
+  const LocalRoute *route = &local_routes[r];
+  switch (route->transform) {
+    case TRANSFORM_INVERT:
+      return 255 - value;
+    case TRANSFORM_GATE:
+      return (value < route->threshold) ? 0 : (route->binary ? 255 : value);
+    case TRANSFORM_GAIN_OFFSET:
+      return constrain((int32_t)value * route->gain / 16 + route->offset, 0, 255);
+    case TRANSFORM_CURVE: {
+        const uint8_t bend = min(abs(route->steepness), CURVE_FULL_STEEPNESS);
+        const uint8_t x = (route->steepness < 0) ? 255 - value : value;
+        // x * x / 255 blended with x
+        const uint8_t curved = x - (uint32_t)x * (255 - x) * bend / (255 * CURVE_FULL_STEEPNESS);
+        return (route->steepness < 0) ? 255 - curved : curved;
+      }
+    case TRANSFORM_HYSTERESIS: {
+        const uint8_t low = min(route->threshold, route->threshold_high);
+        const uint8_t high = max(route->threshold, route->threshold_high);
+        return (value < low) ? 0 : (value > high) ? 255 : local_route_values[r];
+      }
+    case TRANSFORM_QUANTIZE: {
+        const uint16_t intervals = max(route->steps, 2) - 1;
+        return ((uint16_t)value * intervals + 127) / 255 * 255 / intervals;
+      }
+    default:
+      return value;
+  }
+}
+
+// Runs the routes fed by inputs that changed since the last call, or every route when routing
+// has just been taken over from the watch.
+void local_routes_run(const uint8_t *new_values, bool take_over) {
+  uint8_t changed = 0;
+  for (uint8_t i = 0; i < NUM_INPUTS; i++) {
+    if (take_over || new_values[i] != local_inputs[i]) {
+      changed |= 1 << i;
+      local_inputs[i] = new_values[i];
+    }
+  }
+
+  for (uint8_t r = 0; r < local_route_count; r++) {
+    const LocalRoute *route = &local_routes[r];
+    if (!(route->inputs & changed)) {
+      continue;
+    }
+    bool has_value = false;
+    uint8_t value = 0;
+    for (uint8_t i = 0; i < NUM_INPUTS; i++) {
+      if (!(route->inputs & (1 << i))) {
+        continue;
+      }
+      if (!has_value || (route->combine == 0 && new_values[i] > value) ||
+          (route->combine == 1 && new_values[i] < value)) {
+        value = new_values[i];
+      }
+      has_value = true;
+    }
+
+    value = local_transform(r, value);
+    local_route_values[r] = value;
+    if (route->outputs & TOP_OUTPUT_MASK) {
+      set_top_output(value);
+    }
+    if (route->outputs & CENTER_OUTPUT_MASK) {
+      set_center_output(value);
+    }
+    if (route->outputs & BOTTOM_OUTPUT_MASK) {
+      set_bottom_output(value);
+    }
+  }
 }
 
 void handle_output_request(RequestType type, size_t length, uint16_t attribute_id) {
-  Serial.println("SmartStrap -> Arduino (START)");
-  
   if (type != RequestTypeWrite) {
     // unexpected request type
+    LOG_ERROR(StrapLogUnexpectedType, attribute_id, type);
     return;
-  } else if (length != OUTPUT_ATTRIBUTE_LENGTH) {
+  }
+  LOG_DEBUG(StrapLogWrite, attribute_id, length);
+
+  size_t expected_length = OUTPUT_ATTRIBUTE_LENGTH;
+  if (attribute_id == ALL_OUTPUTS_ATTRIBUTE_ID) {
+    expected_length = ALL_OUTPUTS_ATTRIBUTE_LENGTH;
+  } else if (attribute_id == STREAM_CONFIG_ATTRIBUTE_ID) {
+    expected_length = STREAM_CONFIG_ATTRIBUTE_LENGTH;
+  } else if (attribute_id == NOTIFY_CONFIG_ATTRIBUTE_ID) {
+    expected_length = NOTIFY_CONFIG_ATTRIBUTE_LENGTH;
+  } else if (attribute_id == LOCAL_ROUTES_ATTRIBUTE_ID) {
+    if (length < LOCAL_ROUTES_HEADER_LENGTH || buffer[2] > LOCAL_ROUTES_MAX) {
+      // no route count to go by: the rest of the buffer is left over from an earlier request and
+      // must never be run as a table
+      LOG_ERROR(StrapLogUnexpectedLength, attribute_id, length);
+      ArduinoPebbleSerial::write(false, NULL, 0);
+      return;
+    }
+    // the length follows from the number of routes
+    expected_length = LOCAL_ROUTES_HEADER_LENGTH + buffer[2] * LOCAL_ROUTE_LENGTH;
+  }
+  if (length != expected_length) {
     // unexpected request length
+    LOG_ERROR(StrapLogUnexpectedLength, attribute_id, length);
     return;
   }
   bool do_ack = HIGH;
   switch (attribute_id) {
     case TOP_OUTPUT_ATTRIBUTE_ID:
-      if (buffer[0] > 0) {
-        digitalWrite(TOP_OUTPUT_PIN, HIGH);
-      } else {
-        digitalWrite(TOP_OUTPUT_PIN, LOW);
-      }
+      set_top_output(buffer[0]);
       break;
     case CENTER_OUTPUT_ATTRIBUTE_ID:
-      analogWrite(CENTER_OUTPUT_PIN, buffer[0]);
+      set_center_output(buffer[0]);
       break;
     case BOTTOM_OUTPUT_ATTRIBUTE_ID:
-      analogWrite(BOTTOM_OUTPUT_PIN, buffer[0]);
+      set_bottom_output(buffer[0]);
+      break;
+    case ALL_OUTPUTS_ATTRIBUTE_ID:
+      // apply every masked output before the single ACK below
+      if (buffer[0] & TOP_OUTPUT_MASK) {
+        set_top_output(buffer[1]);
+      }
+      if (buffer[0] & CENTER_OUTPUT_MASK) {
+        set_center_output(buffer[2]);
+      }
+      if (buffer[0] & BOTTOM_OUTPUT_MASK) {
+        set_bottom_output(buffer[3]);
+      }
+      break;
+    case STREAM_CONFIG_ATTRIBUTE_ID:
+      stream_reset(buffer[0], buffer[1]);
+      break;
+    case NOTIFY_CONFIG_ATTRIBUTE_ID:
+      notify_configure(buffer);
+      break;
+    case LOCAL_ROUTES_ATTRIBUTE_ID:
+      local_routes_configure(buffer);
       break;
    default:
+      LOG_ERROR(StrapLogUnknownAttribute, attribute_id, 0);
       do_ack = LOW;
   }
   
@@ -126,8 +767,6 @@ void handle_output_request(RequestType type, size_t length, uint16_t attribute_i
   } else {
     ArduinoPebbleSerial::write(false, NULL, 0);
   }
-
-  Serial.println("SmartStrap -> Arduino (SUCCESS)");
 }
 
 void loop() {
@@ -137,87 +776,89 @@ void loop() {
   size_t length;
   RequestType type;
   bool fed = ArduinoPebbleSerial::feed(&service_id, &attribute_id, &length, &type);
-
   bool pebble_connected = ArduinoPebbleSerial::is_connected();
-  digitalWrite(CONNECTED_OUTPUT_PIN, pebble_connected ? HIGH : LOW);
 
-  uint8_t top_new_value = (digitalRead(TOP_INPUT_PIN) == HIGH) ? 0 : 255;
-  uint8_t center_new_value = map(analogRead(CENTER_INPUT_PIN), 0, 1023, 0, 255);
-  uint8_t bottom_new_value = map(analogRead(BOTTOM_INPUT_PIN), 0, 1023, 0, 255);
-
-  // decide whether to notify each input
-  bool should_notify_top = LOW;
-  bool should_notify_center = LOW;
-  bool should_notify_bottom = LOW;
-  
-  if (top_new_value != last_top_value_notified) {
-    should_notify_top = HIGH;
+  // Answer the request before anything else, so its latency does not depend on the sampling work.
+  if (pebble_connected && fed) {
+    if (service_id == SERVICE_ID) {
+      switch (type) {
+        case RequestTypeRead:
+          handle_input_request(type, length, attribute_id);
+          break;
+        case RequestTypeWrite:
+          handle_output_request(type, length, attribute_id);
+          break;
+        default:
+          break;
+      }
+    }
   }
 
-  if (abs(last_center_value_notified - center_new_value) > 2) {
-    should_notify_center = HIGH;
+  static bool connected_indicated = false;
+  if (pebble_connected != connected_indicated) {
+    connected_indicated = pebble_connected;
+    digitalWrite(CONNECTED_OUTPUT_PIN, pebble_connected ? HIGH : LOW);
   }
 
-  if (abs(last_bottom_value_notified - bottom_new_value) > 2) {
-    should_notify_bottom = HIGH;
-  }
+  // The inputs are sampled by the timer interrupt, this only filters what it converted.
+  adc_drain();
+  const uint8_t *new_values = input_values;
 
   const uint32_t current_time = millis();
-  static uint32_t top_notified_time = current_time;
-  static uint32_t center_notified_time = current_time;
-  static uint32_t bottom_notified_time = current_time;
-
-  bool top_clamped = LOW;
-  bool center_clamped = LOW;
-  bool bottom_clamped = LOW;
 
-  static const uint32_t CLAMP_MILLISECONDS = 100;
-  if (current_time - top_notified_time < CLAMP_MILLISECONDS) {
-    top_clamped = HIGH;
-  }
-  if (current_time - center_notified_time < CLAMP_MILLISECONDS) {
-    center_clamped = HIGH;
+  // Once the watch stops renewing its lease (the app was closed, or the watch is gone), the
+  // routes it handed over keep the outputs following the inputs.
+  if (local_route_count && (local_routing || current_time - local_lease_time >= local_lease)) {
+    if (!local_routing) {
+      LOG_DEBUG(StrapLogLocalRoutes, local_route_count, 0);
+    }
+    local_routes_run(new_values, !local_routing);
+    local_routing = true;
   }
-  if (current_time - bottom_notified_time < CLAMP_MILLISECONDS) {
-    bottom_clamped = HIGH;
+
+  if (stream_sample_period) {
+    // catch up if the loop fell behind, but never by more than one sample
+    if (current_time - stream_sample_time >= stream_sample_period) {
+      stream_sample_time = max(stream_sample_time + stream_sample_period, current_time - stream_sample_period);
+      stream_push(new_values[TOP_INPUT], new_values[CENTER_INPUT], new_values[BOTTOM_INPUT]);
+    }
   }
 
   // only attempt to communicate with the pebble if we are connected;
-  if (pebble_connected) {
+  if (pebble_connected && stream_sample_period) {
 
-    if (should_notify_top && (top_clamped == LOW)) {
-      last_top_value_notified = top_new_value;
-      ArduinoPebbleSerial::notify(SERVICE_ID, TOP_INPUT_ATTRIBUTE_ID);
-      top_notified_time = current_time;
+    // Every sample travels in the stream, so the change notifies are suspended.
+    bool renotify = stream_notified && (current_time - stream_notified_time >= STREAM_RENOTIFY_MILLISECONDS);
+    if (stream_count() >= stream_block_samples && (!stream_notified || renotify)) {
+      stream_notified = true;
+      stream_notified_time = current_time;
+      ArduinoPebbleSerial::notify(SERVICE_ID, STREAM_ATTRIBUTE_ID);
     }
 
-    if (should_notify_center && (center_clamped == LOW)) {
-      last_center_value_notified = center_new_value;
-      ArduinoPebbleSerial::notify(SERVICE_ID, CENTER_INPUT_ATTRIBUTE_ID);
-      center_notified_time = current_time;
-    }
+  } else if (pebble_connected) {
 
-    if (should_notify_bottom && (bottom_clamped == LOW)) {
-      last_bottom_value_notified = bottom_new_value;
-      ArduinoPebbleSerial::notify(SERVICE_ID, BOTTOM_INPUT_ATTRIBUTE_ID);
-      bottom_notified_time = current_time;
-    }
-    
-    if (fed) {
-      // process the request
-      if (service_id == SERVICE_ID) {
-        switch (type) {
-          case RequestTypeRead:
-            handle_input_request(type, length, attribute_id);
-            break;
-          case RequestTypeWrite:
-            handle_output_request(type, length, attribute_id);
-            break;
-          default:
-            break;
+    // Changed channels share a single notify of the all-inputs attribute,
+    // which the watch answers with a single read. Each notify spends a token,
+    // so a busy input never saturates the bus; a channel that has to wait
+    // stays pending and goes out with the next token.
+    notify_refill_tokens(current_time);
+    bool should_notify_all_inputs = LOW;
+
+    if (notify_tokens >= NOTIFY_TOKEN) {
+      for (uint8_t i = 0; i < NUM_INPUTS; i++) {
+        if (should_notify_input(i, new_values[i], current_time)) {
+          last_values_notified[i] = new_values[i];
+          notified_times[i] = current_time;
+          should_notify_all_inputs = HIGH;
         }
       }
-    }  
+    }
+
+    if (should_notify_all_inputs) {
+      notify_tokens -= NOTIFY_TOKEN;
+      all_inputs_sequence++;
+      all_inputs_notified_time = current_time;
+      ArduinoPebbleSerial::notify(SERVICE_ID, ALL_INPUTS_ATTRIBUTE_ID);
+    }
   }
 }
-
@@ -0,0 +1,264 @@
+// Measures how long an input change takes to reach an output through the router, against the fake
+// strap on the virtual clock, so the numbers are reproducible on any Linux box. The watchapp's
+// main() runs as usual; the scenarios run in place of its event loop, once its init() is done.
+//
+//   build/strap_bench [--scenario NAME] [--duration MS] [--step MS] [--latency MS]
+//
+// Prints one JSON object per scenario and line:
+//  latency_ms: p50, p99, p999 and max from an input changing on the strap to the output receiving
+//              the value, over every value that made it
+//  routes: per route, values acknowledged per second, values dropped by the router and writes
+//          sent again after a failed ACK
+//  strap: requests refused with SmartstrapResultBusy and retried later, and failed transfers
+
+#include <pebble.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include "host.h"
+#include "host_strap.h"
+#include "fake_strap.h"
+#include "router.h"
+
+// Harness memory, not app memory
+#undef malloc
+#undef realloc
+#undef free
+
+#define NUM_CHANNELS FAKE_STRAP_NUM_CHANNELS
+#define NUM_VALUES 256
+
+int pebblits_main(void);
+
+typedef struct {
+  const char *name;
+  int num_routes;
+  RouterRouteConfig routes[NUM_CHANNELS];
+  // Channels whose input changes during the run
+  uint8_t changing_inputs;
+  // 0 leaves the strap notifying changes
+  uint8_t sample_period_ms;
+  uint8_t samples_per_block;
+  RouterNotifyConfig notify;
+  // Firmware without the all-inputs and all-outputs attributes
+  bool old_firmware;
+} Scenario;
+
+#define ROUTE(i, o) { .inputs = ROUTER_CHANNEL(i), .outputs = ROUTER_CHANNEL(o) }
+
+static const RouterNotifyConfig BALANCED = {
+  .channels = { { 0, 50, 0 }, { 2, 50, 500 }, { 2, 50, 500 } },
+  .notifies_per_second = 20, .burst = 4,
+};
+static const RouterNotifyConfig UNPACED = {
+  .channels = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } },
+  .notifies_per_second = 0, .burst = 1,
+};
+
+// Fallback firmware runs last: the router remembers missing attributes until it restarts
+static const Scenario SCENARIOS[] = {
+  { "notify_balanced", 1, { ROUTE(1, 1) }, ROUTER_CHANNEL(1), 0, 0, BALANCED, false },
+  { "notify_unpaced", 1, { ROUTE(1, 1) }, ROUTER_CHANNEL(1), 0, 0, UNPACED, false },
+  { "notify_3_routes", 3, { ROUTE(0, 0), ROUTE(1, 1), ROUTE(2, 2) }, ROUTER_ALL_CHANNELS, 0, 0,
+    UNPACED, false },
+  { "stream_200hz", 1, { ROUTE(1, 1) }, ROUTER_CHANNEL(1), 5, 8, UNPACED, false },
+  { "stream_3_routes", 3, { ROUTE(0, 0), ROUTE(1, 1), ROUTE(2, 2) }, ROUTER_ALL_CHANNELS, 5, 8,
+    UNPACED, false },
+  { "old_firmware_3_routes", 3, { ROUTE(0, 0), ROUTE(1, 1), ROUTE(2, 2) }, ROUTER_ALL_CHANNELS, 0, 0,
+    UNPACED, true },
+};
+
+static struct {
+  const char *scenario;
+  uint32_t duration_ms;
+  uint32_t step_ms;
+  uint32_t latency_ms;
+} s_options = {
+  .duration_ms = 10000,
+  .step_ms = 2,
+  .latency_ms = 4,
+};
+
+static const Scenario *s_scenario;
+// Last time each input took each value; values repeat every NUM_VALUES steps, so latencies longer
+// than that are under-reported
+static uint64_t s_value_times[NUM_CHANNELS][NUM_VALUES];
+static int16_t s_last_inputs[NUM_CHANNELS];
+static uint32_t s_input_changes;
+static uint64_t s_measure_start_ms;
+// Input feeding each output in the running scenario, -1 for none
+static int s_output_inputs[NUM_CHANNELS];
+
+static uint32_t *s_latencies;
+static size_t s_num_latencies;
+static size_t s_latencies_capacity;
+
+/****** Strap ******/
+
+static uint8_t prv_input_source(int channel, uint64_t now_ms, void *context) {
+  uint8_t value = 0;
+  if (s_scenario && (s_scenario->changing_inputs & ROUTER_CHANNEL(channel))) {
+    // Every input steps through every value, offset so no two inputs agree
+    value = (uint8_t)(now_ms / s_options.step_ms + channel * (NUM_VALUES / NUM_CHANNELS));
+  }
+  if (value != s_last_inputs[channel]) {
+    s_last_inputs[channel] = value;
+    s_value_times[channel][value] = now_ms;
+    s_input_changes++;
+  }
+  return value;
+}
+
+static void prv_output_handler(int channel, uint8_t value, void *context) {
+  const int input = s_output_inputs[channel];
+  // Values from before the measurement started were fetched by router_start(), not notified
+  if (!s_scenario || input < 0 || s_value_times[input][value] < s_measure_start_ms) {
+    return;
+  }
+  if (s_num_latencies == s_latencies_capacity) {
+    s_latencies_capacity = s_latencies_capacity ? s_latencies_capacity * 2 : 4096;
+    s_latencies = realloc(s_latencies, s_latencies_capacity * sizeof(uint32_t));
+  }
+  s_latencies[s_num_latencies++] = (uint32_t)(host_time_ms() - s_value_times[input][value]);
+}
+
+/****** Report ******/
+
+static int prv_compare_latencies(const void *a, const void *b) {
+  const uint32_t x = *(const uint32_t *)a;
+  const uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of the sorted latencies, in thousandths
+static uint32_t prv_percentile(int per_mille) {
+  if (!s_num_latencies) {
+    return 0;
+  }
+  size_t rank = (s_num_latencies * per_mille + 999) / 1000;
+  return s_latencies[rank ? rank - 1 : 0];
+}
+
+static void prv_report(const Scenario *scenario, uint32_t duration_ms) {
+  qsort(s_latencies, s_num_latencies, sizeof(uint32_t), prv_compare_latencies);
+  const HostStrapStats strap = host_strap_get_stats();
+
+  printf("{\"scenario\":\"%s\",\"duration_ms\":%u,\"step_ms\":%u,\"bus_latency_ms\":%u,"
+         "\"input_changes\":%u,",
+         scenario->name, duration_ms, s_options.step_ms, s_options.latency_ms, s_input_changes);
+  printf("\"latency_ms\":{\"count\":%zu,\"p50\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u},", s_num_latencies,
+         prv_percentile(500), prv_percentile(990), prv_percentile(999),
+         s_num_latencies ? s_latencies[s_num_latencies - 1] : 0);
+
+  printf("\"routes\":[");
+  for (int r = 0; r < scenario->num_routes; r++) {
+    RouterRouteStats stats = { 0 };
+    router_get_route_stats(r, &stats);
+    printf("%s{\"inputs\":%u,\"outputs\":%u,\"samples\":%u,\"samples_per_sec\":%.1f,\"dropped\":%u,"
+           "\"write_retries\":%u}",
+           r ? "," : "", scenario->routes[r].inputs, scenario->routes[r].outputs, stats.samples,
+           stats.samples * 1000.0 / duration_ms, stats.dropped, stats.retries);
+  }
+  printf("],");
+
+  printf("\"strap\":{\"busy_retries\":%u,\"reads\":%u,\"writes\":%u,\"notifies\":%u,\"failures\":%u}}\n",
+         strap.busy, strap.reads, strap.writes, strap.notifies, strap.failures);
+  fflush(stdout);
+}
+
+/****** Scenarios ******/
+
+static void prv_run_scenario(const Scenario *scenario) {
+  FakeStrapConfig config = fake_strap_get_config();
+  config.read_latency_ms = s_options.latency_ms;
+  config.write_latency_ms = s_options.latency_ms;
+  config.no_all_inputs = scenario->old_firmware;
+  config.no_all_outputs = scenario->old_firmware;
+  fake_strap_set_config(&config);
+
+  router_set_notify_config(&scenario->notify);
+  router_set_streaming(scenario->sample_period_ms, scenario->samples_per_block);
+  router_clear_routes();
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    s_output_inputs[i] = -1;
+  }
+  for (int r = 0; r < scenario->num_routes; r++) {
+    router_add_route(scenario->routes[r]);
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+      if (scenario->routes[r].outputs & ROUTER_CHANNEL(i)) {
+        s_output_inputs[i] = __builtin_ctz(scenario->routes[r].inputs);
+      }
+    }
+  }
+  // Let the configuration writes and the first reads settle before measuring
+  host_run_for(100);
+
+  router_start();
+  host_strap_reset_stats();
+  s_num_latencies = 0;
+  s_input_changes = 0;
+  s_measure_start_ms = host_time_ms();
+  s_scenario = scenario;
+  host_run_for(s_options.duration_ms);
+  s_scenario = NULL;
+
+  prv_report(scenario, s_options.duration_ms);
+
+  // Outputs go quiet before the next scenario
+  router_clear_routes();
+  router_set_streaming(0, 0);
+  host_run_for(100);
+}
+
+static void prv_bench(void) {
+  fake_strap_set_input_source(prv_input_source, NULL);
+  fake_strap_set_output_handler(prv_output_handler, NULL);
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    s_last_inputs[i] = -1;
+  }
+
+  for (size_t i = 0; i < ARRAY_LENGTH(SCENARIOS); i++) {
+    if (!s_options.scenario || strcmp(s_options.scenario, SCENARIOS[i].name) == 0) {
+      prv_run_scenario(&SCENARIOS[i]);
+    }
+  }
+}
+
+static void prv_usage(const char *name) {
+  fprintf(stderr, "usage: %s [--scenario NAME] [--duration MS] [--step MS] [--latency MS]\nscenarios:", name);
+  for (size_t i = 0; i < ARRAY_LENGTH(SCENARIOS); i++) {
+    fprintf(stderr, " %s", SCENARIOS[i].name);
+  }
+  fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+  static const struct option OPTIONS[] = {
+    { "scenario", required_argument, NULL, 's' },
+    { "duration", required_argument, NULL, 'd' },
+    { "step", required_argument, NULL, 't' },
+    { "latency", required_argument, NULL, 'l' },
+    { NULL, 0, NULL, 0 },
+  };
+
+  int option;
+  while ((option = getopt_long(argc, argv, "s:d:t:l:", OPTIONS, NULL)) != -1) {
+    switch (option) {
+      case 's': s_options.scenario = optarg; break;
+      case 'd': s_options.duration_ms = strtoul(optarg, NULL, 10); break;
+      case 't': s_options.step_ms = strtoul(optarg, NULL, 10); break;
+      case 'l': s_options.latency_ms = strtoul(optarg, NULL, 10); break;
+      default:
+        prv_usage(argv[0]);
+        return 2;
+    }
+  }
+  if (!s_options.step_ms || !s_options.duration_ms) {
+    prv_usage(argv[0]);
+    return 2;
+  }
+
+  host_set_main_loop(prv_bench);
+  return pebblits_main();
+}
@@ -0,0 +1,540 @@
+#include <pebble.h>
+#include <stdarg.h>
+#include "host.h"
+
+// Animations follow SDK 3: they are destroyed once they stop, unless a stopped handler schedules
+// them again, and a stale handle is safely refused. Handles are IDs for that reason, and destroyed
+// animations are only freed once the event that destroyed them is over.
+
+#define ANIMATION_FRAME_MS 33
+#define DEFAULT_DURATION_MS 250
+#define MAX_CHILDREN 20
+#define MAX_SCHEDULED 64
+#define INFINITE_TOTAL_MS (INT64_MAX / 4)
+
+typedef enum {
+  KindSimple,
+  KindSequence,
+  KindSpawn,
+} Kind;
+
+typedef struct HostAnimation {
+  uintptr_t id;
+  Kind kind;
+  uint32_t duration_ms;
+  uint32_t delay_ms;
+  AnimationCurve curve;
+  AnimationImplementation implementation;
+  AnimationHandlers handlers;
+  void *context;
+
+  struct HostAnimation *parent;
+  struct HostAnimation *children[MAX_CHILDREN];
+  int num_children;
+
+  // Layer frame property animation
+  Layer *layer;
+  bool has_from;
+  bool has_to;
+  GRect from;
+  GRect to;
+
+  // Only set on animations without a parent
+  bool scheduled;
+  uint64_t start_ms;
+  bool started;
+  bool finished;
+  bool dead;
+
+  struct HostAnimation *next;
+} HostAnimation;
+
+static HostAnimation *s_animations;
+static HostAnimation *s_dead_animations;
+static uintptr_t s_next_id = 1;
+static HostEvent *s_frame_event;
+
+static Animation *prv_handle(HostAnimation *animation) {
+  return (Animation *)animation->id;
+}
+
+static HostAnimation *prv_lookup(Animation *handle) {
+  if (!handle) {
+    return NULL;
+  }
+  for (HostAnimation *animation = s_animations; animation; animation = animation->next) {
+    if (animation->id == (uintptr_t)handle) {
+      return animation;
+    }
+  }
+  return NULL;
+}
+
+static HostAnimation *prv_root(HostAnimation *animation) {
+  while (animation->parent) {
+    animation = animation->parent;
+  }
+  return animation;
+}
+
+static int64_t prv_total_ms(HostAnimation *animation) {
+  int64_t total = 0;
+  switch (animation->kind) {
+    case KindSimple:
+      if (animation->duration_ms == ANIMATION_DURATION_INFINITE) {
+        return INFINITE_TOTAL_MS;
+      }
+      total = animation->duration_ms;
+      break;
+    case KindSequence:
+      for (int i = 0; i < animation->num_children; i++) {
+        total += prv_total_ms(animation->children[i]);
+      }
+      break;
+    case KindSpawn:
+      for (int i = 0; i < animation->num_children; i++) {
+        const int64_t child_total = prv_total_ms(animation->children[i]);
+        total = child_total > total ? child_total : total;
+      }
+      break;
+  }
+  return total < INFINITE_TOTAL_MS ? total + animation->delay_ms : INFINITE_TOTAL_MS;
+}
+
+static AnimationProgress prv_apply_curve(AnimationCurve curve, int64_t progress) {
+  const int64_t max = ANIMATION_NORMALIZED_MAX;
+  switch (curve) {
+    case AnimationCurveEaseIn:
+      return progress * progress / max;
+    case AnimationCurveEaseOut:
+      return max - (max - progress) * (max - progress) / max;
+    case AnimationCurveEaseInOut:
+      if (progress < max / 2) {
+        return 2 * progress * progress / max;
+      }
+      return max - 2 * (max - progress) * (max - progress) / max;
+    case AnimationCurveLinear:
+    default:
+      return progress;
+  }
+}
+
+/****** Lifecycle ******/
+
+static void prv_kill(HostAnimation *animation) {
+  for (int i = 0; i < animation->num_children; i++) {
+    prv_kill(animation->children[i]);
+  }
+  for (HostAnimation **link = &s_animations; *link; link = &(*link)->next) {
+    if (*link == animation) {
+      *link = animation->next;
+      break;
+    }
+  }
+  animation->dead = true;
+  animation->next = s_dead_animations;
+  s_dead_animations = animation;
+}
+
+void host_animation_reap(void) {
+  while (s_dead_animations) {
+    HostAnimation *animation = s_dead_animations;
+    s_dead_animations = animation->next;
+    free(animation);
+  }
+}
+
+static void prv_reset(HostAnimation *animation) {
+  animation->started = false;
+  animation->finished = false;
+  for (int i = 0; i < animation->num_children; i++) {
+    prv_reset(animation->children[i]);
+  }
+}
+
+static void prv_start(HostAnimation *animation) {
+  animation->started = true;
+  if (animation->handlers.started) {
+    animation->handlers.started(prv_handle(animation), animation->context);
+  }
+  if (animation->implementation.setup) {
+    animation->implementation.setup(prv_handle(animation));
+  }
+}
+
+static void prv_stop(HostAnimation *animation, bool finished) {
+  animation->finished = true;
+  if (!animation->parent) {
+    // A stopped handler may schedule it again
+    animation->scheduled = false;
+  }
+  if (animation->implementation.teardown) {
+    animation->implementation.teardown(prv_handle(animation));
+  }
+  if (animation->handlers.stopped) {
+    animation->handlers.stopped(prv_handle(animation), finished, animation->context);
+  }
+}
+
+// Stops whatever part of the tree is running, without finishing it
+static void prv_interrupt(HostAnimation *animation) {
+  if (!animation->started || animation->finished) {
+    return;
+  }
+  for (int i = 0; i < animation->num_children; i++) {
+    prv_interrupt(animation->children[i]);
+  }
+  prv_stop(animation, false);
+}
+
+// Advances an animation to elapsed_ms after the start of its slot
+//  returns: true once it has finished
+static bool prv_advance(HostAnimation *animation, int64_t elapsed_ms) {
+  if (animation->finished) {
+    return true;
+  }
+  const int64_t local_ms = elapsed_ms - animation->delay_ms;
+  if (local_ms < 0) {
+    return false;
+  }
+  if (!animation->started) {
+    prv_start(animation);
+  }
+
+  HostAnimation *root = prv_root(animation);
+  switch (animation->kind) {
+    case KindSimple: {
+      const bool infinite = (animation->duration_ms == ANIMATION_DURATION_INFINITE);
+      const bool done = !infinite && local_ms >= animation->duration_ms;
+      int64_t progress = ANIMATION_NORMALIZED_MAX;
+      if (infinite) {
+        progress = ANIMATION_NORMALIZED_MIN;
+      } else if (!done) {
+        progress = local_ms * ANIMATION_NORMALIZED_MAX / animation->duration_ms;
+      }
+      if (animation->implementation.update) {
+        animation->implementation.update(prv_handle(animation),
+                                         prv_apply_curve(animation->curve, progress));
+      }
+      if (!done) {
+        return false;
+      }
+      break;
+    }
+    case KindSequence: {
+      int64_t offset_ms = 0;
+      for (int i = 0; i < animation->num_children; i++) {
+        HostAnimation *child = animation->children[i];
+        if (!prv_advance(child, local_ms - offset_ms) || root->dead || !root->scheduled) {
+          return false;
+        }
+        offset_ms += prv_total_ms(child);
+      }
+      break;
+    }
+    case KindSpawn: {
+      bool done = true;
+      for (int i = 0; i < animation->num_children; i++) {
+        done &= prv_advance(animation->children[i], local_ms);
+        if (root->dead || !root->scheduled) {
+          return false;
+        }
+      }
+      if (!done) {
+        return false;
+      }
+      break;
+    }
+  }
+
+  prv_stop(animation, true);
+  return true;
+}
+
+static void prv_frame(void *data) {
+  s_frame_event = NULL;
+
+  // Handlers may schedule or destroy animations, so work from a snapshot
+  uintptr_t ids[MAX_SCHEDULED];
+  int num_ids = 0;
+  for (HostAnimation *animation = s_animations; animation && num_ids < MAX_SCHEDULED;
+       animation = animation->next) {
+    if (animation->scheduled) {
+      ids[num_ids++] = animation->id;
+    }
+  }
+
+  const uint64_t now = host_time_ms();
+  for (int i = 0; i < num_ids; i++) {
+    HostAnimation *animation = prv_lookup((Animation *)ids[i]);
+    if (!animation || !animation->scheduled) {
+      continue;
+    }
+    if (prv_advance(animation, now - animation->start_ms) && !animation->dead && !animation->scheduled) {
+      prv_kill(animation);
+    }
+  }
+
+  for (HostAnimation *animation = s_animations; animation; animation = animation->next) {
+    if (animation->scheduled) {
+      s_frame_event = host_event_schedule(ANIMATION_FRAME_MS, prv_frame, NULL);
+      break;
+    }
+  }
+}
+
+/****** API ******/
+
+static HostAnimation *prv_create(Kind kind) {
+  HostAnimation *animation = malloc(sizeof(HostAnimation));
+  if (!animation) {
+    return NULL;
+  }
+  *animation = (HostAnimation) {
+    .id = s_next_id++,
+    .kind = kind,
+    .duration_ms = DEFAULT_DURATION_MS,
+    .curve = AnimationCurveDefault,
+    .next = s_animations,
+  };
+  s_animations = animation;
+  return animation;
+}
+
+// Only animations that are not running can be changed
+static HostAnimation *prv_lookup_mutable(Animation *handle) {
+  HostAnimation *animation = prv_lookup(handle);
+  if (!animation || prv_root(animation)->scheduled) {
+    return NULL;
+  }
+  return animation;
+}
+
+Animation *animation_create(void) {
+  HostAnimation *animation = prv_create(KindSimple);
+  return animation ? prv_handle(animation) : NULL;
+}
+
+bool animation_destroy(Animation *handle) {
+  HostAnimation *animation = prv_lookup(handle);
+  if (!animation || animation->parent) {
+    return false;
+  }
+  if (animation->scheduled) {
+    animation->scheduled = false;
+    prv_interrupt(animation);
+  }
+  if (!animation->dead) {
+    prv_kill(animation);
+  }
+  return true;
+}
+
+bool animation_set_duration(Animation *handle, uint32_t duration_ms) {
+  HostAnimation *animation = prv_lookup_mutable(handle);
+  if (!animation || animation->kind != KindSimple) {
+    return false;
+  }
+  animation->duration_ms = duration_ms;
+  return true;
+}
+
+bool animation_set_delay(Animation *handle, uint32_t delay_ms) {
+  HostAnimation *animation = prv_lookup_mutable(handle);
+  if (!animation) {
+    return false;
+  }
+  animation->delay_ms = delay_ms;
+  return true;
+}
+
+bool animation_set_curve(Animation *handle, AnimationCurve curve) {
+  HostAnimation *animation = prv_lookup_mutable(handle);
+  if (!animation) {
+    return false;
+  }
+  animation->curve = curve;
+  return true;
+}
+
+bool animation_set_handlers(Animation *handle, AnimationHandlers callbacks, void *context) {
+  HostAnimation *animation = prv_lookup_mutable(handle);
+  if (!animation) {
+    return false;
+  }
+  animation->handlers = callbacks;
+  animation->context = context;
+  return true;
+}
+
+void *animation_get_context(Animation *handle) {
+  HostAnimation *animation = prv_lookup(handle);
+  return animation ? animation->context : NULL;
+}
+
+bool animation_set_implementation(Animation *handle, const AnimationImplementation *implementation) {
+  HostAnimation *animation = prv_lookup_mutable(handle);
+  if (!animation || animation->kind != KindSimple) {
+    return false;
+  }
+  animation->implementation = *implementation;
+  return true;
+}
+
+bool animation_schedule(Animation *handle) {
+  HostAnimation *animation = prv_lookup(handle);
+  if (!animation || animation->parent) {
+    return false;
+  }
+  if (animation->scheduled) {
+    // Scheduling again restarts it
+    prv_interrupt(animation);
+  }
+
+  prv_reset(animation);
+  animation->scheduled = true;
+  animation->start_ms = host_time_ms();
+  if (!s_frame_event) {
+    s_frame_event = host_event_schedule(0, prv_frame, NULL);
+  }
+  return true;
+}
+
+bool animation_unschedule(Animation *handle) {
+  HostAnimation *animation = prv_lookup(handle);
+  if (!animation || !animation->scheduled) {
+    return false;
+  }
+  animation->scheduled = false;
+  prv_interrupt(animation);
+  // unless a stopped handler scheduled it again
+  if (!animation->dead && !animation->scheduled) {
+    prv_kill(animation);
+  }
+  return true;
+}
+
+void animation_unschedule_all(void) {
+  uintptr_t ids[MAX_SCHEDULED];
+  int num_ids = 0;
+  for (HostAnimation *animation = s_animations; animation && num_ids < MAX_SCHEDULED;
+       animation = animation->next) {
+    if (animation->scheduled) {
+      ids[num_ids++] = animation->id;
+    }
+  }
+  for (int i = 0; i < num_ids; i++) {
+    animation_unschedule((Animation *)ids[i]);
+  }
+}
+
+bool animation_is_scheduled(Animation *handle) {
+  HostAnimation *animation = prv_lookup(handle);
+  return animation && prv_root(animation)->scheduled;
+}
+
+// The first three children are named parameters, any further ones follow in args up to a NULL
+static Animation *prv_create_complex(Kind kind, Animation *const named[3], va_list args) {
+  HostAnimation *children[MAX_CHILDREN];
+  int num_children = 0;
+  for (int i = 0;; i++) {
+    Animation *handle = i < 3 ? named[i] : va_arg(args, Animation *);
+    if (!handle) {
+      break;
+    }
+    HostAnimation *child = prv_lookup(handle);
+    if (!child || child->parent || child->scheduled || num_children == MAX_CHILDREN) {
+      return NULL;
+    }
+    children[num_children++] = child;
+  }
+  if (!num_children) {
+    return NULL;
+  }
+
+  HostAnimation *animation = prv_create(kind);
+  if (!animation) {
+    return NULL;
+  }
+  for (int i = 0; i < num_children; i++) {
+    children[i]->parent = animation;
+    animation->children[i] = children[i];
+  }
+  animation->num_children = num_children;
+  return prv_handle(animation);
+}
+
+Animation *animation_sequence_create(Animation *animation_a, Animation *animation_b, Animation *animation_c, ...) {
+  va_list args;
+  va_start(args, animation_c);
+  Animation *const named[3] = { animation_a, animation_b, animation_c };
+  Animation *animation = prv_create_complex(KindSequence, named, args);
+  va_end(args);
+  return animation;
+}
+
+Animation *animation_spawn_create(Animation *animation_a, Animation *animation_b, Animation *animation_c, ...) {
+  va_list args;
+  va_start(args, animation_c);
+  Animation *const named[3] = { animation_a, animation_b, animation_c };
+  Animation *animation = prv_create_complex(KindSpawn, named, args);
+  va_end(args);
+  return animation;
+}
+
+/****** PropertyAnimation ******/
+
+static void prv_property_setup(Animation *handle) {
+  HostAnimation *animation = prv_lookup(handle);
+  if (!animation->has_from) {
+    animation->from = layer_get_frame(animation->layer);
+  }
+  if (!animation->has_to) {
+    animation->to = layer_get_frame(animation->layer);
+  }
+}
+
+static int16_t prv_interpolate(int16_t from, int16_t to, AnimationProgress progress) {
+  return from + (int16_t)(((int32_t)(to - from) * progress) / ANIMATION_NORMALIZED_MAX);
+}
+
+static void prv_property_update(Animation *handle, const AnimationProgress progress) {
+  HostAnimation *animation = prv_lookup(handle);
+  layer_set_frame(animation->layer, GRect(
+    prv_interpolate(animation->from.origin.x, animation->to.origin.x, progress),
+    prv_interpolate(animation->from.origin.y, animation->to.origin.y, progress),
+    prv_interpolate(animation->from.size.w, animation->to.size.w, progress),
+    prv_interpolate(animation->from.size.h, animation->to.size.h, progress)));
+}
+
+static const AnimationImplementation s_property_implementation = {
+  .setup = prv_property_setup,
+  .update = prv_property_update,
+};
+
+PropertyAnimation *property_animation_create_layer_frame(struct Layer *layer, GRect *from_frame, GRect *to_frame) {
+  HostAnimation *animation = prv_create(KindSimple);
+  if (!animation) {
+    return NULL;
+  }
+  animation->implementation = s_property_implementation;
+  animation->layer = layer;
+  if (from_frame) {
+    animation->has_from = true;
+    animation->from = *from_frame;
+  }
+  if (to_frame) {
+    animation->has_to = true;
+    animation->to = *to_frame;
+  }
+  // A property animation is its animation, as in SDK 3
+  return (PropertyAnimation *)prv_handle(animation);
+}
+
+Animation *property_animation_get_animation(PropertyAnimation *property_animation) {
+  return (Animation *)property_animation;
+}
+
+void property_animation_destroy(PropertyAnimation *property_animation) {
+  animation_destroy((Animation *)property_animation);
+}
@@ -0,0 +1,441 @@
+#include <pebble.h>
+#include "host.h"
+#include "host_strap.h"
+#include "fake_strap.h"
+#include "strap_protocol.h"
+
+// Mirrors the firmware constants of arduino/smartstrap/smartstrap.ino
+#define STREAM_RING_SIZE 64
+#define STREAM_RENOTIFY_MS 100
+#define NOTIFY_TOKEN 1000
+#define MAX_RESPONSE_LENGTH STRAP_STREAM_LENGTH
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+
+typedef struct {
+  uint8_t deadband;
+  uint16_t min_interval;
+  uint16_t max_interval;
+} NotifySchedule;
+
+typedef struct {
+  bool is_write;
+  SmartstrapAttributeId attribute_id;
+  SmartstrapResult result;
+  // Output writes reach the pins when the ACK goes out
+  uint8_t outputs_mask;
+  uint8_t output_values[FAKE_STRAP_NUM_CHANNELS];
+  size_t length;
+  uint8_t data[MAX_RESPONSE_LENGTH];
+} Response;
+
+static FakeStrapConfig s_config = {
+  .read_latency_ms = 4,
+  .write_latency_ms = 4,
+  .notify_latency_ms = 1,
+  .loop_period_ms = 1,
+};
+static FakeStrapStats s_stats;
+
+static bool s_connected;
+static HostEvent *s_loop_event;
+static Response s_response;
+
+static FakeStrapInputSource s_input_source;
+static void *s_input_source_context;
+static FakeStrapOutputHandler s_output_handler;
+static void *s_output_handler_context;
+static uint8_t s_inputs[FAKE_STRAP_NUM_CHANNELS];
+static uint8_t s_outputs[FAKE_STRAP_NUM_CHANNELS];
+
+// Notify scheduling
+static NotifySchedule s_schedules[FAKE_STRAP_NUM_CHANNELS];
+static uint8_t s_last_values_notified[FAKE_STRAP_NUM_CHANNELS];
+static uint32_t s_notified_times[FAKE_STRAP_NUM_CHANNELS];
+static uint8_t s_notify_rate;
+static uint8_t s_notify_burst;
+static uint32_t s_notify_tokens;
+static uint32_t s_notify_tokens_time;
+static uint16_t s_all_inputs_sequence;
+static uint32_t s_all_inputs_notified_time;
+
+// Streaming
+static uint8_t s_stream_ring[STREAM_RING_SIZE][STRAP_STREAM_SAMPLE_LENGTH];
+static uint8_t s_stream_head;
+static uint8_t s_stream_tail;
+static uint8_t s_stream_overflow;
+static uint16_t s_stream_sequence;
+static uint8_t s_stream_sample_period;
+static uint8_t s_stream_block_samples;
+static uint32_t s_stream_sample_time;
+static bool s_stream_notified;
+static uint32_t s_stream_notified_time;
+
+static uint32_t prv_millis(void) {
+  return (uint32_t)host_time_ms();
+}
+
+/****** Firmware state ******/
+
+static void prv_reset_firmware(void) {
+  const uint32_t now = prv_millis();
+  s_schedules[0] = (NotifySchedule) { 0, 50, 0 };
+  s_schedules[1] = (NotifySchedule) { 2, 50, 500 };
+  s_schedules[2] = (NotifySchedule) { 2, 50, 500 };
+  s_notify_rate = 20;
+  s_notify_burst = 4;
+  s_notify_tokens = s_notify_burst * NOTIFY_TOKEN;
+  s_notify_tokens_time = now;
+  for (int i = 0; i < FAKE_STRAP_NUM_CHANNELS; i++) {
+    s_last_values_notified[i] = 0;
+    s_notified_times[i] = now;
+  }
+  s_all_inputs_sequence = 0;
+  s_all_inputs_notified_time = 0;
+  s_stream_sample_period = 0;
+}
+
+static uint8_t prv_stream_count(void) {
+  return s_stream_head - s_stream_tail;
+}
+
+static void prv_stream_reset(uint8_t sample_period, uint8_t block_samples) {
+  s_stream_head = 0;
+  s_stream_tail = 0;
+  s_stream_overflow = 0;
+  s_stream_sample_period = sample_period;
+  s_stream_block_samples = MIN(MAX(block_samples, 1), STRAP_STREAM_MAX_SAMPLES);
+  s_stream_sample_time = prv_millis();
+  s_stream_notified = false;
+}
+
+static void prv_stream_push(const uint8_t *values) {
+  if (prv_stream_count() == STREAM_RING_SIZE) {
+    s_stream_tail++;
+    if (s_stream_overflow < 255) {
+      s_stream_overflow++;
+    }
+  }
+  memcpy(s_stream_ring[s_stream_head & (STREAM_RING_SIZE - 1)], values, STRAP_STREAM_SAMPLE_LENGTH);
+  s_stream_head++;
+}
+
+static void prv_notify_configure(const uint8_t *config) {
+  for (int i = 0; i < FAKE_STRAP_NUM_CHANNELS; i++) {
+    const uint8_t *schedule = &config[i * STRAP_NOTIFY_SCHEDULE_LENGTH];
+    s_schedules[i].deadband = schedule[0];
+    s_schedules[i].min_interval = schedule[1] | (schedule[2] << 8);
+    s_schedules[i].max_interval = schedule[3] | (schedule[4] << 8);
+  }
+  s_notify_rate = config[FAKE_STRAP_NUM_CHANNELS * STRAP_NOTIFY_SCHEDULE_LENGTH];
+  s_notify_burst = MAX(config[FAKE_STRAP_NUM_CHANNELS * STRAP_NOTIFY_SCHEDULE_LENGTH + 1], 1);
+  s_notify_tokens = MIN(s_notify_tokens, s_notify_burst * NOTIFY_TOKEN);
+}
+
+static void prv_notify_refill_tokens(uint32_t now) {
+  const uint32_t capacity = s_notify_burst * NOTIFY_TOKEN;
+  const uint32_t elapsed = MIN(now - s_notify_tokens_time, 60000u);
+  s_notify_tokens_time = now;
+  if (s_notify_rate == 0) {
+    s_notify_tokens = capacity;
+  } else {
+    s_notify_tokens = MIN(s_notify_tokens + elapsed * s_notify_rate, capacity);
+  }
+}
+
+static bool prv_should_notify_input(int input, uint8_t new_value, uint32_t now) {
+  const NotifySchedule *schedule = &s_schedules[input];
+  const uint8_t difference = abs(new_value - s_last_values_notified[input]);
+  if (difference == 0) {
+    return false;
+  }
+  const uint32_t elapsed = now - s_notified_times[input];
+  if (elapsed < schedule->min_interval) {
+    return false;
+  }
+  if (difference > schedule->deadband) {
+    return true;
+  }
+  return schedule->max_interval && elapsed >= schedule->max_interval;
+}
+
+static void prv_deliver_notify(void *data) {
+  if (s_connected) {
+    host_strap_notified(STRAP_SERVICE_ID, (SmartstrapAttributeId)(uintptr_t)data);
+  }
+}
+
+static void prv_notify(SmartstrapAttributeId attribute_id) {
+  s_stats.notifies++;
+  host_event_schedule(s_config.notify_latency_ms, prv_deliver_notify, (void *)(uintptr_t)attribute_id);
+}
+
+// One pass of the firmware loop()
+static void prv_loop(void *data) {
+  s_loop_event = NULL;
+  if (!s_connected) {
+    return;
+  }
+
+  const uint32_t now = prv_millis();
+  uint8_t values[FAKE_STRAP_NUM_CHANNELS];
+  for (int i = 0; i < FAKE_STRAP_NUM_CHANNELS; i++) {
+    values[i] = s_input_source ? s_input_source(i, host_time_ms(), s_input_source_context) : s_inputs[i];
+  }
+
+  if (s_stream_sample_period && now - s_stream_sample_time >= s_stream_sample_period) {
+    s_stream_sample_time = MAX(s_stream_sample_time + s_stream_sample_period, now - s_stream_sample_period);
+    prv_stream_push(values);
+  }
+
+  if (s_stream_sample_period) {
+    const bool renotify = s_stream_notified && (now - s_stream_notified_time >= STREAM_RENOTIFY_MS);
+    if (prv_stream_count() >= s_stream_block_samples && (!s_stream_notified || renotify)) {
+      s_stream_notified = true;
+      s_stream_notified_time = now;
+      prv_notify(STRAP_STREAM_ATTRIBUTE_ID);
+    }
+  } else {
+    prv_notify_refill_tokens(now);
+    uint8_t notify_mask = 0;
+    if (s_notify_tokens >= NOTIFY_TOKEN) {
+      for (int i = 0; i < FAKE_STRAP_NUM_CHANNELS; i++) {
+        if (prv_should_notify_input(i, values[i], now)) {
+          s_last_values_notified[i] = values[i];
+          s_notified_times[i] = now;
+          notify_mask |= 1 << i;
+        }
+      }
+    }
+    if (notify_mask) {
+      s_notify_tokens -= NOTIFY_TOKEN;
+      s_all_inputs_sequence++;
+      s_all_inputs_notified_time = now;
+      if (!s_config.no_all_inputs) {
+        prv_notify(STRAP_ALL_INPUTS_ATTRIBUTE_ID);
+      } else {
+        // Firmware without the all-inputs attribute notifies each changed input
+        static const SmartstrapAttributeId input_ids[FAKE_STRAP_NUM_CHANNELS] = {
+          STRAP_TOP_INPUT_ATTRIBUTE_ID, STRAP_CENTER_INPUT_ATTRIBUTE_ID, STRAP_BOTTOM_INPUT_ATTRIBUTE_ID
+        };
+        for (int i = 0; i < FAKE_STRAP_NUM_CHANNELS; i++) {
+          if (notify_mask & (1 << i)) {
+            prv_notify(input_ids[i]);
+          }
+        }
+      }
+    }
+  }
+
+  s_loop_event = host_event_schedule(s_config.loop_period_ms, prv_loop, NULL);
+}
+
+/****** Requests ******/
+
+static int prv_input_channel(SmartstrapAttributeId attribute_id) {
+  switch (attribute_id) {
+    case STRAP_TOP_INPUT_ATTRIBUTE_ID:
+      return 0;
+    case STRAP_CENTER_INPUT_ATTRIBUTE_ID:
+      return 1;
+    case STRAP_BOTTOM_INPUT_ATTRIBUTE_ID:
+      return 2;
+    default:
+      return -1;
+  }
+}
+
+static int prv_output_channel(SmartstrapAttributeId attribute_id) {
+  switch (attribute_id) {
+    case STRAP_TOP_OUTPUT_ATTRIBUTE_ID:
+      return 0;
+    case STRAP_CENTER_OUTPUT_ATTRIBUTE_ID:
+      return 1;
+    case STRAP_BOTTOM_OUTPUT_ATTRIBUTE_ID:
+      return 2;
+    default:
+      return -1;
+  }
+}
+
+static void prv_build_stream_block(void) {
+  const uint8_t count = MIN(prv_stream_count(), STRAP_STREAM_MAX_SAMPLES);
+  uint8_t *block = s_response.data;
+  block[0] = (uint8_t)s_stream_sequence;
+  block[1] = (uint8_t)(s_stream_sequence >> 8);
+  block[2] = count;
+  block[3] = s_stream_overflow;
+  for (uint8_t i = 0; i < count; i++) {
+    memcpy(&block[STRAP_STREAM_HEADER_LENGTH + i * STRAP_STREAM_SAMPLE_LENGTH],
+           s_stream_ring[s_stream_tail & (STREAM_RING_SIZE - 1)], STRAP_STREAM_SAMPLE_LENGTH);
+    s_stream_tail++;
+  }
+  s_stream_sequence++;
+  s_stream_overflow = 0;
+  s_stream_notified = false;
+  s_response.length = STRAP_STREAM_HEADER_LENGTH + count * STRAP_STREAM_SAMPLE_LENGTH;
+}
+
+static void prv_deliver_response(void *data) {
+  if (!s_connected) {
+    return;
+  }
+  if (!s_response.is_write) {
+    host_strap_did_read(STRAP_SERVICE_ID, s_response.attribute_id, s_response.result, s_response.data,
+                        s_response.length);
+    return;
+  }
+
+  for (int i = 0; i < FAKE_STRAP_NUM_CHANNELS; i++) {
+    if (s_response.outputs_mask & (1 << i)) {
+      s_outputs[i] = s_response.output_values[i];
+      s_stats.output_updates[i]++;
+      if (s_output_handler) {
+        s_output_handler(i, s_outputs[i], s_output_handler_context);
+      }
+    }
+  }
+  host_strap_did_write(STRAP_SERVICE_ID, s_response.attribute_id, s_response.result);
+}
+
+static SmartstrapResult prv_read(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id) {
+  s_response = (Response) {
+    .attribute_id = attribute_id,
+    .result = SmartstrapResultOk,
+  };
+  s_stats.reads++;
+
+  const int channel = prv_input_channel(attribute_id);
+  if (service_id != STRAP_SERVICE_ID) {
+    s_response.result = SmartstrapResultServiceUnavailable;
+  } else if (channel >= 0) {
+    s_response.data[0] = s_last_values_notified[channel];
+    s_response.length = STRAP_ATTRIBUTE_LENGTH;
+  } else if (attribute_id == STRAP_ALL_INPUTS_ATTRIBUTE_ID && !s_config.no_all_inputs) {
+    uint8_t *frame = s_response.data;
+    memcpy(frame, s_last_values_notified, FAKE_STRAP_NUM_CHANNELS);
+    frame[3] = (uint8_t)s_all_inputs_sequence;
+    frame[4] = (uint8_t)(s_all_inputs_sequence >> 8);
+    frame[5] = (uint8_t)s_all_inputs_notified_time;
+    frame[6] = (uint8_t)(s_all_inputs_notified_time >> 8);
+    frame[7] = (uint8_t)(s_all_inputs_notified_time >> 16);
+    frame[8] = (uint8_t)(s_all_inputs_notified_time >> 24);
+    s_response.length = STRAP_ALL_INPUTS_LENGTH;
+  } else if (attribute_id == STRAP_STREAM_ATTRIBUTE_ID && !s_config.no_stream) {
+    prv_build_stream_block();
+  } else {
+    s_response.result = SmartstrapResultAttributeUnsupported;
+  }
+
+  host_event_schedule(s_config.read_latency_ms, prv_deliver_response, NULL);
+  return SmartstrapResultOk;
+}
+
+static SmartstrapResult prv_write(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id,
+                                  const uint8_t *data, size_t length, bool request_read) {
+  s_response = (Response) {
+    .is_write = true,
+    .attribute_id = attribute_id,
+    .result = SmartstrapResultOk,
+  };
+  s_stats.writes++;
+
+  const int channel = prv_output_channel(attribute_id);
+  if (service_id != STRAP_SERVICE_ID) {
+    s_response.result = SmartstrapResultServiceUnavailable;
+  } else if (channel >= 0 && length == STRAP_ATTRIBUTE_LENGTH) {
+    s_response.outputs_mask = 1 << channel;
+    s_response.output_values[channel] = data[0];
+  } else if (attribute_id == STRAP_ALL_OUTPUTS_ATTRIBUTE_ID && !s_config.no_all_outputs &&
+             length == STRAP_ALL_OUTPUTS_LENGTH) {
+    s_response.outputs_mask = data[0] & ((1 << FAKE_STRAP_NUM_CHANNELS) - 1);
+    memcpy(s_response.output_values, &data[1], FAKE_STRAP_NUM_CHANNELS);
+  } else if (attribute_id == STRAP_STREAM_CONFIG_ATTRIBUTE_ID && !s_config.no_stream &&
+             length == STRAP_STREAM_CONFIG_LENGTH) {
+    prv_stream_reset(data[0], data[1]);
+  } else if (attribute_id == STRAP_NOTIFY_CONFIG_ATTRIBUTE_ID && length == STRAP_NOTIFY_CONFIG_LENGTH) {
+    prv_notify_configure(data);
+  } else if (attribute_id == STRAP_LOCAL_ROUTES_ATTRIBUTE_ID && length >= STRAP_LOCAL_ROUTES_HEADER_LENGTH &&
+             data[2] <= STRAP_LOCAL_ROUTES_MAX &&
+             length == (size_t)(STRAP_LOCAL_ROUTES_HEADER_LENGTH + data[2] * STRAP_LOCAL_ROUTE_LENGTH)) {
+    // Accepted, but never run: the fake strap stops with the app that would hand the routes over
+  } else {
+    // The firmware NACKs writes it does not understand
+    s_response.result = SmartstrapResultAttributeUnsupported;
+  }
+
+  host_event_schedule(s_config.write_latency_ms, prv_deliver_response, NULL);
+  return SmartstrapResultOk;
+}
+
+static void prv_connect(void) {
+  s_connected = true;
+  prv_reset_firmware();
+  if (!s_loop_event) {
+    s_loop_event = host_event_schedule(s_config.loop_period_ms, prv_loop, NULL);
+  }
+}
+
+static void prv_disconnect(void) {
+  s_connected = false;
+  host_event_cancel(s_loop_event);
+  s_loop_event = NULL;
+}
+
+static bool prv_is_available(SmartstrapServiceId service_id) {
+  return s_connected && service_id == STRAP_SERVICE_ID;
+}
+
+static const HostStrapTransport s_transport = {
+  .connect = prv_connect,
+  .disconnect = prv_disconnect,
+  .is_available = prv_is_available,
+  .read = prv_read,
+  .write = prv_write,
+};
+
+/****** API ******/
+
+const HostStrapTransport *fake_strap_get_transport(void) {
+  return &s_transport;
+}
+
+void fake_strap_set_config(const FakeStrapConfig *config) {
+  s_config = *config;
+  if (!s_config.loop_period_ms) {
+    s_config.loop_period_ms = 1;
+  }
+}
+
+FakeStrapConfig fake_strap_get_config(void) {
+  return s_config;
+}
+
+void fake_strap_set_input(int channel, uint8_t value) {
+  if (channel >= 0 && channel < FAKE_STRAP_NUM_CHANNELS) {
+    s_inputs[channel] = value;
+  }
+}
+
+void fake_strap_set_input_source(FakeStrapInputSource source, void *context) {
+  s_input_source = source;
+  s_input_source_context = context;
+}
+
+void fake_strap_set_output_handler(FakeStrapOutputHandler handler, void *context) {
+  s_output_handler = handler;
+  s_output_handler_context = context;
+}
+
+uint8_t fake_strap_get_output(int channel) {
+  return (channel >= 0 && channel < FAKE_STRAP_NUM_CHANNELS) ? s_outputs[channel] : 0;
+}
+
+FakeStrapStats fake_strap_get_stats(void) {
+  return s_stats;
+}
+
+void fake_strap_reset_stats(void) {
+  s_stats = (FakeStrapStats) { 0 };
+}
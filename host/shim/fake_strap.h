@@ -0,0 +1,58 @@
+#pragma once
+
+#include <pebble.h>
+
+// In-process stand-in for arduino/smartstrap/smartstrap.ino. It serves the same service and
+// attributes through the shim's smartstrap API and runs the firmware's notify and streaming logic
+// on the virtual clock. The input filters are left out: fake inputs carry no ADC noise. Local
+// routes are accepted but never run, since the fake strap disconnects along with the app.
+
+#define FAKE_STRAP_NUM_CHANNELS 3
+
+typedef struct FakeStrapConfig {
+  // Time from a request to its response on the bus
+  uint32_t read_latency_ms;
+  uint32_t write_latency_ms;
+  // Time from a firmware notify to the watch's notified handler
+  uint32_t notify_latency_ms;
+  // Period of the firmware loop()
+  uint32_t loop_period_ms;
+  // Attributes older firmware does not have, answered with SmartstrapResultAttributeUnsupported
+  bool no_all_inputs;
+  bool no_all_outputs;
+  bool no_stream;
+} FakeStrapConfig;
+
+typedef struct FakeStrapStats {
+  uint32_t notifies;
+  uint32_t reads;
+  uint32_t writes;
+  // Values applied to each output
+  uint32_t output_updates[FAKE_STRAP_NUM_CHANNELS];
+} FakeStrapStats;
+
+// Gives the value of an input at a point in time, called on every firmware loop
+typedef uint8_t (*FakeStrapInputSource)(int channel, uint64_t now_ms, void *context);
+// Called when a write reaches an output
+typedef void (*FakeStrapOutputHandler)(int channel, uint8_t value, void *context);
+
+/*
+ * Gets the transport the shim's smartstrap API uses when no other one is set
+ */
+const struct HostStrapTransport *fake_strap_get_transport(void);
+
+void fake_strap_set_config(const FakeStrapConfig *config);
+FakeStrapConfig fake_strap_get_config(void);
+
+/*
+ * Sets an input, picked up by the next firmware loop. Ignored while an input source is set
+ */
+void fake_strap_set_input(int channel, uint8_t value);
+
+void fake_strap_set_input_source(FakeStrapInputSource source, void *context);
+void fake_strap_set_output_handler(FakeStrapOutputHandler handler, void *context);
+
+uint8_t fake_strap_get_output(int channel);
+
+FakeStrapStats fake_strap_get_stats(void);
+void fake_strap_reset_stats(void);
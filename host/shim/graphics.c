@@ -0,0 +1,308 @@
+#include <pebble.h>
+#include "host.h"
+
+// Recorded ops are harness memory, not app memory
+#undef malloc
+#undef calloc
+#undef free
+
+struct GContext {
+  // Screen position of the bounds origin of the layer being drawn, and its clip in screen space
+  GPoint origin;
+  GRect clip;
+  GColor fill_color;
+  GColor stroke_color;
+  GColor text_color;
+  GCompOp compositing_mode;
+};
+
+struct HostFont {
+  const char *key;
+  int16_t height;
+};
+
+struct GBitmap {
+  GSize size;
+  GBitmapFormat format;
+  uint8_t *data;
+};
+
+static GContext s_context;
+// Draw ops are only recorded, so the frame buffer holds whatever the app copied into it
+static uint8_t s_frame_buffer_data[HOST_SCREEN_WIDTH * HOST_SCREEN_HEIGHT];
+static GBitmap s_frame_buffer = {
+  .size = { HOST_SCREEN_WIDTH, HOST_SCREEN_HEIGHT },
+  .format = GBitmapFormat8Bit,
+  .data = s_frame_buffer_data,
+};
+static bool s_frame_buffer_captured;
+static HostDrawStats s_draw_stats;
+
+static bool s_recording;
+static HostDrawOp *s_ops;
+static size_t s_num_ops;
+static size_t s_ops_capacity;
+
+/****** Geometry ******/
+
+bool grect_equal(const GRect *const rect_a, const GRect *const rect_b) {
+  return rect_a->origin.x == rect_b->origin.x && rect_a->origin.y == rect_b->origin.y &&
+         rect_a->size.w == rect_b->size.w && rect_a->size.h == rect_b->size.h;
+}
+
+bool gsize_equal(const GSize *size_a, const GSize *size_b) {
+  return size_a->w == size_b->w && size_a->h == size_b->h;
+}
+
+bool gcolor_equal(GColor8 x, GColor8 y) {
+  return x.argb == y.argb;
+}
+
+GRect host_grect_intersect(GRect a, GRect b) {
+  const int x0 = a.origin.x > b.origin.x ? a.origin.x : b.origin.x;
+  const int y0 = a.origin.y > b.origin.y ? a.origin.y : b.origin.y;
+  const int x1 = (a.origin.x + a.size.w) < (b.origin.x + b.size.w) ? (a.origin.x + a.size.w)
+                                                                    : (b.origin.x + b.size.w);
+  const int y1 = (a.origin.y + a.size.h) < (b.origin.y + b.size.h) ? (a.origin.y + a.size.h)
+                                                                    : (b.origin.y + b.size.h);
+  if (x1 <= x0 || y1 <= y0) {
+    return GRectZero;
+  }
+  return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+/****** Fonts ******/
+
+static struct HostFont s_fonts[] = {
+  { FONT_KEY_GOTHIC_14, 14 },
+  { FONT_KEY_GOTHIC_14_BOLD, 14 },
+  { FONT_KEY_GOTHIC_18, 18 },
+  { FONT_KEY_GOTHIC_18_BOLD, 18 },
+  { FONT_KEY_GOTHIC_24, 24 },
+  { FONT_KEY_GOTHIC_24_BOLD, 24 },
+  { FONT_KEY_GOTHIC_28, 28 },
+  { FONT_KEY_GOTHIC_28_BOLD, 28 },
+};
+
+GFont fonts_get_system_font(const char *font_key) {
+  for (size_t i = 0; i < ARRAY_LENGTH(s_fonts); i++) {
+    if (strcmp(s_fonts[i].key, font_key) == 0) {
+      return &s_fonts[i];
+    }
+  }
+  // The firmware falls back to its default font too
+  return &s_fonts[0];
+}
+
+/****** Bitmaps ******/
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format) {
+  GBitmap *bitmap = host_malloc(sizeof(GBitmap) + (size_t)size.w * size.h);
+  *bitmap = (GBitmap) { .size = size, .format = format, .data = (uint8_t *)(bitmap + 1) };
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  // Resources are not packed on the host, every image is a placeholder
+  return gbitmap_create_blank(GSize(16, 16), GBitmapFormat8Bit);
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  host_free(bitmap);
+}
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+  return GRect(0, 0, bitmap->size.w, bitmap->size.h);
+}
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+  return bitmap->data;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+  return bitmap->format == GBitmapFormat8Bit ? bitmap->size.w : (bitmap->size.w + 31) / 32 * 4;
+}
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y) {
+  return (GBitmapDataRowInfo) {
+    .data = bitmap->data + (size_t)y * gbitmap_get_bytes_per_row(bitmap),
+    .min_x = 0,
+    .max_x = bitmap->size.w - 1,
+  };
+}
+
+/****** Recording ******/
+
+GContext *host_graphics_begin_frame(void) {
+  s_context = (GContext) {
+    .clip = GRect(0, 0, HOST_SCREEN_WIDTH, HOST_SCREEN_HEIGHT),
+    .fill_color = GColorBlack,
+    .stroke_color = GColorBlack,
+    .text_color = GColorBlack,
+  };
+  s_draw_stats.frames++;
+  return &s_context;
+}
+
+void host_graphics_set_origin(GContext *ctx, GPoint origin, GRect clip) {
+  ctx->origin = origin;
+  ctx->clip = clip;
+}
+
+void host_graphics_get_origin(GContext *ctx, GPoint *origin, GRect *clip) {
+  *origin = ctx->origin;
+  *clip = ctx->clip;
+}
+
+void host_graphics_count_update(void) {
+  s_draw_stats.layer_updates++;
+}
+
+void host_layer_mark_dirty(void) {
+  s_draw_stats.dirty_marks++;
+}
+
+static void prv_record(GContext *ctx, HostDrawOpType type, GRect rect, GColor color, const char *text) {
+  rect.origin.x += ctx->origin.x;
+  rect.origin.y += ctx->origin.y;
+  rect = host_grect_intersect(rect, ctx->clip);
+
+  s_draw_stats.ops[type]++;
+  s_draw_stats.pixels += (uint64_t)rect.size.w * rect.size.h;
+
+  if (!s_recording) {
+    return;
+  }
+  if (s_num_ops == s_ops_capacity) {
+    s_ops_capacity = s_ops_capacity ? s_ops_capacity * 2 : 256;
+    s_ops = realloc(s_ops, s_ops_capacity * sizeof(HostDrawOp));
+  }
+  HostDrawOp *op = &s_ops[s_num_ops++];
+  *op = (HostDrawOp) { .type = type, .rect = rect, .color = color };
+  if (text) {
+    strncpy(op->text, text, sizeof(op->text) - 1);
+  }
+}
+
+HostDrawStats host_draw_get_stats(void) {
+  return s_draw_stats;
+}
+
+void host_draw_reset_stats(void) {
+  s_draw_stats = (HostDrawStats) { 0 };
+}
+
+void host_draw_set_recording(bool recording) {
+  s_recording = recording;
+  if (recording) {
+    s_num_ops = 0;
+  }
+}
+
+const HostDrawOp *host_draw_get_ops(size_t *count) {
+  *count = s_num_ops;
+  return s_ops;
+}
+
+/****** Graphics ******/
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+  ctx->stroke_color = color;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+  ctx->compositing_mode = mode;
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+  prv_record(ctx, HostDrawOpFillRect, rect, ctx->fill_color, NULL);
+}
+
+void graphics_draw_rect(GContext *ctx, GRect rect) {
+  prv_record(ctx, HostDrawOpDrawRect, rect, ctx->stroke_color, NULL);
+}
+
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+  const int16_t x = p0.x < p1.x ? p0.x : p1.x;
+  const int16_t y = p0.y < p1.y ? p0.y : p1.y;
+  const GRect rect = GRect(x, y, abs(p1.x - p0.x) + 1, abs(p1.y - p0.y) + 1);
+  prv_record(ctx, HostDrawOpDrawLine, rect, ctx->stroke_color, NULL);
+}
+
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  const GRect rect = GRect(p.x - radius, p.y - radius, 2 * radius + 1, 2 * radius + 1);
+  prv_record(ctx, HostDrawOpDrawCircle, rect, ctx->stroke_color, NULL);
+}
+
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  const GRect rect = GRect(p.x - radius, p.y - radius, 2 * radius + 1, 2 * radius + 1);
+  prv_record(ctx, HostDrawOpFillCircle, rect, ctx->fill_color, NULL);
+}
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+  prv_record(ctx, HostDrawOpDrawBitmap, rect, GColorClear, NULL);
+}
+
+// Like the firmware, hands the frame buffer out once until it is released
+GBitmap *graphics_capture_frame_buffer(GContext *ctx) {
+  if (s_frame_buffer_captured) {
+    return NULL;
+  }
+  s_frame_buffer_captured = true;
+  return &s_frame_buffer;
+}
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer) {
+  if (!s_frame_buffer_captured || buffer != &s_frame_buffer) {
+    return false;
+  }
+  s_frame_buffer_captured = false;
+  return true;
+}
+
+// Gothic glyphs average a little under half the font size in width
+static int16_t prv_text_width(const char *text, size_t length, GFont font) {
+  return (int16_t)(length * font->height * 9 / 20);
+}
+
+GSize graphics_text_layout_get_content_size(const char *text, GFont const font, const GRect box,
+                                            const GTextOverflowMode overflow_mode,
+                                            const GTextAlignment alignment) {
+  if (!text || !text[0]) {
+    return GSize(0, 0);
+  }
+
+  const int16_t width = prv_text_width(text, strlen(text), font);
+  if (overflow_mode != GTextOverflowModeWordWrap || box.size.w <= 0 || width <= box.size.w) {
+    return GSize(width < box.size.w || box.size.w <= 0 ? width : box.size.w, font->height);
+  }
+
+  const int16_t lines = (width + box.size.w - 1) / box.size.w;
+  const int16_t height = lines * font->height;
+  return GSize(box.size.w, height < box.size.h ? height : box.size.h);
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes *text_attributes) {
+  if (!text || !text[0]) {
+    return;
+  }
+
+  const GSize size = graphics_text_layout_get_content_size(text, font, box, overflow_mode, alignment);
+  GRect rect = GRect(box.origin.x, box.origin.y, size.w, size.h);
+  if (alignment == GTextAlignmentCenter) {
+    rect.origin.x += (box.size.w - size.w) / 2;
+  } else if (alignment == GTextAlignmentRight) {
+    rect.origin.x += box.size.w - size.w;
+  }
+  prv_record(ctx, HostDrawOpDrawText, rect, ctx->text_color, text);
+}
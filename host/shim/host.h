@@ -0,0 +1,154 @@
+#pragma once
+
+#include <pebble.h>
+
+// Host-only controls for driving the shim from a harness. None of this exists on the watch.
+
+#define HOST_SCREEN_WIDTH 144
+#define HOST_SCREEN_HEIGHT 168
+
+/****** Clock and event loop ******/
+
+typedef void (*HostCallback)(void *data);
+typedef struct HostEvent HostEvent;
+
+/*
+ * Gets the virtual time. It starts at 0 and only moves while events are dispatched, unless the clock
+ * follows the wall clock (see host_set_idle())
+ */
+uint64_t host_time_ms(void);
+
+/*
+ * Schedules a callback on the event loop
+ *  delay_ms: virtual time from now, 0 runs it on the next dispatch
+ *  returns: a handle that stays safe to cancel after the callback ran
+ */
+HostEvent *host_event_schedule(uint32_t delay_ms, HostCallback callback, void *data);
+
+/*
+ * Moves a pending event
+ *  returns: false if the event already ran or was cancelled
+ */
+bool host_event_reschedule(HostEvent *event, uint32_t delay_ms);
+
+/*
+ * Cancels a pending event
+ *  returns: false if the event already ran or was cancelled
+ */
+bool host_event_cancel(HostEvent *event);
+
+/*
+ * Dispatches every event due within the next duration_ms of virtual time, rendering the top window
+ * whenever a layer was marked dirty, then leaves the clock at the end of the period
+ */
+void host_run_for(uint32_t duration_ms);
+
+typedef void (*HostIdle)(uint32_t timeout_ms);
+
+/*
+ * Switches the clock to real time, for harnesses that talk to another process. From then on the
+ * clock follows the wall clock and, rather than jumping to the next due event, the event loop calls
+ * idle with the time left until it. idle waits at most that long for outside input and may
+ * schedule events for it. NULL goes back to virtual time
+ */
+void host_set_idle(HostIdle idle);
+
+typedef void (*HostMainLoop)(void);
+
+/*
+ * Replaces the body of app_event_loop(). Call it before the app's main() runs. Without one,
+ * app_event_loop() plays the script named by PEBBLE_HOST_SCRIPT, or runs for PEBBLE_HOST_RUN_MS
+ * (default 1000) of virtual time
+ */
+void host_set_main_loop(HostMainLoop main_loop);
+
+/*
+ * Plays a script of commands, one per line: run <ms>, click <button>, hold <button> <repeats>,
+ * input <channel> <value>, outputs, stats, quit. Lines starting with # are ignored
+ *  path: file to read, "-" for stdin
+ *  returns: false if the file cannot be read or a command is not understood
+ */
+bool host_run_script(const char *path);
+
+/****** Buttons ******/
+
+/*
+ * Clicks a button on the top window, as the click config of that window handles it
+ */
+void host_click(ButtonId button);
+
+/*
+ * Holds a button on the top window: one click, then repeats clicks every repeat interval of the
+ * subscribed handler, running the event loop in between
+ */
+void host_hold(ButtonId button, int repeats);
+
+/****** Heap ******/
+
+typedef struct HostHeapStats {
+  uint32_t allocs;
+  uint32_t frees;
+  size_t live_bytes;
+  size_t peak_bytes;
+} HostHeapStats;
+
+HostHeapStats host_heap_get_stats(void);
+void host_heap_reset_stats(void);
+
+/****** Drawing ******/
+
+typedef enum {
+  HostDrawOpFillRect,
+  HostDrawOpDrawRect,
+  HostDrawOpDrawLine,
+  HostDrawOpDrawCircle,
+  HostDrawOpFillCircle,
+  HostDrawOpDrawBitmap,
+  HostDrawOpDrawText,
+  HostDrawOpTypeCount,
+} HostDrawOpType;
+
+// One graphics call, in screen coordinates, clipped
+typedef struct HostDrawOp {
+  HostDrawOpType type;
+  GRect rect;
+  GColor color;
+  char text[24];
+} HostDrawOp;
+
+typedef struct HostDrawStats {
+  // Renders of the top window
+  uint32_t frames;
+  // layer_mark_dirty() calls
+  uint32_t dirty_marks;
+  // Update procs run
+  uint32_t layer_updates;
+  uint32_t ops[HostDrawOpTypeCount];
+  // Pixels covered by the ops after clipping, a rough measure of the cost of a frame
+  uint64_t pixels;
+} HostDrawStats;
+
+HostDrawStats host_draw_get_stats(void);
+void host_draw_reset_stats(void);
+
+/*
+ * Starts or stops recording every draw op. Recording starts empty each time it is enabled
+ */
+void host_draw_set_recording(bool recording);
+
+/*
+ * Gets the draw ops recorded so far
+ */
+const HostDrawOp *host_draw_get_ops(size_t *count);
+
+/****** Internal, shared between the shim sources ******/
+
+void host_render(void);
+void host_layer_mark_dirty(void);
+void host_animation_reap(void);
+GContext *host_graphics_begin_frame(void);
+void host_graphics_set_origin(GContext *ctx, GPoint origin, GRect clip);
+void host_graphics_get_origin(GContext *ctx, GPoint *origin, GRect *clip);
+GRect host_grect_intersect(GRect a, GRect b);
+void host_graphics_count_update(void);
+const char *host_button_name(ButtonId button);
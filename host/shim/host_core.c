@@ -0,0 +1,381 @@
+#include <pebble.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <strings.h>
+#include <time.h>
+#include "host.h"
+#include "host_strap.h"
+#include "fake_strap.h"
+
+// The shim's own bookkeeping is not app memory
+#undef malloc
+#undef calloc
+#undef free
+
+#define DEFAULT_RUN_MS 1000
+
+/****** Heap ******/
+
+// Keeps the size in front of every block so frees can be accounted
+typedef union {
+  size_t size;
+  max_align_t align;
+} HeapHeader;
+
+static HostHeapStats s_heap_stats;
+
+void *host_malloc(size_t size) {
+  HeapHeader *header = malloc(sizeof(HeapHeader) + size);
+  if (!header) {
+    return NULL;
+  }
+  header->size = size;
+  s_heap_stats.allocs++;
+  s_heap_stats.live_bytes += size;
+  if (s_heap_stats.live_bytes > s_heap_stats.peak_bytes) {
+    s_heap_stats.peak_bytes = s_heap_stats.live_bytes;
+  }
+  return header + 1;
+}
+
+void *host_calloc(size_t count, size_t size) {
+  void *ptr = host_malloc(count * size);
+  if (ptr) {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+void host_free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  HeapHeader *header = (HeapHeader *)ptr - 1;
+  s_heap_stats.frees++;
+  s_heap_stats.live_bytes -= header->size;
+  free(header);
+}
+
+HostHeapStats host_heap_get_stats(void) {
+  return s_heap_stats;
+}
+
+void host_heap_reset_stats(void) {
+  s_heap_stats.allocs = 0;
+  s_heap_stats.frees = 0;
+  s_heap_stats.peak_bytes = s_heap_stats.live_bytes;
+}
+
+/****** Logging and time ******/
+
+static uint64_t s_now_ms;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+  const char *level = "D";
+  if (log_level <= APP_LOG_LEVEL_ERROR) {
+    level = "E";
+  } else if (log_level <= APP_LOG_LEVEL_WARNING) {
+    level = "W";
+  } else if (log_level <= APP_LOG_LEVEL_INFO) {
+    level = "I";
+  }
+
+  const char *basename = strrchr(src_filename, '/');
+  fprintf(stderr, "[%" PRIu64 "] %s %s:%d ", s_now_ms, level, basename ? basename + 1 : src_filename,
+          src_line_number);
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+uint64_t host_time_ms(void) {
+  return s_now_ms;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+  if (tloc) {
+    *tloc = (time_t)(s_now_ms / 1000);
+  }
+  if (out_ms) {
+    *out_ms = s_now_ms % 1000;
+  }
+  return s_now_ms % 1000;
+}
+
+/****** Math ******/
+
+int32_t sin_lookup(int32_t angle) {
+  return (int32_t)lround(sin(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle) {
+  return (int32_t)lround(cos(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+/****** Events ******/
+
+// Handles are IDs rather than pointers, so a stale handle is detected instead of dereferenced
+struct Event {
+  uintptr_t id;
+  uint64_t due_ms;
+  HostCallback callback;
+  void *data;
+  struct Event *next;
+};
+
+static struct Event *s_events;
+static uintptr_t s_next_event_id = 1;
+
+static void prv_insert_event(struct Event *event) {
+  // Events due at the same time run in the order they were scheduled
+  struct Event **link = &s_events;
+  while (*link && (*link)->due_ms <= event->due_ms) {
+    link = &(*link)->next;
+  }
+  event->next = *link;
+  *link = event;
+}
+
+static struct Event *prv_unlink_event(uintptr_t id) {
+  for (struct Event **link = &s_events; *link; link = &(*link)->next) {
+    if ((*link)->id == id) {
+      struct Event *event = *link;
+      *link = event->next;
+      return event;
+    }
+  }
+  return NULL;
+}
+
+HostEvent *host_event_schedule(uint32_t delay_ms, HostCallback callback, void *data) {
+  struct Event *event = malloc(sizeof(struct Event));
+  *event = (struct Event) {
+    .id = s_next_event_id++,
+    .due_ms = s_now_ms + delay_ms,
+    .callback = callback,
+    .data = data,
+  };
+  prv_insert_event(event);
+  return (HostEvent *)event->id;
+}
+
+bool host_event_reschedule(HostEvent *handle, uint32_t delay_ms) {
+  struct Event *event = prv_unlink_event((uintptr_t)handle);
+  if (!event) {
+    return false;
+  }
+  event->due_ms = s_now_ms + delay_ms;
+  prv_insert_event(event);
+  return true;
+}
+
+bool host_event_cancel(HostEvent *handle) {
+  struct Event *event = prv_unlink_event((uintptr_t)handle);
+  free(event);
+  return event != NULL;
+}
+
+static HostIdle s_idle;
+// Wall clock time at which the virtual clock read 0
+static uint64_t s_wall_base_ms;
+
+static uint64_t prv_wall_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void prv_follow_wall_clock(void) {
+  const uint64_t now_ms = prv_wall_ms() - s_wall_base_ms;
+  if (now_ms > s_now_ms) {
+    s_now_ms = now_ms;
+  }
+}
+
+void host_set_idle(HostIdle idle) {
+  if (idle && !s_idle) {
+    s_wall_base_ms = prv_wall_ms() - s_now_ms;
+  }
+  s_idle = idle;
+}
+
+void host_run_for(uint32_t duration_ms) {
+  const uint64_t end_ms = s_now_ms + duration_ms;
+  for (;;) {
+    if (s_idle) {
+      prv_follow_wall_clock();
+      const uint64_t next_ms = (s_events && s_events->due_ms < end_ms) ? s_events->due_ms : end_ms;
+      if (s_now_ms < next_ms) {
+        s_idle((uint32_t)(next_ms - s_now_ms));
+        continue;
+      }
+    }
+    if (!s_events || s_events->due_ms > end_ms) {
+      break;
+    }
+
+    struct Event *event = s_events;
+    s_events = event->next;
+    if (event->due_ms > s_now_ms) {
+      s_now_ms = event->due_ms;
+    }
+
+    event->callback(event->data);
+    free(event);
+
+    host_animation_reap();
+    host_render();
+  }
+  if (end_ms > s_now_ms) {
+    s_now_ms = end_ms;
+  }
+}
+
+/****** AppTimer ******/
+
+typedef struct {
+  AppTimerCallback callback;
+  void *data;
+} Timer;
+
+static void prv_timer_fired(void *data) {
+  Timer timer = *(Timer *)data;
+  host_free(data);
+  timer.callback(timer.data);
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  // App timers live on the app heap, as they do on the watch
+  Timer *timer = host_malloc(sizeof(Timer));
+  *timer = (Timer) { .callback = callback, .data = callback_data };
+  return (AppTimer *)host_event_schedule(timeout_ms, prv_timer_fired, timer);
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+  return host_event_reschedule((HostEvent *)timer_handle, new_timeout_ms);
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  struct Event *event = prv_unlink_event((uintptr_t)timer_handle);
+  if (event) {
+    host_free(event->data);
+    free(event);
+  }
+}
+
+/****** Main loop and scripts ******/
+
+static HostMainLoop s_main_loop;
+
+void host_set_main_loop(HostMainLoop main_loop) {
+  s_main_loop = main_loop;
+}
+
+void app_event_loop(void) {
+  // Whatever the app did in init() is drawn first
+  host_render();
+
+  if (s_main_loop) {
+    s_main_loop();
+    return;
+  }
+
+  const char *script = getenv("PEBBLE_HOST_SCRIPT");
+  if (script) {
+    host_run_script(script);
+    return;
+  }
+
+  const char *run_ms = getenv("PEBBLE_HOST_RUN_MS");
+  host_run_for(run_ms ? (uint32_t)strtoul(run_ms, NULL, 10) : DEFAULT_RUN_MS);
+}
+
+static bool prv_parse_button(const char *name, ButtonId *button) {
+  for (int i = 0; i < NUM_BUTTONS; i++) {
+    if (strcasecmp(name, host_button_name(i)) == 0) {
+      *button = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void prv_print_stats(void) {
+  const HostHeapStats heap = host_heap_get_stats();
+  const HostDrawStats draw = host_draw_get_stats();
+  const HostStrapStats strap = host_strap_get_stats();
+  printf("{\"time_ms\":%" PRIu64 ",\"heap\":{\"allocs\":%u,\"frees\":%u,\"live_bytes\":%zu,\"peak_bytes\":%zu},"
+         "\"draw\":{\"frames\":%u,\"layer_updates\":%u,\"pixels\":%" PRIu64 ",\"fills\":%u,"
+         "\"texts\":%u,\"bitmaps\":%u},"
+         "\"strap\":{\"reads\":%u,\"writes\":%u,\"notifies\":%u,\"busy\":%u,\"failures\":%u,"
+         "\"timeouts\":%u}}\n",
+         s_now_ms, heap.allocs, heap.frees, heap.live_bytes, heap.peak_bytes,
+         draw.frames, draw.layer_updates, draw.pixels, draw.ops[HostDrawOpFillRect],
+         draw.ops[HostDrawOpDrawText], draw.ops[HostDrawOpDrawBitmap],
+         strap.reads, strap.writes, strap.notifies, strap.busy, strap.failures,
+         strap.timeouts);
+}
+
+static bool prv_run_command(char *line) {
+  char command[16];
+  char name[16];
+  unsigned long a;
+  unsigned long b;
+  ButtonId button;
+
+  if (sscanf(line, "%15s", command) != 1 || command[0] == '#') {
+    return true;
+  }
+  if (strcmp(command, "run") == 0 && sscanf(line, "%*s %lu", &a) == 1) {
+    host_run_for(a);
+  } else if (strcmp(command, "click") == 0 && sscanf(line, "%*s %15s", name) == 1 &&
+             prv_parse_button(name, &button)) {
+    host_click(button);
+  } else if (strcmp(command, "hold") == 0 && sscanf(line, "%*s %15s %lu", name, &a) == 2 &&
+             prv_parse_button(name, &button)) {
+    host_hold(button, a);
+  } else if (strcmp(command, "input") == 0 && sscanf(line, "%*s %lu %lu", &a, &b) == 2 &&
+             a < FAKE_STRAP_NUM_CHANNELS) {
+    fake_strap_set_input(a, b);
+  } else if (strcmp(command, "outputs") == 0) {
+    printf("outputs %u %u %u\n", fake_strap_get_output(0), fake_strap_get_output(1),
+           fake_strap_get_output(2));
+  } else if (strcmp(command, "stats") == 0) {
+    prv_print_stats();
+  } else {
+    return false;
+  }
+  fflush(stdout);
+  return true;
+}
+
+bool host_run_script(const char *path) {
+  FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "cannot open script %s\n", path);
+    return false;
+  }
+
+  bool ok = true;
+  char line[128];
+  int line_number = 0;
+  while (fgets(line, sizeof(line), file)) {
+    line_number++;
+    if (strncmp(line, "quit", 4) == 0) {
+      break;
+    }
+    if (!prv_run_command(line)) {
+      fprintf(stderr, "%s:%d: cannot run %s", path, line_number, line);
+      ok = false;
+      break;
+    }
+  }
+
+  if (file != stdin) {
+    fclose(file);
+  }
+  return ok;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <pebble.h>
+
+// Link between the shim's smartstrap API and whatever plays the strap. A transport takes requests
+// and reports their results, and any notify, through the host_strap_* functions below, on the
+// event loop.
+
+typedef struct HostStrapTransport {
+  // Called once smartstrap_subscribe() succeeds, and on unsubscribe
+  void (*connect)(void);
+  void (*disconnect)(void);
+  bool (*is_available)(SmartstrapServiceId service_id);
+  // Starts a read, answered by host_strap_did_read()
+  SmartstrapResult (*read)(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id);
+  // Starts a write, answered by host_strap_did_write() and, with request_read, host_strap_did_read()
+  SmartstrapResult (*write)(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id,
+                            const uint8_t *data, size_t length, bool request_read);
+} HostStrapTransport;
+
+typedef struct HostStrapStats {
+  // Requests refused because another transaction was on the bus
+  uint32_t busy;
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t notifies;
+  // Reads and writes that completed with a result other than SmartstrapResultOk
+  uint32_t failures;
+  // Of those, the ones the transport never answered
+  uint32_t timeouts;
+} HostStrapStats;
+
+/*
+ * Sets the transport, NULL restores the default: the pty transport when PEBBLE_HOST_STRAP names a
+ * pty, the fake strap otherwise. Takes effect on the next smartstrap_subscribe()
+ */
+void host_strap_set_transport(const HostStrapTransport *transport);
+
+HostStrapStats host_strap_get_stats(void);
+void host_strap_reset_stats(void);
+
+void host_strap_did_read(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id,
+                         SmartstrapResult result, const uint8_t *data, size_t length);
+void host_strap_did_write(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id,
+                          SmartstrapResult result);
+void host_strap_notified(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id);
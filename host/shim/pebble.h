@@ -0,0 +1,519 @@
+#pragma once
+
+// Minimal stand-in for the Pebble SDK's pebble.h so the watchapp sources can be
+// compiled and exercised on a Linux host. Only the API surface used by
+// pebble/src is provided. Behaviour follows SDK 3.x (basalt) semantics closely
+// enough for profiling and regression runs; it is not an emulator.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PBL_SDK_3
+#define PBL_COLOR
+#define PBL_RECT
+#define PBL_PLATFORM_BASALT
+
+#define ARRAY_LENGTH(array) (sizeof((array)) / sizeof((array)[0]))
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Heap accounting
+
+// Every allocation made by the watchapp sources and by the shim itself goes
+// through these so that allocation counts can be measured per operation.
+void *host_malloc(size_t size);
+void *host_calloc(size_t count, size_t size);
+void host_free(void *ptr);
+
+#define malloc(size) host_malloc(size)
+#define calloc(count, size) host_calloc(count, size)
+#define free(ptr) host_free(ptr)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Logging
+
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200,
+  APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+#define APP_LOG(level, fmt, args...) app_log(level, __FILE__, __LINE__, fmt, ## args)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Time
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Geometry and colour
+
+typedef struct GPoint {
+  int16_t x;
+  int16_t y;
+} GPoint;
+
+typedef struct GSize {
+  int16_t w;
+  int16_t h;
+} GSize;
+
+typedef struct GRect {
+  GPoint origin;
+  GSize size;
+} GRect;
+
+#define GPoint(x, y) ((GPoint){(x), (y)})
+#define GSize(w, h) ((GSize){(w), (h)})
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+#define GPointZero GPoint(0, 0)
+#define GRectZero GRect(0, 0, 0, 0)
+
+bool grect_equal(const GRect *const rect_a, const GRect *const rect_b);
+bool gsize_equal(const GSize *size_a, const GSize *size_b);
+
+typedef union GColor8 {
+  uint8_t argb;
+  struct {
+    uint8_t b:2;
+    uint8_t g:2;
+    uint8_t r:2;
+    uint8_t a:2;
+  };
+} GColor8;
+
+typedef GColor8 GColor;
+
+#define GColorFromARGB8(value) ((GColor8){.argb = (value)})
+#define GColorClear GColorFromARGB8(0x00)
+#define GColorBlack GColorFromARGB8(0xC0)
+#define GColorWhite GColorFromARGB8(0xFF)
+#define GColorDarkGray GColorFromARGB8(0xD5)
+#define GColorLightGray GColorFromARGB8(0xEA)
+#define GColorRed GColorFromARGB8(0xF0)
+#define GColorGreen GColorFromARGB8(0xCC)
+#define GColorBlue GColorFromARGB8(0xC3)
+#define GColorJaegerGreen GColorFromARGB8(0xD9)
+#define GColorYellow GColorFromARGB8(0xFC)
+#define GColorCobaltBlue GColorFromARGB8(0xC6)
+
+#define COLOR_FALLBACK(color, bw) (color)
+#define PBL_IF_COLOR_ELSE(if_true, if_false) (if_true)
+
+bool gcolor_equal(GColor8 x, GColor8 y);
+
+typedef enum {
+  GCornerNone = 0,
+  GCornerTopLeft = 1 << 0,
+  GCornerTopRight = 1 << 1,
+  GCornerBottomLeft = 1 << 2,
+  GCornerBottomRight = 1 << 3,
+  GCornersAll = 0xF,
+} GCornerMask;
+
+typedef enum {
+  GCompOpAssign,
+  GCompOpAssignInverted,
+  GCompOpOr,
+  GCompOpAnd,
+  GCompOpClear,
+  GCompOpSet,
+} GCompOp;
+
+typedef enum {
+  GTextOverflowModeWordWrap,
+  GTextOverflowModeTrailingEllipsis,
+  GTextOverflowModeFill,
+} GTextOverflowMode;
+
+typedef enum {
+  GTextAlignmentLeft,
+  GTextAlignmentCenter,
+  GTextAlignmentRight,
+} GTextAlignment;
+
+typedef struct GTextAttributes GTextAttributes;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Fonts
+
+typedef struct HostFont *GFont;
+
+#define FONT_KEY_GOTHIC_14 "RESOURCE_ID_GOTHIC_14"
+#define FONT_KEY_GOTHIC_14_BOLD "RESOURCE_ID_GOTHIC_14_BOLD"
+#define FONT_KEY_GOTHIC_18 "RESOURCE_ID_GOTHIC_18"
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24 "RESOURCE_ID_GOTHIC_24"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+#define FONT_KEY_GOTHIC_28 "RESOURCE_ID_GOTHIC_28"
+#define FONT_KEY_GOTHIC_28_BOLD "RESOURCE_ID_GOTHIC_28_BOLD"
+
+GFont fonts_get_system_font(const char *font_key);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Bitmaps
+
+typedef struct GBitmap GBitmap;
+
+typedef enum {
+  GBitmapFormat1Bit = 0,
+  GBitmapFormat8Bit,
+} GBitmapFormat;
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format);
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+void gbitmap_destroy(GBitmap *bitmap);
+GRect gbitmap_get_bounds(const GBitmap *bitmap);
+uint8_t *gbitmap_get_data(const GBitmap *bitmap);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap);
+
+typedef struct {
+  uint8_t *data;
+  int16_t min_x;
+  int16_t max_x;
+} GBitmapDataRowInfo;
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Graphics
+
+typedef struct GContext GContext;
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+void graphics_draw_rect(GContext *ctx, GRect rect);
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes *text_attributes);
+GSize graphics_text_layout_get_content_size(const char *text, GFont const font, const GRect box,
+                                            const GTextOverflowMode overflow_mode,
+                                            const GTextAlignment alignment);
+GBitmap *graphics_capture_frame_buffer(GContext *ctx);
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Layers
+
+typedef struct Layer Layer;
+typedef void (*LayerUpdateProc)(struct Layer *layer, GContext *ctx);
+
+Layer *layer_create(GRect frame);
+Layer *layer_create_with_data(GRect frame, size_t data_size);
+void layer_destroy(Layer *layer);
+void *layer_get_data(const Layer *layer);
+void layer_mark_dirty(Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_set_frame(Layer *layer, GRect frame);
+GRect layer_get_frame(const Layer *layer);
+void layer_set_bounds(Layer *layer, GRect bounds);
+GRect layer_get_bounds(const Layer *layer);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_remove_from_parent(Layer *child);
+void layer_set_clips(Layer *layer, bool clips);
+void layer_set_hidden(Layer *layer, bool hidden);
+GPoint layer_convert_point_to_screen(const Layer *layer, GPoint point);
+
+typedef struct TextLayer TextLayer;
+
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment);
+void text_layer_set_text_color(TextLayer *text_layer, GColor color);
+void text_layer_set_background_color(TextLayer *text_layer, GColor color);
+
+typedef struct StatusBarLayer StatusBarLayer;
+
+typedef enum {
+  StatusBarLayerSeparatorModeNone = 0,
+  StatusBarLayerSeparatorModeDotted = 1,
+} StatusBarLayerSeparatorMode;
+
+#define STATUS_BAR_LAYER_HEIGHT 16
+
+StatusBarLayer *status_bar_layer_create(void);
+void status_bar_layer_destroy(StatusBarLayer *status_bar_layer);
+Layer *status_bar_layer_get_layer(StatusBarLayer *status_bar_layer);
+void status_bar_layer_set_colors(StatusBarLayer *status_bar_layer, GColor background, GColor foreground);
+void status_bar_layer_set_separator_mode(StatusBarLayer *status_bar_layer, StatusBarLayerSeparatorMode mode);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Windows and clicks
+
+typedef struct Window Window;
+
+typedef enum {
+  BUTTON_ID_BACK = 0,
+  BUTTON_ID_UP,
+  BUTTON_ID_SELECT,
+  BUTTON_ID_DOWN,
+  NUM_BUTTONS
+} ButtonId;
+
+typedef struct HostClickRecognizer *ClickRecognizerRef;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void *context);
+typedef void (*ClickConfigProvider)(void *context);
+
+bool click_recognizer_is_repeating(ClickRecognizerRef recognizer);
+uint8_t click_number_of_clicks_counted(ClickRecognizerRef recognizer);
+
+typedef void (*WindowHandler)(struct Window *window);
+
+typedef struct WindowHandlers {
+  WindowHandler load;
+  WindowHandler appear;
+  WindowHandler disappear;
+  WindowHandler unload;
+} WindowHandlers;
+
+Window *window_create(void);
+void window_destroy(Window *window);
+Layer *window_get_root_layer(const Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_background_color(Window *window, GColor background_color);
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider);
+void window_set_click_config_provider_with_context(Window *window, ClickConfigProvider click_config_provider,
+                                                   void *context);
+void window_set_click_context(ButtonId button_id, void *context);
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+void window_single_repeating_click_subscribe(ButtonId button_id, uint16_t repeat_interval_ms,
+                                             ClickHandler handler);
+
+void window_stack_push(Window *window, bool animated);
+Window *window_stack_pop(bool animated);
+bool window_stack_remove(Window *window, bool animated);
+Window *window_stack_get_top_window(void);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! MenuLayer
+
+typedef struct MenuLayer MenuLayer;
+
+typedef struct MenuIndex {
+  uint16_t section;
+  uint16_t row;
+} MenuIndex;
+
+#define MENU_CELL_BASIC_HEADER_HEIGHT ((const int16_t) 16)
+
+typedef uint16_t (*MenuLayerGetNumberOfSectionsCallback)(struct MenuLayer *menu_layer, void *callback_context);
+typedef uint16_t (*MenuLayerGetNumberOfRowsInSectionsCallback)(struct MenuLayer *menu_layer,
+                                                              uint16_t section_index, void *callback_context);
+typedef int16_t (*MenuLayerGetCellHeightCallback)(struct MenuLayer *menu_layer, MenuIndex *cell_index,
+                                                  void *callback_context);
+typedef int16_t (*MenuLayerGetHeaderHeightCallback)(struct MenuLayer *menu_layer, uint16_t section_index,
+                                                    void *callback_context);
+typedef void (*MenuLayerDrawRowCallback)(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index,
+                                         void *callback_context);
+typedef void (*MenuLayerDrawHeaderCallback)(GContext *ctx, const Layer *cell_layer, uint16_t section_index,
+                                            void *callback_context);
+typedef void (*MenuLayerSelectCallback)(struct MenuLayer *menu_layer, MenuIndex *cell_index,
+                                        void *callback_context);
+
+typedef struct MenuLayerCallbacks {
+  MenuLayerGetNumberOfSectionsCallback get_num_sections;
+  MenuLayerGetNumberOfRowsInSectionsCallback get_num_rows;
+  MenuLayerGetCellHeightCallback get_cell_height;
+  MenuLayerGetHeaderHeightCallback get_header_height;
+  MenuLayerDrawRowCallback draw_row;
+  MenuLayerDrawHeaderCallback draw_header;
+  MenuLayerSelectCallback select_click;
+  MenuLayerSelectCallback select_long_click;
+} MenuLayerCallbacks;
+
+MenuLayer *menu_layer_create(GRect frame);
+void menu_layer_destroy(MenuLayer *menu_layer);
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer);
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks);
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, struct Window *window);
+void menu_layer_reload_data(MenuLayer *menu_layer);
+bool menu_cell_layer_is_highlighted(const Layer *cell_layer);
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title, const char *subtitle,
+                          GBitmap *icon);
+void menu_cell_basic_header_draw(GContext *ctx, const Layer *cell_layer, const char *title);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Animation
+
+typedef struct Animation Animation;
+typedef int32_t AnimationProgress;
+
+#define ANIMATION_NORMALIZED_MIN 0
+#define ANIMATION_NORMALIZED_MAX 65535
+#define ANIMATION_DURATION_INFINITE ((uint32_t) ~0)
+
+typedef enum {
+  AnimationCurveLinear = 0,
+  AnimationCurveEaseIn = 1,
+  AnimationCurveEaseOut = 2,
+  AnimationCurveEaseInOut = 3,
+  AnimationCurveDefault = AnimationCurveEaseInOut,
+} AnimationCurve;
+
+typedef void (*AnimationSetupImplementation)(Animation *animation);
+typedef void (*AnimationUpdateImplementation)(Animation *animation, const AnimationProgress progress);
+typedef void (*AnimationTeardownImplementation)(Animation *animation);
+
+typedef struct AnimationImplementation {
+  AnimationSetupImplementation setup;
+  AnimationUpdateImplementation update;
+  AnimationTeardownImplementation teardown;
+} AnimationImplementation;
+
+typedef void (*AnimationStartedHandler)(Animation *animation, void *context);
+typedef void (*AnimationStoppedHandler)(Animation *animation, bool finished, void *context);
+
+typedef struct AnimationHandlers {
+  AnimationStartedHandler started;
+  AnimationStoppedHandler stopped;
+} AnimationHandlers;
+
+Animation *animation_create(void);
+bool animation_destroy(Animation *animation);
+bool animation_set_duration(Animation *animation, uint32_t duration_ms);
+bool animation_set_delay(Animation *animation, uint32_t delay_ms);
+bool animation_set_curve(Animation *animation, AnimationCurve curve);
+bool animation_set_handlers(Animation *animation, AnimationHandlers callbacks, void *context);
+void *animation_get_context(Animation *animation);
+bool animation_set_implementation(Animation *animation, const AnimationImplementation *implementation);
+bool animation_schedule(Animation *animation);
+bool animation_unschedule(Animation *animation);
+void animation_unschedule_all(void);
+bool animation_is_scheduled(Animation *animation);
+Animation *animation_sequence_create(Animation *animation_a, Animation *animation_b, Animation *animation_c, ...);
+Animation *animation_spawn_create(Animation *animation_a, Animation *animation_b, Animation *animation_c, ...);
+
+typedef struct PropertyAnimation PropertyAnimation;
+
+PropertyAnimation *property_animation_create_layer_frame(struct Layer *layer, GRect *from_frame, GRect *to_frame);
+Animation *property_animation_get_animation(PropertyAnimation *property_animation);
+void property_animation_destroy(PropertyAnimation *property_animation);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! AppTimer
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Math
+
+#define TRIG_MAX_RATIO 0xffff
+#define TRIG_MAX_ANGLE 0x10000
+
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Storage
+
+#define PERSIST_DATA_MAX_LENGTH 256
+#define PERSIST_STRING_MAX_LENGTH PERSIST_DATA_MAX_LENGTH
+
+typedef int32_t status_t;
+
+typedef enum {
+  S_SUCCESS = 0,
+  E_ERROR = -1,
+  E_UNKNOWN = -2,
+  E_INTERNAL = -3,
+  E_INVALID_ARGUMENT = -4,
+  E_OUT_OF_MEMORY = -5,
+  E_OUT_OF_STORAGE = -6,
+  E_OUT_OF_RESOURCES = -7,
+  E_RANGE = -8,
+  E_DOES_NOT_EXIST = -9,
+  E_INVALID_OPERATION = -10,
+  E_BUSY = -11,
+  S_TRUE = 1,
+  S_FALSE = 0,
+  S_NO_MORE_ITEMS = 2,
+  S_NO_ACTION_REQUIRED = 3,
+} StatusCode;
+
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+bool persist_read_bool(const uint32_t key);
+int32_t persist_read_int(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int persist_read_string(const uint32_t key, char *buffer, const size_t buffer_size);
+status_t persist_write_bool(const uint32_t key, const bool value);
+status_t persist_write_int(const uint32_t key, const int32_t value);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+int persist_write_string(const uint32_t key, const char *cstring);
+status_t persist_delete(const uint32_t key);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Smartstrap
+
+typedef enum {
+  SmartstrapResultOk = 0,
+  SmartstrapResultInvalidArgs,
+  SmartstrapResultNotPresent,
+  SmartstrapResultBusy,
+  SmartstrapResultServiceUnavailable,
+  SmartstrapResultAttributeUnsupported,
+  SmartstrapResultTimeOut,
+} SmartstrapResult;
+
+typedef uint16_t SmartstrapServiceId;
+typedef uint16_t SmartstrapAttributeId;
+typedef struct SmartstrapAttribute SmartstrapAttribute;
+
+typedef void (*SmartstrapServiceAvailabilityHandler)(SmartstrapServiceId service_id, bool is_available);
+typedef void (*SmartstrapReadHandler)(SmartstrapAttribute *attribute, SmartstrapResult result,
+                                      const uint8_t *data, size_t length);
+typedef void (*SmartstrapWriteHandler)(SmartstrapAttribute *attribute, SmartstrapResult result);
+typedef void (*SmartstrapNotifyHandler)(SmartstrapAttribute *attribute);
+
+typedef struct {
+  SmartstrapServiceAvailabilityHandler availability_did_change;
+  SmartstrapReadHandler did_read;
+  SmartstrapWriteHandler did_write;
+  SmartstrapNotifyHandler notified;
+} SmartstrapHandlers;
+
+#define SMARTSTRAP_TIMEOUT_DEFAULT 250
+
+SmartstrapResult smartstrap_subscribe(SmartstrapHandlers handlers);
+void smartstrap_unsubscribe(void);
+void smartstrap_set_timeout(uint16_t timeout_ms);
+bool smartstrap_service_is_available(SmartstrapServiceId service_id);
+SmartstrapAttribute *smartstrap_attribute_create(SmartstrapServiceId service_id,
+                                                 SmartstrapAttributeId attribute_id, size_t buffer_length);
+void smartstrap_attribute_destroy(SmartstrapAttribute *attribute);
+SmartstrapServiceId smartstrap_attribute_get_service_id(SmartstrapAttribute *attribute);
+SmartstrapAttributeId smartstrap_attribute_get_attribute_id(SmartstrapAttribute *attribute);
+SmartstrapResult smartstrap_attribute_read(SmartstrapAttribute *attribute);
+SmartstrapResult smartstrap_attribute_begin_write(SmartstrapAttribute *attribute, uint8_t **buffer,
+                                                  size_t *buffer_length);
+SmartstrapResult smartstrap_attribute_end_write(SmartstrapAttribute *attribute, size_t write_length,
+                                                bool request_read);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! App
+
+void app_event_loop(void);
@@ -0,0 +1,155 @@
+#include <pebble.h>
+#include "host.h"
+
+// Persistent storage kept in memory. With PEBBLE_HOST_PERSIST set it is loaded from that file on
+// first use and saved back on every change, so a run can pick up where the last one left off. The
+// file holds, for each key: key and size as native uint32_t, then the data.
+
+// The store is not app memory
+#undef malloc
+#undef free
+
+typedef struct Entry {
+  uint32_t key;
+  size_t size;
+  struct Entry *next;
+  uint8_t data[];
+} Entry;
+
+static Entry *s_entries;
+static bool s_loaded;
+
+static Entry **prv_find(uint32_t key) {
+  Entry **link = &s_entries;
+  while (*link && (*link)->key != key) {
+    link = &(*link)->next;
+  }
+  return link;
+}
+
+static void prv_put(uint32_t key, const void *data, size_t size) {
+  Entry **link = prv_find(key);
+  Entry *entry = malloc(sizeof(Entry) + size);
+  *entry = (Entry) { .key = key, .size = size, .next = *link ? (*link)->next : NULL };
+  memcpy(entry->data, data, size);
+  free(*link);
+  *link = entry;
+}
+
+static void prv_load(void) {
+  if (s_loaded) {
+    return;
+  }
+  s_loaded = true;
+  const char *path = getenv("PEBBLE_HOST_PERSIST");
+  FILE *file = path ? fopen(path, "rb") : NULL;
+  if (!file) {
+    return;
+  }
+  uint32_t header[2];
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+  while (fread(header, sizeof(header), 1, file) == 1 && header[1] <= sizeof(data) &&
+         fread(data, 1, header[1], file) == header[1]) {
+    prv_put(header[0], data, header[1]);
+  }
+  fclose(file);
+}
+
+static void prv_save(void) {
+  const char *path = getenv("PEBBLE_HOST_PERSIST");
+  FILE *file = path ? fopen(path, "wb") : NULL;
+  if (!file) {
+    return;
+  }
+  for (Entry *entry = s_entries; entry; entry = entry->next) {
+    const uint32_t header[2] = { entry->key, (uint32_t)entry->size };
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(entry->data, 1, entry->size, file);
+  }
+  fclose(file);
+}
+
+static Entry *prv_get(uint32_t key) {
+  prv_load();
+  return *prv_find(key);
+}
+
+bool persist_exists(const uint32_t key) {
+  return prv_get(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key) {
+  Entry *entry = prv_get(key);
+  return entry ? (int)entry->size : E_DOES_NOT_EXIST;
+}
+
+bool persist_read_bool(const uint32_t key) {
+  return persist_read_int(key) != 0;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+  int32_t value = 0;
+  Entry *entry = prv_get(key);
+  if (entry) {
+    memcpy(&value, entry->data, entry->size < sizeof(value) ? entry->size : sizeof(value));
+  }
+  return value;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  Entry *entry = prv_get(key);
+  if (!entry) {
+    return E_DOES_NOT_EXIST;
+  }
+  const size_t size = entry->size < buffer_size ? entry->size : buffer_size;
+  memcpy(buffer, entry->data, size);
+  return (int)size;
+}
+
+int persist_read_string(const uint32_t key, char *buffer, const size_t buffer_size) {
+  if (!buffer_size) {
+    return E_INVALID_ARGUMENT;
+  }
+  const int size = persist_read_data(key, buffer, buffer_size);
+  if (size >= 0) {
+    buffer[(size_t)size < buffer_size ? (size_t)size : buffer_size - 1] = '\0';
+  }
+  return size;
+}
+
+status_t persist_write_bool(const uint32_t key, const bool value) {
+  return persist_write_int(key, value);
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  if (!data) {
+    return E_INVALID_ARGUMENT;
+  }
+  // The watch writes at most PERSIST_DATA_MAX_LENGTH bytes per key
+  const size_t written = size < PERSIST_DATA_MAX_LENGTH ? size : PERSIST_DATA_MAX_LENGTH;
+  prv_load();
+  prv_put(key, data, written);
+  prv_save();
+  return (int)written;
+}
+
+int persist_write_string(const uint32_t key, const char *cstring) {
+  return persist_write_data(key, cstring, strlen(cstring) + 1);
+}
+
+status_t persist_delete(const uint32_t key) {
+  prv_load();
+  Entry **link = prv_find(key);
+  Entry *entry = *link;
+  if (!entry) {
+    return E_DOES_NOT_EXIST;
+  }
+  *link = entry->next;
+  free(entry);
+  prv_save();
+  return S_TRUE;
+}
@@ -0,0 +1,147 @@
+#include <pebble.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "host.h"
+#include "host_strap.h"
+#include "pty_strap.h"
+#include "strap_wire.h"
+
+// Received frames are harness memory, not app memory
+#undef malloc
+#undef free
+
+static const char *s_path;
+static int s_fd = -1;
+static StrapWireDecoder s_decoder;
+// Sequence of the request in flight; responses to requests that timed out are ignored
+static uint8_t s_sequence;
+
+static void prv_deliver(void *data) {
+  StrapWireFrame *frame = data;
+  switch (frame->type) {
+    case StrapWireTypeReadResponse:
+      host_strap_did_read(frame->service_id, frame->attribute_id, (SmartstrapResult)frame->result,
+                          frame->payload, frame->length);
+      break;
+    case StrapWireTypeWriteResponse:
+      host_strap_did_write(frame->service_id, frame->attribute_id, (SmartstrapResult)frame->result);
+      break;
+    case StrapWireTypeNotify:
+      host_strap_notified(frame->service_id, frame->attribute_id);
+      break;
+  }
+  free(frame);
+}
+
+static void prv_receive(void) {
+  uint8_t bytes[256];
+  ssize_t count;
+  while ((count = read(s_fd, bytes, sizeof(bytes))) > 0) {
+    for (ssize_t i = 0; i < count; i++) {
+      StrapWireFrame frame;
+      if (!strap_wire_decode(&s_decoder, bytes[i], &frame)) {
+        continue;
+      }
+      if (frame.type != StrapWireTypeNotify && frame.sequence != s_sequence) {
+        continue;
+      }
+      // Delivered from the event loop, like every other callback
+      StrapWireFrame *copy = malloc(sizeof(StrapWireFrame));
+      *copy = frame;
+      host_event_schedule(0, prv_deliver, copy);
+    }
+  }
+}
+
+static void prv_idle(uint32_t timeout_ms) {
+  struct pollfd pfd = { .fd = s_fd, .events = POLLIN };
+  if (poll(&pfd, 1, (int)timeout_ms) > 0 && (pfd.revents & POLLIN)) {
+    prv_receive();
+  }
+}
+
+static bool prv_send(StrapWireType type, SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id,
+                     const uint8_t *data, size_t length) {
+  if (s_fd < 0 || length > STRAP_WIRE_MAX_PAYLOAD) {
+    return false;
+  }
+  StrapWireFrame frame = {
+    .type = type,
+    .sequence = ++s_sequence,
+    .service_id = service_id,
+    .attribute_id = attribute_id,
+    .length = length,
+  };
+  if (length) {
+    memcpy(frame.payload, data, length);
+  }
+
+  uint8_t encoded[STRAP_WIRE_MAX_ENCODED];
+  const size_t encoded_length = strap_wire_encode(&frame, encoded);
+  size_t sent = 0;
+  while (sent < encoded_length) {
+    const ssize_t count = write(s_fd, encoded + sent, encoded_length - sent);
+    if (count < 0 && errno != EAGAIN && errno != EINTR) {
+      return false;
+    }
+    if (count > 0) {
+      sent += count;
+    }
+  }
+  return true;
+}
+
+static void prv_connect(void) {
+  s_fd = open(s_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (s_fd < 0) {
+    fprintf(stderr, "cannot open strap pty %s: %s\n", s_path, strerror(errno));
+    return;
+  }
+  struct termios termios;
+  if (tcgetattr(s_fd, &termios) == 0) {
+    cfmakeraw(&termios);
+    tcsetattr(s_fd, TCSANOW, &termios);
+  }
+  s_decoder = (StrapWireDecoder) { 0 };
+  host_set_idle(prv_idle);
+}
+
+static void prv_disconnect(void) {
+  host_set_idle(NULL);
+  if (s_fd >= 0) {
+    close(s_fd);
+    s_fd = -1;
+  }
+}
+
+static bool prv_is_available(SmartstrapServiceId service_id) {
+  return s_fd >= 0;
+}
+
+static SmartstrapResult prv_read(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id) {
+  return prv_send(StrapWireTypeRead, service_id, attribute_id, NULL, 0) ? SmartstrapResultOk
+                                                                        : SmartstrapResultNotPresent;
+}
+
+static SmartstrapResult prv_write(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id,
+                                  const uint8_t *data, size_t length, bool request_read) {
+  const StrapWireType type = request_read ? StrapWireTypeWriteRead : StrapWireTypeWrite;
+  return prv_send(type, service_id, attribute_id, data, length) ? SmartstrapResultOk
+                                                                : SmartstrapResultNotPresent;
+}
+
+static const HostStrapTransport s_transport = {
+  .connect = prv_connect,
+  .disconnect = prv_disconnect,
+  .is_available = prv_is_available,
+  .read = prv_read,
+  .write = prv_write,
+};
+
+const HostStrapTransport *pty_strap_get_transport(const char *path) {
+  s_path = path;
+  return &s_transport;
+}
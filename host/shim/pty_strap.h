@@ -0,0 +1,12 @@
+#pragma once
+
+#include <pebble.h>
+
+// Transport that sends the shim's smartstrap requests over a pty to the strap simulator in
+// host/sim, framed as described in strap_wire.h. The clock follows the wall clock while it is
+// connected.
+
+/*
+ * Gets the transport for the pty at path. The pty is opened on smartstrap_subscribe()
+ */
+const struct HostStrapTransport *pty_strap_get_transport(const char *path);
@@ -0,0 +1,302 @@
+#include <pebble.h>
+#include "host.h"
+#include "host_strap.h"
+#include "fake_strap.h"
+#include "pty_strap.h"
+
+// The bus carries one transaction at a time, as on the watch: a read or write started while
+// another is in flight is refused with SmartstrapResultBusy. A transaction the transport does not
+// answer within the timeout completes with SmartstrapResultTimeOut.
+
+struct SmartstrapAttribute {
+  SmartstrapServiceId service_id;
+  SmartstrapAttributeId attribute_id;
+  size_t buffer_length;
+  bool writing;
+  struct SmartstrapAttribute *next;
+  uint8_t buffer[];
+};
+
+static const HostStrapTransport *s_transport;
+static bool s_subscribed;
+static SmartstrapHandlers s_handlers;
+static SmartstrapAttribute *s_attributes;
+static SmartstrapAttribute *s_in_flight;
+static bool s_in_flight_write;
+static HostEvent *s_timeout_event;
+static uint16_t s_timeout_ms = SMARTSTRAP_TIMEOUT_DEFAULT;
+// The write in flight asked for a read of the attribute once acknowledged
+static bool s_read_follows_write;
+static HostStrapStats s_stats;
+
+static const HostStrapTransport *prv_transport(void) {
+  if (!s_transport) {
+    const char *pty = getenv("PEBBLE_HOST_STRAP");
+    s_transport = pty ? pty_strap_get_transport(pty) : fake_strap_get_transport();
+  }
+  return s_transport;
+}
+
+static SmartstrapAttribute *prv_find(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id) {
+  for (SmartstrapAttribute *attribute = s_attributes; attribute; attribute = attribute->next) {
+    if (attribute->service_id == service_id && attribute->attribute_id == attribute_id) {
+      return attribute;
+    }
+  }
+  return NULL;
+}
+
+void host_strap_set_transport(const HostStrapTransport *transport) {
+  s_transport = transport;
+}
+
+HostStrapStats host_strap_get_stats(void) {
+  return s_stats;
+}
+
+void host_strap_reset_stats(void) {
+  s_stats = (HostStrapStats) { 0 };
+}
+
+/****** Transactions ******/
+
+static void prv_timed_out(void *data) {
+  SmartstrapAttribute *attribute = s_in_flight;
+  s_timeout_event = NULL;
+  s_in_flight = NULL;
+  s_read_follows_write = false;
+  if (!attribute) {
+    return;
+  }
+
+  s_stats.failures++;
+  s_stats.timeouts++;
+  if (!s_subscribed) {
+    return;
+  }
+  if (s_in_flight_write && s_handlers.did_write) {
+    s_handlers.did_write(attribute, SmartstrapResultTimeOut);
+  } else if (!s_in_flight_write && s_handlers.did_read) {
+    s_handlers.did_read(attribute, SmartstrapResultTimeOut, attribute->buffer, 0);
+  }
+}
+
+static void prv_begin_transaction(SmartstrapAttribute *attribute, bool write) {
+  s_in_flight = attribute;
+  s_in_flight_write = write;
+  host_event_cancel(s_timeout_event);
+  s_timeout_event = host_event_schedule(s_timeout_ms, prv_timed_out, NULL);
+}
+
+static void prv_end_transaction(void) {
+  s_in_flight = NULL;
+  host_event_cancel(s_timeout_event);
+  s_timeout_event = NULL;
+}
+
+/****** Transport callbacks ******/
+
+void host_strap_did_read(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id,
+                         SmartstrapResult result, const uint8_t *data, size_t length) {
+  SmartstrapAttribute *attribute = prv_find(service_id, attribute_id);
+  if (!attribute || attribute != s_in_flight) {
+    return;
+  }
+  prv_end_transaction();
+
+  if (result != SmartstrapResultOk) {
+    s_stats.failures++;
+    length = 0;
+  } else if (length > attribute->buffer_length) {
+    length = attribute->buffer_length;
+  }
+  if (length) {
+    memcpy(attribute->buffer, data, length);
+  }
+  if (s_subscribed && s_handlers.did_read) {
+    s_handlers.did_read(attribute, result, attribute->buffer, length);
+  }
+}
+
+void host_strap_did_write(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id,
+                          SmartstrapResult result) {
+  SmartstrapAttribute *attribute = prv_find(service_id, attribute_id);
+  if (!attribute || attribute != s_in_flight) {
+    return;
+  }
+  if (!s_read_follows_write || result != SmartstrapResultOk) {
+    prv_end_transaction();
+  } else {
+    // The read that follows gets a timeout of its own
+    prv_begin_transaction(attribute, false);
+  }
+  s_read_follows_write = false;
+
+  if (result != SmartstrapResultOk) {
+    s_stats.failures++;
+  }
+  if (s_subscribed && s_handlers.did_write) {
+    s_handlers.did_write(attribute, result);
+  }
+}
+
+void host_strap_notified(SmartstrapServiceId service_id, SmartstrapAttributeId attribute_id) {
+  SmartstrapAttribute *attribute = prv_find(service_id, attribute_id);
+  if (!attribute) {
+    return;
+  }
+  s_stats.notifies++;
+  if (s_subscribed && s_handlers.notified) {
+    s_handlers.notified(attribute);
+  }
+}
+
+/****** API ******/
+
+SmartstrapResult smartstrap_subscribe(SmartstrapHandlers handlers) {
+  s_handlers = handlers;
+  if (!s_subscribed) {
+    s_subscribed = true;
+    const HostStrapTransport *transport = prv_transport();
+    if (transport->connect) {
+      transport->connect();
+    }
+  }
+  return SmartstrapResultOk;
+}
+
+void smartstrap_unsubscribe(void) {
+  if (!s_subscribed) {
+    return;
+  }
+  s_subscribed = false;
+  prv_end_transaction();
+  const HostStrapTransport *transport = prv_transport();
+  if (transport->disconnect) {
+    transport->disconnect();
+  }
+}
+
+void smartstrap_set_timeout(uint16_t timeout_ms) {
+  s_timeout_ms = timeout_ms;
+}
+
+bool smartstrap_service_is_available(SmartstrapServiceId service_id) {
+  const HostStrapTransport *transport = prv_transport();
+  return s_subscribed && (!transport->is_available || transport->is_available(service_id));
+}
+
+SmartstrapAttribute *smartstrap_attribute_create(SmartstrapServiceId service_id,
+                                                 SmartstrapAttributeId attribute_id, size_t buffer_length) {
+  if (!buffer_length || prv_find(service_id, attribute_id)) {
+    return NULL;
+  }
+  // The buffer is allocated by the app, as on the watch
+  SmartstrapAttribute *attribute = malloc(sizeof(SmartstrapAttribute) + buffer_length);
+  if (!attribute) {
+    return NULL;
+  }
+  *attribute = (SmartstrapAttribute) {
+    .service_id = service_id,
+    .attribute_id = attribute_id,
+    .buffer_length = buffer_length,
+    .next = s_attributes,
+  };
+  s_attributes = attribute;
+  return attribute;
+}
+
+void smartstrap_attribute_destroy(SmartstrapAttribute *attribute) {
+  if (!attribute) {
+    return;
+  }
+  for (SmartstrapAttribute **link = &s_attributes; *link; link = &(*link)->next) {
+    if (*link == attribute) {
+      *link = attribute->next;
+      break;
+    }
+  }
+  if (s_in_flight == attribute) {
+    prv_end_transaction();
+  }
+  free(attribute);
+}
+
+SmartstrapServiceId smartstrap_attribute_get_service_id(SmartstrapAttribute *attribute) {
+  return attribute->service_id;
+}
+
+SmartstrapAttributeId smartstrap_attribute_get_attribute_id(SmartstrapAttribute *attribute) {
+  return attribute->attribute_id;
+}
+
+static SmartstrapResult prv_check_bus(SmartstrapAttribute *attribute) {
+  if (!attribute) {
+    return SmartstrapResultInvalidArgs;
+  }
+  if (!s_subscribed) {
+    return SmartstrapResultNotPresent;
+  }
+  if (s_in_flight) {
+    s_stats.busy++;
+    return SmartstrapResultBusy;
+  }
+  return SmartstrapResultOk;
+}
+
+SmartstrapResult smartstrap_attribute_read(SmartstrapAttribute *attribute) {
+  SmartstrapResult result = prv_check_bus(attribute);
+  if (result != SmartstrapResultOk) {
+    return result;
+  }
+  if (attribute->writing) {
+    return SmartstrapResultBusy;
+  }
+
+  result = prv_transport()->read(attribute->service_id, attribute->attribute_id);
+  if (result == SmartstrapResultOk) {
+    prv_begin_transaction(attribute, false);
+    s_stats.reads++;
+  }
+  return result;
+}
+
+SmartstrapResult smartstrap_attribute_begin_write(SmartstrapAttribute *attribute, uint8_t **buffer,
+                                                  size_t *buffer_length) {
+  if (!buffer || !buffer_length) {
+    return SmartstrapResultInvalidArgs;
+  }
+  const SmartstrapResult result = prv_check_bus(attribute);
+  if (result != SmartstrapResultOk) {
+    return result;
+  }
+  if (attribute->writing) {
+    return SmartstrapResultBusy;
+  }
+
+  attribute->writing = true;
+  *buffer = attribute->buffer;
+  *buffer_length = attribute->buffer_length;
+  return SmartstrapResultOk;
+}
+
+SmartstrapResult smartstrap_attribute_end_write(SmartstrapAttribute *attribute, size_t write_length,
+                                                bool request_read) {
+  if (!attribute || !attribute->writing || write_length > attribute->buffer_length) {
+    return SmartstrapResultInvalidArgs;
+  }
+  attribute->writing = false;
+
+  const SmartstrapResult result = prv_check_bus(attribute);
+  if (result != SmartstrapResultOk) {
+    return result;
+  }
+  const SmartstrapResult write_result = prv_transport()->write(
+      attribute->service_id, attribute->attribute_id, attribute->buffer, write_length, request_read);
+  if (write_result == SmartstrapResultOk) {
+    prv_begin_transaction(attribute, true);
+    s_read_follows_write = request_read;
+    s_stats.writes++;
+  }
+  return write_result;
+}
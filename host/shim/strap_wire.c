@@ -0,0 +1,101 @@
+#include <string.h>
+#include "strap_wire.h"
+
+// CRC-8 with polynomial x^8 + x^2 + x + 1
+static uint8_t prv_crc8(const uint8_t *data, size_t length) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static size_t prv_put(uint8_t *out, size_t offset, uint8_t byte) {
+  if (byte == STRAP_WIRE_FLAG || byte == STRAP_WIRE_ESCAPE) {
+    out[offset++] = STRAP_WIRE_ESCAPE;
+    byte ^= STRAP_WIRE_ESCAPE_MASK;
+  }
+  out[offset++] = byte;
+  return offset;
+}
+
+size_t strap_wire_encode(const StrapWireFrame *frame, uint8_t *out) {
+  uint8_t raw[STRAP_WIRE_HEADER_LENGTH + STRAP_WIRE_MAX_PAYLOAD + 1];
+  const uint16_t length = frame->length < STRAP_WIRE_MAX_PAYLOAD ? frame->length : STRAP_WIRE_MAX_PAYLOAD;
+  raw[0] = frame->type;
+  raw[1] = frame->sequence;
+  raw[2] = frame->service_id & 0xff;
+  raw[3] = frame->service_id >> 8;
+  raw[4] = frame->attribute_id & 0xff;
+  raw[5] = frame->attribute_id >> 8;
+  raw[6] = frame->result;
+  raw[7] = length & 0xff;
+  raw[8] = length >> 8;
+  memcpy(&raw[STRAP_WIRE_HEADER_LENGTH], frame->payload, length);
+  const size_t raw_length = STRAP_WIRE_HEADER_LENGTH + length;
+  raw[raw_length] = prv_crc8(raw, raw_length);
+
+  size_t offset = 0;
+  out[offset++] = STRAP_WIRE_FLAG;
+  for (size_t i = 0; i <= raw_length; i++) {
+    offset = prv_put(out, offset, raw[i]);
+  }
+  out[offset++] = STRAP_WIRE_FLAG;
+  return offset;
+}
+
+static bool prv_parse(StrapWireDecoder *decoder, StrapWireFrame *frame) {
+  const uint8_t *raw = decoder->buffer;
+  if (decoder->length < STRAP_WIRE_HEADER_LENGTH + 1) {
+    return false;
+  }
+  const size_t raw_length = decoder->length - 1;
+  const uint16_t length = raw[7] | (raw[8] << 8);
+  if (length > STRAP_WIRE_MAX_PAYLOAD || raw_length != (size_t)STRAP_WIRE_HEADER_LENGTH + length ||
+      raw[raw_length] != prv_crc8(raw, raw_length)) {
+    return false;
+  }
+
+  frame->type = raw[0];
+  frame->sequence = raw[1];
+  frame->service_id = raw[2] | (raw[3] << 8);
+  frame->attribute_id = raw[4] | (raw[5] << 8);
+  frame->result = raw[6];
+  frame->length = length;
+  memcpy(frame->payload, &raw[STRAP_WIRE_HEADER_LENGTH], length);
+  return true;
+}
+
+bool strap_wire_decode(StrapWireDecoder *decoder, uint8_t byte, StrapWireFrame *frame) {
+  if (byte == STRAP_WIRE_FLAG) {
+    bool complete = false;
+    if (decoder->length || decoder->overflowed) {
+      complete = !decoder->overflowed && !decoder->escaped && prv_parse(decoder, frame);
+      if (!complete) {
+        decoder->bad_frames++;
+      }
+    }
+    decoder->length = 0;
+    decoder->escaped = false;
+    decoder->overflowed = false;
+    return complete;
+  }
+
+  if (byte == STRAP_WIRE_ESCAPE) {
+    decoder->escaped = true;
+    return false;
+  }
+  if (decoder->escaped) {
+    byte ^= STRAP_WIRE_ESCAPE_MASK;
+    decoder->escaped = false;
+  }
+  if (decoder->length == sizeof(decoder->buffer)) {
+    decoder->overflowed = true;
+    return false;
+  }
+  decoder->buffer[decoder->length++] = byte;
+  return false;
+}
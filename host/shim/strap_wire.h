@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Framing between the shim's pty transport (pty_strap.c) and the strap simulator (host/sim). It
+// carries the same service, attribute, read, write and notify model as the smartstrap link, in an
+// HDLC-style envelope: frames are delimited by STRAP_WIRE_FLAG, flag and escape bytes inside a
+// frame are sent as STRAP_WIRE_ESCAPE followed by the byte xor STRAP_WIRE_ESCAPE_MASK.
+//
+// Frame, little endian, before escaping:
+//  [0] type
+//  [1] sequence, echoed by the response to a request
+//  [2..3] service ID
+//  [4..5] attribute ID
+//  [6] result, a SmartstrapResult value, only meaningful in responses
+//  [7..8] payload length
+//  [9..] payload
+//  [last] CRC-8 of everything before it
+
+#define STRAP_WIRE_FLAG 0x7e
+#define STRAP_WIRE_ESCAPE 0x7d
+#define STRAP_WIRE_ESCAPE_MASK 0x20
+
+#define STRAP_WIRE_HEADER_LENGTH 9
+#define STRAP_WIRE_MAX_PAYLOAD 64
+// Worst case on the wire: two flags and every byte escaped
+#define STRAP_WIRE_MAX_ENCODED (2 + 2 * (STRAP_WIRE_HEADER_LENGTH + STRAP_WIRE_MAX_PAYLOAD + 1))
+
+typedef enum {
+  StrapWireTypeRead = 1,
+  StrapWireTypeWrite,
+  // Write followed by a read of the same attribute once acknowledged
+  StrapWireTypeWriteRead,
+  StrapWireTypeReadResponse,
+  StrapWireTypeWriteResponse,
+  StrapWireTypeNotify,
+} StrapWireType;
+
+// Values of SmartstrapResult the simulator sends
+typedef enum {
+  StrapWireResultOk = 0,
+  StrapWireResultBusy = 3,
+  StrapWireResultServiceUnavailable = 4,
+  StrapWireResultAttributeUnsupported = 5,
+} StrapWireResult;
+
+typedef struct {
+  uint8_t type;
+  uint8_t sequence;
+  uint16_t service_id;
+  uint16_t attribute_id;
+  uint8_t result;
+  uint16_t length;
+  uint8_t payload[STRAP_WIRE_MAX_PAYLOAD];
+} StrapWireFrame;
+
+typedef struct {
+  uint8_t buffer[STRAP_WIRE_HEADER_LENGTH + STRAP_WIRE_MAX_PAYLOAD + 1];
+  size_t length;
+  bool escaped;
+  bool overflowed;
+  // Frames dropped for a bad checksum, length or size
+  uint32_t bad_frames;
+} StrapWireDecoder;
+
+/*
+ * Encodes a frame
+ *  out: at least STRAP_WIRE_MAX_ENCODED bytes
+ *  returns: number of bytes to send
+ */
+size_t strap_wire_encode(const StrapWireFrame *frame, uint8_t *out);
+
+/*
+ * Feeds one received byte to a decoder, zero-initialized before the first byte
+ *  returns: true when the byte completes a valid frame, copied to frame
+ */
+bool strap_wire_decode(StrapWireDecoder *decoder, uint8_t byte, StrapWireFrame *frame);
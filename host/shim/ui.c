@@ -0,0 +1,817 @@
+#include <pebble.h>
+#include "host.h"
+
+#define WINDOW_STACK_SIZE 8
+#define DEFAULT_CELL_HEIGHT 44
+#define MENU_REPEAT_MS 100
+
+struct Layer {
+  GRect frame;
+  GRect bounds;
+  struct Layer *parent;
+  struct Layer *first_child;
+  struct Layer *next_sibling;
+  LayerUpdateProc update_proc;
+  bool hidden;
+  bool clips;
+  // Only used by the cell layers MenuLayer hands to its draw callbacks
+  bool highlighted;
+  size_t data_size;
+  max_align_t data[];
+};
+
+typedef struct {
+  ClickHandler handler;
+  uint16_t repeat_interval_ms;
+  void *context;
+} ClickConfig;
+
+struct Window {
+  Layer *root_layer;
+  WindowHandlers handlers;
+  GColor background_color;
+  ClickConfigProvider click_config_provider;
+  void *click_config_context;
+  ClickConfig clicks[NUM_BUTTONS];
+  bool loaded;
+};
+
+struct HostClickRecognizer {
+  bool repeating;
+  uint8_t clicks_counted;
+};
+
+static Window *s_window_stack[WINDOW_STACK_SIZE];
+static int s_window_stack_size;
+// Window whose click config provider is running
+static Window *s_configuring_window;
+static bool s_needs_render;
+
+/****** Layer ******/
+
+Layer *layer_create_with_data(GRect frame, size_t data_size) {
+  Layer *layer = malloc(sizeof(Layer) + data_size);
+  if (!layer) {
+    return NULL;
+  }
+  *layer = (Layer) {
+    .frame = frame,
+    .bounds = GRect(0, 0, frame.size.w, frame.size.h),
+    .clips = true,
+    .data_size = data_size,
+  };
+  memset(layer->data, 0, data_size);
+  return layer;
+}
+
+Layer *layer_create(GRect frame) {
+  return layer_create_with_data(frame, 0);
+}
+
+void layer_destroy(Layer *layer) {
+  if (!layer) {
+    return;
+  }
+  layer_remove_from_parent(layer);
+  // Children outlive their parent, detached, as on the watch
+  for (Layer *child = layer->first_child; child;) {
+    Layer *next = child->next_sibling;
+    child->parent = NULL;
+    child->next_sibling = NULL;
+    child = next;
+  }
+  free(layer);
+}
+
+void *layer_get_data(const Layer *layer) {
+  return layer->data_size ? (void *)layer->data : NULL;
+}
+
+void layer_mark_dirty(Layer *layer) {
+  host_layer_mark_dirty();
+  s_needs_render = true;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+void layer_set_frame(Layer *layer, GRect frame) {
+  if (grect_equal(&layer->frame, &frame)) {
+    return;
+  }
+  layer->frame = frame;
+  layer->bounds.size = frame.size;
+  layer_mark_dirty(layer);
+}
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+void layer_set_bounds(Layer *layer, GRect bounds) {
+  layer->bounds = bounds;
+  layer_mark_dirty(layer);
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return layer->bounds;
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+  layer_remove_from_parent(child);
+  child->parent = parent;
+  Layer **link = &parent->first_child;
+  while (*link) {
+    link = &(*link)->next_sibling;
+  }
+  *link = child;
+  layer_mark_dirty(parent);
+}
+
+void layer_remove_from_parent(Layer *child) {
+  if (!child->parent) {
+    return;
+  }
+  for (Layer **link = &child->parent->first_child; *link; link = &(*link)->next_sibling) {
+    if (*link == child) {
+      *link = child->next_sibling;
+      break;
+    }
+  }
+  layer_mark_dirty(child->parent);
+  child->parent = NULL;
+  child->next_sibling = NULL;
+}
+
+void layer_set_clips(Layer *layer, bool clips) {
+  layer->clips = clips;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+  layer->hidden = hidden;
+  layer_mark_dirty(layer);
+}
+
+GPoint layer_convert_point_to_screen(const Layer *layer, GPoint point) {
+  for (; layer; layer = layer->parent) {
+    point.x += layer->frame.origin.x + layer->bounds.origin.x;
+    point.y += layer->frame.origin.y + layer->bounds.origin.y;
+  }
+  return point;
+}
+
+static void prv_render_layer(Layer *layer, GContext *ctx, GPoint parent_origin, GRect parent_clip) {
+  if (layer->hidden) {
+    return;
+  }
+
+  const GPoint frame_origin = GPoint(parent_origin.x + layer->frame.origin.x,
+                                     parent_origin.y + layer->frame.origin.y);
+  GRect clip = parent_clip;
+  if (layer->clips) {
+    clip = host_grect_intersect(clip, (GRect) { frame_origin, layer->frame.size });
+  }
+  const GPoint origin = GPoint(frame_origin.x + layer->bounds.origin.x,
+                               frame_origin.y + layer->bounds.origin.y);
+
+  if (layer->update_proc) {
+    host_graphics_set_origin(ctx, origin, clip);
+    host_graphics_count_update();
+    layer->update_proc(layer, ctx);
+  }
+  for (Layer *child = layer->first_child; child; child = child->next_sibling) {
+    prv_render_layer(child, ctx, origin, clip);
+  }
+}
+
+void host_render(void) {
+  if (!s_needs_render || !s_window_stack_size) {
+    return;
+  }
+  s_needs_render = false;
+
+  GContext *ctx = host_graphics_begin_frame();
+  Window *window = s_window_stack[s_window_stack_size - 1];
+  prv_render_layer(window->root_layer, ctx, GPointZero,
+                   GRect(0, 0, HOST_SCREEN_WIDTH, HOST_SCREEN_HEIGHT));
+}
+
+/****** TextLayer ******/
+
+typedef struct {
+  const char *text;
+  GFont font;
+  GTextAlignment alignment;
+  GColor text_color;
+  GColor background_color;
+} TextLayerData;
+
+static void prv_text_layer_update(Layer *layer, GContext *ctx) {
+  TextLayerData *data = layer_get_data(layer);
+  const GRect bounds = layer_get_bounds(layer);
+  if (!gcolor_equal(data->background_color, GColorClear)) {
+    graphics_context_set_fill_color(ctx, data->background_color);
+    graphics_fill_rect(ctx, bounds, 0, GCornerNone);
+  }
+  graphics_context_set_text_color(ctx, data->text_color);
+  graphics_draw_text(ctx, data->text, data->font, bounds, GTextOverflowModeWordWrap, data->alignment,
+                     NULL);
+}
+
+TextLayer *text_layer_create(GRect frame) {
+  Layer *layer = layer_create_with_data(frame, sizeof(TextLayerData));
+  TextLayerData *data = layer_get_data(layer);
+  *data = (TextLayerData) {
+    .font = fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD),
+    .alignment = GTextAlignmentLeft,
+    .text_color = GColorBlack,
+    .background_color = GColorWhite,
+  };
+  layer_set_update_proc(layer, prv_text_layer_update);
+  return (TextLayer *)layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+  layer_destroy((Layer *)text_layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return (Layer *)text_layer;
+}
+
+static TextLayerData *prv_text_layer_data(TextLayer *text_layer) {
+  layer_mark_dirty((Layer *)text_layer);
+  return layer_get_data((Layer *)text_layer);
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  prv_text_layer_data(text_layer)->text = text;
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+  prv_text_layer_data(text_layer)->font = font;
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment) {
+  prv_text_layer_data(text_layer)->alignment = text_alignment;
+}
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+  prv_text_layer_data(text_layer)->text_color = color;
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+  prv_text_layer_data(text_layer)->background_color = color;
+}
+
+/****** StatusBarLayer ******/
+
+typedef struct {
+  GColor background_color;
+  GColor foreground_color;
+  StatusBarLayerSeparatorMode separator_mode;
+} StatusBarLayerData;
+
+static void prv_status_bar_layer_update(Layer *layer, GContext *ctx) {
+  StatusBarLayerData *data = layer_get_data(layer);
+  const GRect bounds = layer_get_bounds(layer);
+  if (!gcolor_equal(data->background_color, GColorClear)) {
+    graphics_context_set_fill_color(ctx, data->background_color);
+    graphics_fill_rect(ctx, bounds, 0, GCornerNone);
+  }
+  graphics_context_set_text_color(ctx, data->foreground_color);
+  graphics_draw_text(ctx, "12:00", fonts_get_system_font(FONT_KEY_GOTHIC_14), bounds,
+                     GTextOverflowModeFill, GTextAlignmentCenter, NULL);
+  if (data->separator_mode == StatusBarLayerSeparatorModeDotted) {
+    graphics_context_set_stroke_color(ctx, data->foreground_color);
+    graphics_draw_line(ctx, GPoint(0, bounds.size.h - 1), GPoint(bounds.size.w - 1, bounds.size.h - 1));
+  }
+}
+
+StatusBarLayer *status_bar_layer_create(void) {
+  Layer *layer = layer_create_with_data(GRect(0, 0, HOST_SCREEN_WIDTH, STATUS_BAR_LAYER_HEIGHT),
+                                        sizeof(StatusBarLayerData));
+  StatusBarLayerData *data = layer_get_data(layer);
+  *data = (StatusBarLayerData) {
+    .background_color = GColorBlack,
+    .foreground_color = GColorWhite,
+  };
+  layer_set_update_proc(layer, prv_status_bar_layer_update);
+  return (StatusBarLayer *)layer;
+}
+
+void status_bar_layer_destroy(StatusBarLayer *status_bar_layer) {
+  layer_destroy((Layer *)status_bar_layer);
+}
+
+Layer *status_bar_layer_get_layer(StatusBarLayer *status_bar_layer) {
+  return (Layer *)status_bar_layer;
+}
+
+void status_bar_layer_set_colors(StatusBarLayer *status_bar_layer, GColor background, GColor foreground) {
+  StatusBarLayerData *data = layer_get_data((Layer *)status_bar_layer);
+  data->background_color = background;
+  data->foreground_color = foreground;
+  layer_mark_dirty((Layer *)status_bar_layer);
+}
+
+void status_bar_layer_set_separator_mode(StatusBarLayer *status_bar_layer, StatusBarLayerSeparatorMode mode) {
+  StatusBarLayerData *data = layer_get_data((Layer *)status_bar_layer);
+  data->separator_mode = mode;
+  layer_mark_dirty((Layer *)status_bar_layer);
+}
+
+/****** Window ******/
+
+static void prv_window_root_update(Layer *layer, GContext *ctx) {
+  Window *window = *(Window **)layer_get_data(layer);
+  if (!gcolor_equal(window->background_color, GColorClear)) {
+    graphics_context_set_fill_color(ctx, window->background_color);
+    graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
+  }
+}
+
+Window *window_create(void) {
+  Window *window = malloc(sizeof(Window));
+  if (!window) {
+    return NULL;
+  }
+  *window = (Window) {
+    .root_layer = layer_create_with_data(GRect(0, 0, HOST_SCREEN_WIDTH, HOST_SCREEN_HEIGHT),
+                                         sizeof(Window *)),
+    .background_color = GColorWhite,
+  };
+  *(Window **)layer_get_data(window->root_layer) = window;
+  layer_set_update_proc(window->root_layer, prv_window_root_update);
+  return window;
+}
+
+void window_destroy(Window *window) {
+  if (!window) {
+    return;
+  }
+  window_stack_remove(window, false);
+  layer_destroy(window->root_layer);
+  free(window);
+}
+
+Layer *window_get_root_layer(const Window *window) {
+  return window->root_layer;
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+void window_set_background_color(Window *window, GColor background_color) {
+  window->background_color = background_color;
+  layer_mark_dirty(window->root_layer);
+}
+
+static void prv_window_configure_clicks(Window *window) {
+  memset(window->clicks, 0, sizeof(window->clicks));
+  if (!window->click_config_provider) {
+    return;
+  }
+  for (int i = 0; i < NUM_BUTTONS; i++) {
+    window->clicks[i].context = window->click_config_context;
+  }
+  s_configuring_window = window;
+  window->click_config_provider(window->click_config_context);
+  s_configuring_window = NULL;
+}
+
+void window_set_click_config_provider_with_context(Window *window, ClickConfigProvider click_config_provider,
+                                                   void *context) {
+  window->click_config_provider = click_config_provider;
+  window->click_config_context = context;
+  if (window_stack_get_top_window() == window) {
+    prv_window_configure_clicks(window);
+  }
+}
+
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider) {
+  window_set_click_config_provider_with_context(window, click_config_provider, window);
+}
+
+void window_set_click_context(ButtonId button_id, void *context) {
+  if (s_configuring_window) {
+    s_configuring_window->clicks[button_id].context = context;
+  }
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+  window_single_repeating_click_subscribe(button_id, 0, handler);
+}
+
+void window_single_repeating_click_subscribe(ButtonId button_id, uint16_t repeat_interval_ms,
+                                             ClickHandler handler) {
+  if (s_configuring_window) {
+    s_configuring_window->clicks[button_id].handler = handler;
+    s_configuring_window->clicks[button_id].repeat_interval_ms = repeat_interval_ms;
+  }
+}
+
+bool click_recognizer_is_repeating(ClickRecognizerRef recognizer) {
+  return recognizer->repeating;
+}
+
+uint8_t click_number_of_clicks_counted(ClickRecognizerRef recognizer) {
+  return recognizer->clicks_counted;
+}
+
+/****** Window stack ******/
+
+static void prv_window_appear(Window *window) {
+  if (!window->loaded) {
+    window->loaded = true;
+    if (window->handlers.load) {
+      window->handlers.load(window);
+    }
+  }
+  if (window->handlers.appear) {
+    window->handlers.appear(window);
+  }
+  prv_window_configure_clicks(window);
+  layer_mark_dirty(window->root_layer);
+}
+
+static void prv_window_disappear(Window *window, bool unload) {
+  if (window->handlers.disappear) {
+    window->handlers.disappear(window);
+  }
+  if (unload && window->loaded) {
+    window->loaded = false;
+    if (window->handlers.unload) {
+      window->handlers.unload(window);
+    }
+  }
+}
+
+void window_stack_push(Window *window, bool animated) {
+  if (s_window_stack_size == WINDOW_STACK_SIZE) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Window stack is full");
+    return;
+  }
+  Window *below = window_stack_get_top_window();
+  if (below) {
+    prv_window_disappear(below, false);
+  }
+  s_window_stack[s_window_stack_size++] = window;
+  prv_window_appear(window);
+}
+
+bool window_stack_remove(Window *window, bool animated) {
+  for (int i = 0; i < s_window_stack_size; i++) {
+    if (s_window_stack[i] != window) {
+      continue;
+    }
+
+    const bool was_top = (i == s_window_stack_size - 1);
+    memmove(&s_window_stack[i], &s_window_stack[i + 1], (s_window_stack_size - i - 1) * sizeof(Window *));
+    s_window_stack_size--;
+    prv_window_disappear(window, true);
+
+    Window *top = window_stack_get_top_window();
+    if (was_top && top) {
+      prv_window_appear(top);
+    }
+    return true;
+  }
+  return false;
+}
+
+Window *window_stack_pop(bool animated) {
+  Window *window = window_stack_get_top_window();
+  if (window) {
+    window_stack_remove(window, animated);
+  }
+  return window;
+}
+
+Window *window_stack_get_top_window(void) {
+  return s_window_stack_size ? s_window_stack[s_window_stack_size - 1] : NULL;
+}
+
+/****** Buttons ******/
+
+const char *host_button_name(ButtonId button) {
+  static const char *const names[NUM_BUTTONS] = { "back", "up", "select", "down" };
+  return button < NUM_BUTTONS ? names[button] : "?";
+}
+
+static bool prv_button_press(ButtonId button, bool repeating, uint8_t clicks_counted) {
+  Window *window = window_stack_get_top_window();
+  if (!window) {
+    return false;
+  }
+
+  ClickConfig *config = &window->clicks[button];
+  if (!config->handler) {
+    if (button == BUTTON_ID_BACK && !repeating) {
+      window_stack_pop(true);
+    }
+    return false;
+  }
+
+  struct HostClickRecognizer recognizer = {
+    .repeating = repeating,
+    .clicks_counted = clicks_counted,
+  };
+  config->handler(&recognizer, config->context);
+  host_animation_reap();
+  host_render();
+  return true;
+}
+
+void host_click(ButtonId button) {
+  prv_button_press(button, false, 1);
+}
+
+void host_hold(ButtonId button, int repeats) {
+  Window *window = window_stack_get_top_window();
+  if (!prv_button_press(button, false, 1)) {
+    return;
+  }
+
+  for (int i = 0; i < repeats; i++) {
+    if (window_stack_get_top_window() != window || !window->clicks[button].repeat_interval_ms) {
+      return;
+    }
+    host_run_for(window->clicks[button].repeat_interval_ms);
+    prv_button_press(button, true, i + 2);
+  }
+}
+
+/****** MenuLayer ******/
+
+typedef struct {
+  MenuLayerCallbacks callbacks;
+  void *context;
+  MenuIndex selected;
+  // Content offset of the top of the visible area
+  int16_t scroll_y;
+} MenuLayerData;
+
+static MenuLayerData *prv_menu_data(const MenuLayer *menu_layer) {
+  return layer_get_data((Layer *)menu_layer);
+}
+
+static uint16_t prv_menu_num_sections(MenuLayer *menu_layer) {
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  if (!data->callbacks.get_num_sections) {
+    return 1;
+  }
+  return data->callbacks.get_num_sections(menu_layer, data->context);
+}
+
+static uint16_t prv_menu_num_rows(MenuLayer *menu_layer, uint16_t section) {
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  if (!data->callbacks.get_num_rows) {
+    return 0;
+  }
+  return data->callbacks.get_num_rows(menu_layer, section, data->context);
+}
+
+static int16_t prv_menu_cell_height(MenuLayer *menu_layer, MenuIndex index) {
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  if (!data->callbacks.get_cell_height) {
+    return DEFAULT_CELL_HEIGHT;
+  }
+  return data->callbacks.get_cell_height(menu_layer, &index, data->context);
+}
+
+static int16_t prv_menu_header_height(MenuLayer *menu_layer, uint16_t section) {
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  if (!data->callbacks.get_header_height) {
+    return 0;
+  }
+  return data->callbacks.get_header_height(menu_layer, section, data->context);
+}
+
+// Content y of a cell
+static int16_t prv_menu_cell_y(MenuLayer *menu_layer, MenuIndex index) {
+  int16_t y = 0;
+  for (uint16_t s = 0; s <= index.section; s++) {
+    y += prv_menu_header_height(menu_layer, s);
+    const uint16_t rows = (s == index.section) ? index.row : prv_menu_num_rows(menu_layer, s);
+    for (uint16_t r = 0; r < rows; r++) {
+      y += prv_menu_cell_height(menu_layer, (MenuIndex) { s, r });
+    }
+  }
+  return y;
+}
+
+static void prv_menu_draw_cell(MenuLayer *menu_layer, GContext *ctx, GRect cell, bool highlighted,
+                               GPoint menu_origin, GRect menu_clip, MenuIndex *index, bool header) {
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  const GPoint origin = GPoint(menu_origin.x + cell.origin.x, menu_origin.y + cell.origin.y);
+  const GRect clip = host_grect_intersect(menu_clip, (GRect) { origin, cell.size });
+  if (clip.size.h == 0) {
+    return;
+  }
+
+  Layer cell_layer = {
+    .frame = cell,
+    .bounds = GRect(0, 0, cell.size.w, cell.size.h),
+    .highlighted = highlighted,
+  };
+  host_graphics_set_origin(ctx, origin, clip);
+  graphics_context_set_fill_color(ctx, highlighted ? GColorBlack : GColorWhite);
+  graphics_fill_rect(ctx, cell_layer.bounds, 0, GCornerNone);
+  graphics_context_set_text_color(ctx, highlighted ? GColorWhite : GColorBlack);
+
+  if (header && data->callbacks.draw_header) {
+    data->callbacks.draw_header(ctx, &cell_layer, index->section, data->context);
+  } else if (!header && data->callbacks.draw_row) {
+    data->callbacks.draw_row(ctx, &cell_layer, index, data->context);
+  }
+}
+
+static void prv_menu_layer_update(Layer *layer, GContext *ctx) {
+  MenuLayer *menu_layer = (MenuLayer *)layer;
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  const GRect bounds = layer_get_bounds(layer);
+
+  GPoint menu_origin;
+  GRect menu_clip;
+  host_graphics_get_origin(ctx, &menu_origin, &menu_clip);
+
+  int16_t y = -data->scroll_y;
+  const uint16_t num_sections = prv_menu_num_sections(menu_layer);
+  for (uint16_t s = 0; s < num_sections && y < bounds.size.h; s++) {
+    MenuIndex index = { s, 0 };
+    const int16_t header_height = prv_menu_header_height(menu_layer, s);
+    if (header_height > 0) {
+      prv_menu_draw_cell(menu_layer, ctx, GRect(0, y, bounds.size.w, header_height), false, menu_origin,
+                         menu_clip, &index, true);
+      y += header_height;
+    }
+
+    const uint16_t num_rows = prv_menu_num_rows(menu_layer, s);
+    for (uint16_t r = 0; r < num_rows && y < bounds.size.h; r++) {
+      index.row = r;
+      const int16_t height = prv_menu_cell_height(menu_layer, index);
+      if (y + height > 0) {
+        const bool highlighted = (s == data->selected.section && r == data->selected.row);
+        prv_menu_draw_cell(menu_layer, ctx, GRect(0, y, bounds.size.w, height), highlighted, menu_origin,
+                           menu_clip, &index, false);
+      }
+      y += height;
+    }
+  }
+  host_graphics_set_origin(ctx, menu_origin, menu_clip);
+}
+
+static void prv_menu_scroll_to_selection(MenuLayer *menu_layer) {
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  const int16_t visible_height = layer_get_bounds((Layer *)menu_layer).size.h;
+  const int16_t y = prv_menu_cell_y(menu_layer, data->selected);
+  const int16_t height = prv_menu_cell_height(menu_layer, data->selected);
+
+  // Keep the header of the first section in view when its first row is selected
+  if (data->selected.section == 0 && data->selected.row == 0) {
+    data->scroll_y = 0;
+  } else if (y < data->scroll_y) {
+    data->scroll_y = y;
+  } else if (y + height > data->scroll_y + visible_height) {
+    data->scroll_y = y + height - visible_height;
+  }
+}
+
+MenuLayer *menu_layer_create(GRect frame) {
+  Layer *layer = layer_create_with_data(frame, sizeof(MenuLayerData));
+  layer_set_update_proc(layer, prv_menu_layer_update);
+  return (MenuLayer *)layer;
+}
+
+void menu_layer_destroy(MenuLayer *menu_layer) {
+  layer_destroy((Layer *)menu_layer);
+}
+
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer) {
+  return (Layer *)menu_layer;
+}
+
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks) {
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  data->callbacks = callbacks;
+  data->context = callback_context;
+  menu_layer_reload_data(menu_layer);
+}
+
+void menu_layer_reload_data(MenuLayer *menu_layer) {
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  const uint16_t num_sections = prv_menu_num_sections(menu_layer);
+  if (data->selected.section >= num_sections) {
+    data->selected = (MenuIndex) { num_sections ? num_sections - 1 : 0, 0 };
+  }
+  const uint16_t num_rows = num_sections ? prv_menu_num_rows(menu_layer, data->selected.section) : 0;
+  if (data->selected.row >= num_rows) {
+    data->selected.row = num_rows ? num_rows - 1 : 0;
+  }
+  prv_menu_scroll_to_selection(menu_layer);
+  layer_mark_dirty((Layer *)menu_layer);
+}
+
+static void prv_menu_move(MenuLayer *menu_layer, bool down) {
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  MenuIndex index = data->selected;
+  const uint16_t num_sections = prv_menu_num_sections(menu_layer);
+
+  if (down) {
+    if (index.row + 1 < prv_menu_num_rows(menu_layer, index.section)) {
+      index.row++;
+    } else {
+      // Skip empty sections
+      for (uint16_t s = index.section + 1; s < num_sections; s++) {
+        if (prv_menu_num_rows(menu_layer, s)) {
+          index = (MenuIndex) { s, 0 };
+          break;
+        }
+      }
+    }
+  } else {
+    if (index.row > 0) {
+      index.row--;
+    } else {
+      for (int s = index.section - 1; s >= 0; s--) {
+        const uint16_t rows = prv_menu_num_rows(menu_layer, s);
+        if (rows) {
+          index = (MenuIndex) { s, rows - 1 };
+          break;
+        }
+      }
+    }
+  }
+
+  if (index.section != data->selected.section || index.row != data->selected.row) {
+    data->selected = index;
+    prv_menu_scroll_to_selection(menu_layer);
+    layer_mark_dirty((Layer *)menu_layer);
+  }
+}
+
+static void prv_menu_up_click(ClickRecognizerRef recognizer, void *context) {
+  prv_menu_move(context, false);
+}
+
+static void prv_menu_down_click(ClickRecognizerRef recognizer, void *context) {
+  prv_menu_move(context, true);
+}
+
+static void prv_menu_select_click(ClickRecognizerRef recognizer, void *context) {
+  MenuLayer *menu_layer = context;
+  MenuLayerData *data = prv_menu_data(menu_layer);
+  if (data->callbacks.select_click) {
+    MenuIndex index = data->selected;
+    data->callbacks.select_click(menu_layer, &index, data->context);
+  }
+}
+
+static void prv_menu_click_config(void *context) {
+  window_single_repeating_click_subscribe(BUTTON_ID_UP, MENU_REPEAT_MS, prv_menu_up_click);
+  window_single_repeating_click_subscribe(BUTTON_ID_DOWN, MENU_REPEAT_MS, prv_menu_down_click);
+  window_single_click_subscribe(BUTTON_ID_SELECT, prv_menu_select_click);
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, struct Window *window) {
+  window_set_click_config_provider_with_context(window, prv_menu_click_config, menu_layer);
+}
+
+bool menu_cell_layer_is_highlighted(const Layer *cell_layer) {
+  return cell_layer->highlighted;
+}
+
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title, const char *subtitle,
+                          GBitmap *icon) {
+  const GRect bounds = layer_get_bounds(cell_layer);
+  int16_t x = 5;
+  if (icon) {
+    const GRect icon_bounds = gbitmap_get_bounds(icon);
+    graphics_draw_bitmap_in_rect(ctx, icon,
+                                 GRect(x, (bounds.size.h - icon_bounds.size.h) / 2,
+                                       icon_bounds.size.w, icon_bounds.size.h));
+    x += icon_bounds.size.w + 5;
+  }
+
+  const int16_t width = bounds.size.w - x - 5;
+  if (subtitle) {
+    graphics_draw_text(ctx, title, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), GRect(x, -4, width, 28),
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    graphics_draw_text(ctx, subtitle, fonts_get_system_font(FONT_KEY_GOTHIC_18), GRect(x, 22, width, 22),
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+  } else {
+    graphics_draw_text(ctx, title, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD),
+                       GRect(x, (bounds.size.h - 28) / 2, width, 28), GTextOverflowModeTrailingEllipsis,
+                       GTextAlignmentLeft, NULL);
+  }
+}
+
+void menu_cell_basic_header_draw(GContext *ctx, const Layer *cell_layer, const char *title) {
+  const GRect bounds = layer_get_bounds(cell_layer);
+  graphics_draw_text(ctx, title, fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD),
+                     GRect(2, -2, bounds.size.w - 4, bounds.size.h + 2), GTextOverflowModeTrailingEllipsis,
+                     GTextAlignmentLeft, NULL);
+}
@@ -0,0 +1,584 @@
+// Stands in for arduino/smartstrap/smartstrap.ino on a pty, so a host build of the watchapp can be
+// benchmarked and soak-tested without hardware. It serves the firmware's service and attributes,
+// notifies input changes, answers reads and acknowledges writes, with scriptable input waveforms,
+// a configurable bus delay and injected Busy results and dropped responses (seen by the watch as
+// SmartstrapResultTimeOut). Frames are described in host/shim/strap_wire.h.
+//
+//   build/strap_sim --link /tmp/strap --wave 1=sine,1000,0,255 --delay 4 &
+//   PEBBLE_HOST_STRAP=/tmp/strap PEBBLE_HOST_SCRIPT=script.txt build/pebblits
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "strap_wire.h"
+
+// Keep in sync with pebble/src/strap/strap_protocol.h
+#define SERVICE_ID 0x1001
+#define TOP_INPUT_ATTRIBUTE_ID 0x0001
+#define TOP_OUTPUT_ATTRIBUTE_ID 0x0002
+#define CENTER_INPUT_ATTRIBUTE_ID 0x0003
+#define CENTER_OUTPUT_ATTRIBUTE_ID 0x0004
+#define BOTTOM_INPUT_ATTRIBUTE_ID 0x0005
+#define BOTTOM_OUTPUT_ATTRIBUTE_ID 0x0006
+#define ALL_INPUTS_ATTRIBUTE_ID 0x0007
+#define ALL_OUTPUTS_ATTRIBUTE_ID 0x0008
+#define STREAM_CONFIG_ATTRIBUTE_ID 0x000A
+#define NOTIFY_CONFIG_ATTRIBUTE_ID 0x000B
+
+#define ALL_INPUTS_LENGTH 9
+#define ALL_OUTPUTS_LENGTH 4
+#define STREAM_CONFIG_LENGTH 2
+#define NOTIFY_CONFIG_LENGTH 17
+
+#define NUM_CHANNELS 3
+#define MAX_QUEUED 16
+#define MAX_SCRIPT_STEPS 1024
+
+typedef enum {
+  ShapeConst,
+  ShapeSquare,
+  ShapeSine,
+  ShapeSaw,
+  ShapeTriangle,
+  ShapeNoise,
+} Shape;
+
+typedef struct {
+  Shape shape;
+  uint32_t period_ms;
+  uint8_t low;
+  uint8_t high;
+} Wave;
+
+// Input script step: from at_ms on, the channel holds value
+typedef struct {
+  uint32_t at_ms;
+  int channel;
+  uint8_t value;
+} ScriptStep;
+
+typedef struct {
+  uint64_t due_ms;
+  StrapWireFrame frame;
+} Queued;
+
+typedef struct {
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t notifies;
+  uint32_t injected_busy;
+  uint32_t dropped;
+  uint32_t output_updates[NUM_CHANNELS];
+  uint32_t bad_frames;
+} Stats;
+
+static struct {
+  const char *link;
+  uint32_t delay_ms;
+  uint32_t jitter_ms;
+  uint32_t busy_percent;
+  uint32_t drop_percent;
+  uint32_t notify_ms;
+  uint32_t loop_ms;
+  uint32_t duration_s;
+  bool basic;
+} s_options = {
+  .notify_ms = 20,
+  .loop_ms = 1,
+};
+
+static Wave s_waves[NUM_CHANNELS];
+static ScriptStep s_script[MAX_SCRIPT_STEPS];
+static int s_num_script_steps;
+
+static int s_master = -1;
+static uint64_t s_start_ms;
+static volatile sig_atomic_t s_quit;
+
+static uint8_t s_inputs[NUM_CHANNELS];
+static uint8_t s_notified_values[NUM_CHANNELS];
+static uint64_t s_notified_ms;
+static uint16_t s_sequence;
+static uint8_t s_outputs[NUM_CHANNELS];
+
+static Queued s_queue[MAX_QUEUED];
+static int s_queue_length;
+static Stats s_stats;
+
+static const uint16_t INPUT_IDS[NUM_CHANNELS] = {
+  TOP_INPUT_ATTRIBUTE_ID, CENTER_INPUT_ATTRIBUTE_ID, BOTTOM_INPUT_ATTRIBUTE_ID
+};
+static const uint16_t OUTPUT_IDS[NUM_CHANNELS] = {
+  TOP_OUTPUT_ATTRIBUTE_ID, CENTER_OUTPUT_ATTRIBUTE_ID, BOTTOM_OUTPUT_ATTRIBUTE_ID
+};
+
+static uint64_t prv_now_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000 - s_start_ms;
+}
+
+static bool prv_chance(uint32_t percent) {
+  return percent && (uint32_t)(rand() % 100) < percent;
+}
+
+/****** Inputs ******/
+
+static uint8_t prv_wave_value(const Wave *wave, uint64_t now_ms) {
+  const uint32_t period = wave->period_ms ? wave->period_ms : 1;
+  const double phase = (double)(now_ms % period) / period;
+  const int span = wave->high - wave->low;
+  switch (wave->shape) {
+    case ShapeSquare:
+      return phase < 0.5 ? wave->low : wave->high;
+    case ShapeSine:
+      return wave->low + (uint8_t)lround(span * (0.5 - 0.5 * cos(2 * M_PI * phase)));
+    case ShapeSaw:
+      return wave->low + (uint8_t)(span * phase);
+    case ShapeTriangle:
+      return wave->low + (uint8_t)(span * (phase < 0.5 ? 2 * phase : 2 - 2 * phase));
+    case ShapeNoise:
+      return wave->low + (span ? rand() % (span + 1) : 0);
+    case ShapeConst:
+    default:
+      return wave->low;
+  }
+}
+
+static void prv_sample_inputs(uint64_t now_ms) {
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    s_inputs[i] = prv_wave_value(&s_waves[i], now_ms);
+  }
+  // Script steps override the waves from their time on
+  for (int i = 0; i < s_num_script_steps && s_script[i].at_ms <= now_ms; i++) {
+    s_inputs[s_script[i].channel] = s_script[i].value;
+  }
+}
+
+/****** Frames ******/
+
+static void prv_send(const StrapWireFrame *frame) {
+  uint8_t encoded[STRAP_WIRE_MAX_ENCODED];
+  const size_t length = strap_wire_encode(frame, encoded);
+  size_t sent = 0;
+  while (sent < length) {
+    const ssize_t count = write(s_master, encoded + sent, length - sent);
+    if (count < 0 && errno != EAGAIN && errno != EINTR) {
+      return;
+    }
+    if (count > 0) {
+      sent += count;
+    }
+  }
+}
+
+static void prv_queue(const StrapWireFrame *frame, uint32_t extra_delay_ms) {
+  if (s_queue_length == MAX_QUEUED) {
+    s_stats.dropped++;
+    return;
+  }
+  uint32_t delay = s_options.delay_ms + extra_delay_ms;
+  if (s_options.jitter_ms) {
+    delay += rand() % (s_options.jitter_ms + 1);
+  }
+  // Responses keep their order on the bus whatever the jitter
+  uint64_t due_ms = prv_now_ms() + delay;
+  if (s_queue_length && s_queue[s_queue_length - 1].due_ms > due_ms) {
+    due_ms = s_queue[s_queue_length - 1].due_ms;
+  }
+  s_queue[s_queue_length++] = (Queued) { .due_ms = due_ms, .frame = *frame };
+}
+
+static void prv_flush_queue(uint64_t now_ms) {
+  int sent = 0;
+  while (sent < s_queue_length && s_queue[sent].due_ms <= now_ms) {
+    prv_send(&s_queue[sent].frame);
+    sent++;
+  }
+  memmove(s_queue, &s_queue[sent], (s_queue_length - sent) * sizeof(Queued));
+  s_queue_length -= sent;
+}
+
+static void prv_notify(uint16_t attribute_id) {
+  const StrapWireFrame frame = {
+    .type = StrapWireTypeNotify,
+    .service_id = SERVICE_ID,
+    .attribute_id = attribute_id,
+  };
+  s_stats.notifies++;
+  prv_send(&frame);
+}
+
+static int prv_index_of(const uint16_t *ids, uint16_t attribute_id) {
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    if (ids[i] == attribute_id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void prv_set_output(int channel, uint8_t value) {
+  s_outputs[channel] = value;
+  s_stats.output_updates[channel]++;
+}
+
+// Fills in the read response for an attribute, returning its result
+static uint8_t prv_read_attribute(uint16_t attribute_id, StrapWireFrame *response) {
+  const int input = prv_index_of(INPUT_IDS, attribute_id);
+  if (input >= 0) {
+    response->payload[0] = s_notified_values[input];
+    response->length = 1;
+    return StrapWireResultOk;
+  }
+  if (attribute_id == ALL_INPUTS_ATTRIBUTE_ID && !s_options.basic) {
+    const uint32_t timestamp = (uint32_t)s_notified_ms;
+    memcpy(response->payload, s_notified_values, NUM_CHANNELS);
+    response->payload[3] = s_sequence & 0xff;
+    response->payload[4] = s_sequence >> 8;
+    for (int i = 0; i < 4; i++) {
+      response->payload[5 + i] = (timestamp >> (8 * i)) & 0xff;
+    }
+    response->length = ALL_INPUTS_LENGTH;
+    return StrapWireResultOk;
+  }
+  return StrapWireResultAttributeUnsupported;
+}
+
+static uint8_t prv_write_attribute(uint16_t attribute_id, const uint8_t *data, uint16_t length) {
+  const int output = prv_index_of(OUTPUT_IDS, attribute_id);
+  if (output >= 0 && length == 1) {
+    prv_set_output(output, data[0]);
+    return StrapWireResultOk;
+  }
+  if (s_options.basic) {
+    return StrapWireResultAttributeUnsupported;
+  }
+  if (attribute_id == ALL_OUTPUTS_ATTRIBUTE_ID && length == ALL_OUTPUTS_LENGTH) {
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+      if (data[0] & (1 << i)) {
+        prv_set_output(i, data[1 + i]);
+      }
+    }
+    return StrapWireResultOk;
+  }
+  // Pacing and streaming are accepted but the simulator keeps its own notify interval
+  if ((attribute_id == STREAM_CONFIG_ATTRIBUTE_ID && length == STREAM_CONFIG_LENGTH) ||
+      (attribute_id == NOTIFY_CONFIG_ATTRIBUTE_ID && length == NOTIFY_CONFIG_LENGTH)) {
+    return StrapWireResultOk;
+  }
+  return StrapWireResultAttributeUnsupported;
+}
+
+static void prv_handle_request(const StrapWireFrame *request) {
+  const bool is_read = request->type == StrapWireTypeRead;
+  const bool is_write = request->type == StrapWireTypeWrite || request->type == StrapWireTypeWriteRead;
+  if (!is_read && !is_write) {
+    return;
+  }
+  if (is_read) {
+    s_stats.reads++;
+  } else {
+    s_stats.writes++;
+  }
+
+  // A dropped request is never answered and times out on the watch
+  if (prv_chance(s_options.drop_percent)) {
+    s_stats.dropped++;
+    return;
+  }
+
+  StrapWireFrame response = {
+    .type = is_read ? StrapWireTypeReadResponse : StrapWireTypeWriteResponse,
+    .sequence = request->sequence,
+    .service_id = request->service_id,
+    .attribute_id = request->attribute_id,
+  };
+  if (prv_chance(s_options.busy_percent)) {
+    s_stats.injected_busy++;
+    response.result = StrapWireResultBusy;
+  } else if (request->service_id != SERVICE_ID) {
+    response.result = StrapWireResultServiceUnavailable;
+  } else if (is_read) {
+    response.result = prv_read_attribute(request->attribute_id, &response);
+  } else {
+    response.result = prv_write_attribute(request->attribute_id, request->payload, request->length);
+  }
+  prv_queue(&response, 0);
+
+  if (request->type == StrapWireTypeWriteRead && response.result == StrapWireResultOk) {
+    StrapWireFrame read_response = {
+      .type = StrapWireTypeReadResponse,
+      .sequence = request->sequence,
+      .service_id = request->service_id,
+      .attribute_id = request->attribute_id,
+    };
+    read_response.result = prv_read_attribute(request->attribute_id, &read_response);
+    prv_queue(&read_response, s_options.delay_ms);
+  }
+}
+
+/****** Loop ******/
+
+static void prv_loop(uint64_t now_ms) {
+  prv_sample_inputs(now_ms);
+  if (now_ms - s_notified_ms < s_options.notify_ms) {
+    return;
+  }
+
+  bool changed[NUM_CHANNELS];
+  bool any_changed = false;
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    changed[i] = s_inputs[i] != s_notified_values[i];
+    any_changed |= changed[i];
+  }
+  if (!any_changed) {
+    return;
+  }
+
+  memcpy(s_notified_values, s_inputs, NUM_CHANNELS);
+  s_notified_ms = now_ms;
+  s_sequence++;
+  if (!s_options.basic) {
+    prv_notify(ALL_INPUTS_ATTRIBUTE_ID);
+    return;
+  }
+  for (int i = 0; i < NUM_CHANNELS; i++) {
+    if (changed[i]) {
+      prv_notify(INPUT_IDS[i]);
+    }
+  }
+}
+
+static void prv_receive(StrapWireDecoder *decoder) {
+  uint8_t bytes[256];
+  ssize_t count;
+  while ((count = read(s_master, bytes, sizeof(bytes))) > 0) {
+    for (ssize_t i = 0; i < count; i++) {
+      StrapWireFrame frame;
+      if (strap_wire_decode(decoder, bytes[i], &frame)) {
+        prv_handle_request(&frame);
+      }
+    }
+  }
+}
+
+/****** Setup ******/
+
+static bool prv_parse_wave(const char *arg) {
+  static const char *SHAPES[] = { "const", "square", "sine", "saw", "triangle", "noise" };
+  int channel;
+  char shape[16];
+  unsigned period = 1000;
+  unsigned low = 0;
+  unsigned high = 255;
+  const int fields = sscanf(arg, "%d=%15[a-z],%u,%u,%u", &channel, shape, &period, &low, &high);
+  if (fields < 2 || channel < 0 || channel >= NUM_CHANNELS || low > 255 || high > 255) {
+    return false;
+  }
+  // A constant takes its value from the first number
+  if (fields >= 3 && strcmp(shape, "const") == 0) {
+    low = period;
+  }
+  for (size_t i = 0; i < sizeof(SHAPES) / sizeof(SHAPES[0]); i++) {
+    if (strcmp(shape, SHAPES[i]) == 0) {
+      s_waves[channel] = (Wave) { .shape = i, .period_ms = period, .low = low, .high = high };
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool prv_load_script(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), file) && s_num_script_steps < MAX_SCRIPT_STEPS) {
+    unsigned at_ms;
+    int channel;
+    unsigned value;
+    if (line[0] == '#' || sscanf(line, "%u %d %u", &at_ms, &channel, &value) != 3) {
+      continue;
+    }
+    if (channel < 0 || channel >= NUM_CHANNELS || value > 255 ||
+        (s_num_script_steps && at_ms < s_script[s_num_script_steps - 1].at_ms)) {
+      fprintf(stderr, "%s: bad step %s", path, line);
+      fclose(file);
+      return false;
+    }
+    s_script[s_num_script_steps++] = (ScriptStep) { at_ms, channel, value };
+  }
+  fclose(file);
+  return true;
+}
+
+static bool prv_open_pty(void) {
+  s_master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (s_master < 0 || grantpt(s_master) < 0 || unlockpt(s_master) < 0) {
+    perror("posix_openpt");
+    return false;
+  }
+  const char *slave_path = ptsname(s_master);
+
+  // Raw mode, and the slave stays open here so the master does not hang up between clients
+  const int slave = open(slave_path, O_RDWR | O_NOCTTY);
+  struct termios termios;
+  if (slave < 0 || tcgetattr(slave, &termios) < 0) {
+    perror(slave_path);
+    return false;
+  }
+  cfmakeraw(&termios);
+  tcsetattr(slave, TCSANOW, &termios);
+  fcntl(s_master, F_SETFL, fcntl(s_master, F_GETFL) | O_NONBLOCK);
+
+  if (s_options.link) {
+    unlink(s_options.link);
+    if (symlink(slave_path, s_options.link) < 0) {
+      perror(s_options.link);
+      return false;
+    }
+  }
+  printf("%s\n", slave_path);
+  fflush(stdout);
+  return true;
+}
+
+static void prv_print_stats(void) {
+  fprintf(stderr,
+          "{\"reads\":%u,\"writes\":%u,\"notifies\":%u,\"injected_busy\":%u,\"dropped\":%u,"
+          "\"bad_frames\":%u,\"output_updates\":[%u,%u,%u],\"outputs\":[%u,%u,%u]}\n",
+          s_stats.reads, s_stats.writes, s_stats.notifies, s_stats.injected_busy, s_stats.dropped,
+          s_stats.bad_frames,
+          s_stats.output_updates[0], s_stats.output_updates[1], s_stats.output_updates[2],
+          s_outputs[0], s_outputs[1], s_outputs[2]);
+}
+
+static void prv_usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -l, --link PATH       symlink the pty to PATH, its name is printed either way\n"
+          "  -w, --wave CH=SHAPE[,PERIOD_MS[,LOW[,HIGH]]]\n"
+          "                        input waveform: const, square, sine, saw, triangle, noise;\n"
+          "                        const takes its value from the first number\n"
+          "  -s, --script FILE     input steps, one \"<ms> <channel> <value>\" per line\n"
+          "  -d, --delay MS        bus delay before each response (default 0)\n"
+          "  -j, --jitter MS       random extra delay up to MS\n"
+          "  -b, --busy PCT        answer PCT%% of requests with SmartstrapResultBusy\n"
+          "  -t, --drop PCT        leave PCT%% of requests unanswered, the watch times out\n"
+          "  -n, --notify-ms MS    minimum interval between notifies (default 20)\n"
+          "  -p, --loop-ms MS      input sampling period (default 1)\n"
+          "  -B, --basic           only serve attributes 0x0001-0x0006, as older firmware\n"
+          "  -D, --duration S      exit after S seconds\n"
+          "  -S, --seed N          seed for jitter, noise and injected errors\n",
+          name);
+}
+
+static void prv_handle_signal(int signal) {
+  s_quit = 1;
+}
+
+int main(int argc, char **argv) {
+  static const struct option OPTIONS[] = {
+    { "link", required_argument, NULL, 'l' },
+    { "wave", required_argument, NULL, 'w' },
+    { "script", required_argument, NULL, 's' },
+    { "delay", required_argument, NULL, 'd' },
+    { "jitter", required_argument, NULL, 'j' },
+    { "busy", required_argument, NULL, 'b' },
+    { "drop", required_argument, NULL, 't' },
+    { "notify-ms", required_argument, NULL, 'n' },
+    { "loop-ms", required_argument, NULL, 'p' },
+    { "basic", no_argument, NULL, 'B' },
+    { "duration", required_argument, NULL, 'D' },
+    { "seed", required_argument, NULL, 'S' },
+    { NULL, 0, NULL, 0 },
+  };
+
+  srand(1);
+  int option;
+  while ((option = getopt_long(argc, argv, "l:w:s:d:j:b:t:n:p:BD:S:", OPTIONS, NULL)) != -1) {
+    switch (option) {
+      case 'l': s_options.link = optarg; break;
+      case 'w':
+        if (!prv_parse_wave(optarg)) {
+          fprintf(stderr, "bad wave %s\n", optarg);
+          return 2;
+        }
+        break;
+      case 's':
+        if (!prv_load_script(optarg)) {
+          return 2;
+        }
+        break;
+      case 'd': s_options.delay_ms = strtoul(optarg, NULL, 10); break;
+      case 'j': s_options.jitter_ms = strtoul(optarg, NULL, 10); break;
+      case 'b': s_options.busy_percent = strtoul(optarg, NULL, 10); break;
+      case 't': s_options.drop_percent = strtoul(optarg, NULL, 10); break;
+      case 'n': s_options.notify_ms = strtoul(optarg, NULL, 10); break;
+      case 'p': s_options.loop_ms = strtoul(optarg, NULL, 10); break;
+      case 'B': s_options.basic = true; break;
+      case 'D': s_options.duration_s = strtoul(optarg, NULL, 10); break;
+      case 'S': srand(strtoul(optarg, NULL, 10)); break;
+      default:
+        prv_usage(argv[0]);
+        return 2;
+    }
+  }
+  if (!s_options.loop_ms) {
+    s_options.loop_ms = 1;
+  }
+
+  s_start_ms = 0;
+  s_start_ms = prv_now_ms();
+  if (!prv_open_pty()) {
+    return 1;
+  }
+  signal(SIGINT, prv_handle_signal);
+  signal(SIGTERM, prv_handle_signal);
+
+  StrapWireDecoder decoder = { 0 };
+  uint64_t next_loop_ms = 0;
+  while (!s_quit) {
+    uint64_t now_ms = prv_now_ms();
+    if (s_options.duration_s && now_ms >= s_options.duration_s * 1000ull) {
+      break;
+    }
+    if (now_ms >= next_loop_ms) {
+      prv_loop(now_ms);
+      next_loop_ms = now_ms + s_options.loop_ms;
+    }
+    prv_flush_queue(now_ms);
+
+    uint64_t wake_ms = next_loop_ms;
+    if (s_queue_length && s_queue[0].due_ms < wake_ms) {
+      wake_ms = s_queue[0].due_ms;
+    }
+    struct pollfd pfd = { .fd = s_master, .events = POLLIN };
+    const int timeout = wake_ms > now_ms ? (int)(wake_ms - now_ms) : 0;
+    if (poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN)) {
+      prv_receive(&decoder);
+    }
+  }
+
+  s_stats.bad_frames = decoder.bad_frames;
+  prv_print_stats();
+  if (s_options.link) {
+    unlink(s_options.link);
+  }
+  return 0;
+}
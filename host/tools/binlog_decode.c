@@ -0,0 +1,166 @@
+// Turns binary log records back into messages: the "BLG" lines the watchapp writes to its app log
+// (src/log/binlog.h, as captured by `pebble logs` or the host build's stderr), or with -a the raw
+// records the Arduino sketch writes to its USB serial port.
+//
+//   binlog_decode [-a] [LOG]
+//   LOG defaults to stdin.
+
+#include <pebble.h>
+#include <unistd.h>
+#include "binlog.h"
+#include "strap_names.h"
+#include "../../arduino/smartstrap/log_events.h"
+
+#define BINLOG_EVENT(id, format) format,
+static const char *WATCH_FORMATS[] = { BINLOG_EVENTS };
+#undef BINLOG_EVENT
+
+#define STRAP_LOG_EVENT(id, format) format,
+static const char *STRAP_FORMATS[] = { STRAP_LOG_EVENTS };
+#undef STRAP_LOG_EVENT
+
+static const char *prv_level_name(int level) {
+  switch (level) {
+    case BINLOG_LEVEL_ERROR:   return "E";
+    case BINLOG_LEVEL_WARNING: return "W";
+    case BINLOG_LEVEL_INFO:    return "I";
+    default:                   return "D";
+  }
+}
+
+// Prints a message, filling in the format's conversions with the arguments in order
+static void prv_print_message(const char *format, const int32_t *args, int num_args) {
+  int arg = 0;
+  for (const char *c = format; *c; c++) {
+    if (*c != '%' || !c[1]) {
+      putchar(*c);
+      continue;
+    }
+    c++;
+    const int32_t value = arg < num_args ? args[arg] : 0;
+    switch (*c) {
+      case 'd': printf("%d", value); arg++; break;
+      case 'x': printf("0x%x", value); arg++; break;
+      case 'r': printf("%s", strap_result_name(value)); arg++; break;
+      case 'a': printf("%s", strap_attribute_name(value)); arg++; break;
+      default: putchar(*c); break;
+    }
+  }
+  putchar('\n');
+}
+
+static void prv_print_record(uint32_t time_ms, const char *level, const char **formats,
+                             size_t num_formats, unsigned event, const int32_t *args, int num_args) {
+  printf("%9.3fs %s ", time_ms / 1000.0, level);
+  if (event < num_formats) {
+    prv_print_message(formats[event], args, num_args);
+  } else {
+    printf("unknown event %u (%d %d)\n", event, args[0], args[1]);
+  }
+}
+
+/****** Watch ******/
+
+static int prv_hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+static void prv_decode_watch(FILE *file) {
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    const char *hex = strstr(line, "BLG ");
+    if (!hex) {
+      continue;
+    }
+    hex += 4;
+
+    uint8_t record[BINLOG_RECORD_LENGTH];
+    size_t length = 0;
+    for (; prv_hex_value(hex[0]) >= 0 && prv_hex_value(hex[1]) >= 0; hex += 2) {
+      record[length++] = (uint8_t)(prv_hex_value(hex[0]) << 4 | prv_hex_value(hex[1]));
+      if (length < BINLOG_RECORD_LENGTH) {
+        continue;
+      }
+      length = 0;
+      const uint32_t time_ms = record[0] | (record[1] << 8) | (record[2] << 16) |
+                               ((uint32_t)record[3] << 24);
+      const int32_t args[3] = {
+        (int16_t)(record[6] | (record[7] << 8)),
+        (int16_t)(record[8] | (record[9] << 8)),
+        (int16_t)(record[10] | (record[11] << 8)),
+      };
+      prv_print_record(time_ms, prv_level_name(record[5]), WATCH_FORMATS, ARRAY_LENGTH(WATCH_FORMATS),
+                       record[4], args, 3);
+    }
+    if (length) {
+      fprintf(stderr, "warning: line ends in a partial record\n");
+    }
+  }
+}
+
+/****** Arduino ******/
+
+static void prv_decode_strap(FILE *file) {
+  uint8_t record[STRAP_LOG_RECORD_LENGTH];
+  size_t length = 0;
+  // millis() wraps every 65.536 s in the records; assumes no gap that long between two of them
+  uint32_t time_ms = 0;
+  bool has_time = false;
+  uint32_t skipped = 0;
+
+  int c;
+  while ((c = fgetc(file)) != EOF) {
+    if (length == 0 && c != STRAP_LOG_SYNC) {
+      skipped++;
+      continue;
+    }
+    record[length++] = (uint8_t)c;
+    if (length < STRAP_LOG_RECORD_LENGTH) {
+      continue;
+    }
+    length = 0;
+
+    const uint16_t millis = record[2] | (record[3] << 8);
+    time_ms = has_time ? time_ms + (uint16_t)(millis - (uint16_t)time_ms) : millis;
+    has_time = true;
+    const int32_t args[2] = { record[4] | (record[5] << 8), record[6] | (record[7] << 8) };
+    prv_print_record(time_ms, "-", STRAP_FORMATS, ARRAY_LENGTH(STRAP_FORMATS), record[1], args, 2);
+  }
+  if (skipped) {
+    fprintf(stderr, "warning: skipped %u bytes out of sync\n", skipped);
+  }
+}
+
+int main(int argc, char **argv) {
+  bool strap = false;
+  int option;
+  while ((option = getopt(argc, argv, "a")) != -1) {
+    switch (option) {
+      case 'a': strap = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-a] [LOG]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  FILE *file = optind < argc ? fopen(argv[optind], strap ? "rb" : "r") : stdin;
+  if (!file) {
+    perror(argv[optind]);
+    return 1;
+  }
+  if (strap) {
+    prv_decode_strap(file);
+  } else {
+    prv_decode_watch(file);
+  }
+  if (file != stdin) {
+    fclose(file);
+  }
+  return 0;
+}
@@ -0,0 +1,27 @@
+#include "strap_names.h"
+#include "strap_protocol.h"
+
+const char *strap_attribute_name(uint16_t attribute_id) {
+  switch (attribute_id) {
+    case STRAP_TOP_INPUT_ATTRIBUTE_ID:      return "top in";
+    case STRAP_TOP_OUTPUT_ATTRIBUTE_ID:     return "top out";
+    case STRAP_CENTER_INPUT_ATTRIBUTE_ID:   return "center in";
+    case STRAP_CENTER_OUTPUT_ATTRIBUTE_ID:  return "center out";
+    case STRAP_BOTTOM_INPUT_ATTRIBUTE_ID:   return "bottom in";
+    case STRAP_BOTTOM_OUTPUT_ATTRIBUTE_ID:  return "bottom out";
+    case STRAP_ALL_INPUTS_ATTRIBUTE_ID:     return "all in";
+    case STRAP_ALL_OUTPUTS_ATTRIBUTE_ID:    return "all out";
+    case STRAP_STREAM_ATTRIBUTE_ID:         return "stream";
+    case STRAP_STREAM_CONFIG_ATTRIBUTE_ID:  return "stream cfg";
+    case STRAP_NOTIFY_CONFIG_ATTRIBUTE_ID:  return "notify cfg";
+    case STRAP_LOCAL_ROUTES_ATTRIBUTE_ID:   return "local routes";
+    default:                                return "?";
+  }
+}
+
+const char *strap_result_name(int result) {
+  static const char *NAMES[] = {
+    "Ok", "InvalidArgs", "NotPresent", "Busy", "ServiceUnavailable", "AttributeUnsupported", "TimeOut",
+  };
+  return result >= 0 && result < (int)ARRAY_LENGTH(NAMES) ? NAMES[result] : "?";
+}
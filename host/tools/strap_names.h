@@ -0,0 +1,8 @@
+#pragma once
+
+#include <pebble.h>
+
+// Names of strap protocol values, for the log decoders
+
+const char *strap_attribute_name(uint16_t attribute_id);
+const char *strap_result_name(int result);
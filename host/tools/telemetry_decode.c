@@ -0,0 +1,271 @@
+// Turns a telemetry dump logged by the watchapp (the "TLM" lines written by telemetry_log_dump(),
+// as captured by `pebble logs` or the host build's stderr) into a timeline of strap traffic and
+// latency histograms.
+//
+//   telemetry_decode [-t | -H] [LOG]
+//     -t  timeline only
+//     -H  histograms only
+//   LOG defaults to stdin.
+
+#include <pebble.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "strap_protocol.h"
+#include "strap_names.h"
+#include "telemetry.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+
+#define NUM_ATTRIBUTES 16
+// Bucket n holds latencies in [2^(n-1), 2^n) milliseconds, bucket 0 holds 0 ms
+#define NUM_BUCKETS 13
+
+typedef struct {
+  uint32_t time_ms;
+  uint8_t type;
+  uint8_t attribute_id;
+  uint8_t result;
+  uint8_t value;
+} Event;
+
+typedef struct {
+  const char *name;
+  uint32_t buckets[NUM_BUCKETS];
+  uint32_t count;
+  uint64_t total_ms;
+  uint32_t max_ms;
+} Histogram;
+
+static uint8_t s_dump[TELEMETRY_DUMP_LENGTH];
+static size_t s_dump_length;
+static bool s_dump_gap;
+
+static Histogram s_notify_to_read = { .name = "notify -> read done" };
+static Histogram s_read = { .name = "read begin -> done" };
+static Histogram s_write = { .name = "write begin -> ACK" };
+
+static const char *prv_type_name(uint8_t type) {
+  switch (type) {
+    case TelemetryEventNotify:     return "notify";
+    case TelemetryEventReadBegin:  return "read";
+    case TelemetryEventReadEnd:    return "read done";
+    case TelemetryEventWriteBegin: return "write";
+    case TelemetryEventWriteEnd:   return "write ACK";
+    case TelemetryEventBusy:       return "refused";
+    case TelemetryEventRetry:      return "retry";
+    default:                       return "?";
+  }
+}
+
+static uint32_t prv_read_uint32(const uint8_t *data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/****** Input ******/
+
+static int prv_hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+// Collects the bytes of every "TLM <offset> <hex>" line; a later dump in the same log replaces an
+// earlier one
+static void prv_read_log(FILE *file) {
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    const char *tag = strstr(line, "TLM ");
+    unsigned offset;
+    char hex[256];
+    if (!tag || sscanf(tag, "TLM %x %255s", &offset, hex) != 2) {
+      continue;
+    }
+    if (offset == 0) {
+      s_dump_length = 0;
+      s_dump_gap = false;
+    } else if (offset != s_dump_length) {
+      s_dump_gap = true;
+    }
+    for (size_t i = 0; hex[i] && hex[i + 1] && offset < sizeof(s_dump); i += 2, offset++) {
+      const int high = prv_hex_value(hex[i]);
+      const int low = prv_hex_value(hex[i + 1]);
+      if (high < 0 || low < 0) {
+        break;
+      }
+      s_dump[offset] = (uint8_t)(high << 4 | low);
+    }
+    if (offset > s_dump_length) {
+      s_dump_length = offset;
+    }
+  }
+}
+
+/****** Histograms ******/
+
+static void prv_add(Histogram *histogram, uint32_t latency_ms) {
+  int bucket = 0;
+  while (bucket < NUM_BUCKETS - 1 && latency_ms >= (1u << bucket)) {
+    bucket++;
+  }
+  histogram->buckets[bucket]++;
+  histogram->count++;
+  histogram->total_ms += latency_ms;
+  if (latency_ms > histogram->max_ms) {
+    histogram->max_ms = latency_ms;
+  }
+}
+
+static void prv_print_histogram(const Histogram *histogram) {
+  printf("\n%s: %u samples", histogram->name, histogram->count);
+  if (!histogram->count) {
+    printf("\n");
+    return;
+  }
+  printf(", mean %.1f ms, max %u ms\n", (double)histogram->total_ms / histogram->count, histogram->max_ms);
+
+  uint32_t peak = 0;
+  for (int b = 0; b < NUM_BUCKETS; b++) {
+    peak = MAX(peak, histogram->buckets[b]);
+  }
+  for (int b = 0; b < NUM_BUCKETS; b++) {
+    if (!histogram->buckets[b]) {
+      continue;
+    }
+    char range[24];
+    if (b == 0) {
+      snprintf(range, sizeof(range), "0");
+    } else if (b == NUM_BUCKETS - 1) {
+      snprintf(range, sizeof(range), ">= %u", 1u << (b - 1));
+    } else {
+      snprintf(range, sizeof(range), "%u-%u", 1u << (b - 1), (1u << b) - 1);
+    }
+    const int width = (int)(40.0 * histogram->buckets[b] / peak + 0.5);
+    printf("  %10s ms %6u %.*s\n", range, histogram->buckets[b], width,
+           "########################################");
+  }
+}
+
+/****** Decoding ******/
+
+static bool prv_decode(bool timeline, bool histograms) {
+  if (s_dump_length < TELEMETRY_HEADER_LENGTH || prv_read_uint32(s_dump) != TELEMETRY_MAGIC) {
+    fprintf(stderr, "no telemetry dump found\n");
+    return false;
+  }
+  if (s_dump[4] != TELEMETRY_VERSION || s_dump[5] != TELEMETRY_EVENT_LENGTH) {
+    fprintf(stderr, "unsupported dump version %u\n", s_dump[4]);
+    return false;
+  }
+  if (s_dump_gap) {
+    fprintf(stderr, "warning: lines missing from the log, some events are garbage\n");
+  }
+
+  const size_t num_events = MIN((size_t)(s_dump[6] | (s_dump[7] << 8)),
+                                (s_dump_length - TELEMETRY_HEADER_LENGTH) / TELEMETRY_EVENT_LENGTH);
+  const uint32_t lost = prv_read_uint32(&s_dump[8]);
+  const uint32_t dump_ms = prv_read_uint32(&s_dump[12]);
+  printf("%zu events, %u older ones overwritten, dumped at %u ms\n", num_events, lost, dump_ms);
+
+  // Start times of the transfer in flight and of the oldest unanswered notify, per attribute
+  uint32_t read_begin[NUM_ATTRIBUTES] = { 0 };
+  uint32_t write_begin[NUM_ATTRIBUTES] = { 0 };
+  uint32_t notified[NUM_ATTRIBUTES] = { 0 };
+  bool reading[NUM_ATTRIBUTES] = { false };
+  bool writing[NUM_ATTRIBUTES] = { false };
+  bool has_notify[NUM_ATTRIBUTES] = { false };
+
+  uint32_t first_ms = 0;
+  for (size_t i = 0; i < num_events; i++) {
+    const uint8_t *data = &s_dump[TELEMETRY_HEADER_LENGTH + i * TELEMETRY_EVENT_LENGTH];
+    const Event event = { prv_read_uint32(data), data[4], data[5], data[6], data[7] };
+    if (i == 0) {
+      first_ms = event.time_ms;
+    }
+
+    if (timeline) {
+      printf("%+9.3fs  %-9s %-10s", (event.time_ms - first_ms) / 1000.0, prv_type_name(event.type),
+             strap_attribute_name(event.attribute_id));
+      if (event.type == TelemetryEventReadEnd || event.type == TelemetryEventWriteEnd ||
+          event.type == TelemetryEventBusy || event.type == TelemetryEventRetry) {
+        printf("  %s", strap_result_name(event.result));
+      }
+      if (event.type == TelemetryEventWriteBegin ||
+          (event.type == TelemetryEventReadEnd && event.result == SmartstrapResultOk)) {
+        printf("  value %u", event.value);
+      }
+      printf("\n");
+    }
+
+    const uint8_t id = event.attribute_id % NUM_ATTRIBUTES;
+    switch (event.type) {
+      case TelemetryEventNotify:
+        if (!has_notify[id]) {
+          has_notify[id] = true;
+          notified[id] = event.time_ms;
+        }
+        break;
+      case TelemetryEventReadBegin:
+        reading[id] = true;
+        read_begin[id] = event.time_ms;
+        break;
+      case TelemetryEventReadEnd:
+        if (reading[id]) {
+          prv_add(&s_read, event.time_ms - read_begin[id]);
+        }
+        if (has_notify[id] && event.result == SmartstrapResultOk) {
+          prv_add(&s_notify_to_read, event.time_ms - notified[id]);
+          has_notify[id] = false;
+        }
+        reading[id] = false;
+        break;
+      case TelemetryEventWriteBegin:
+        writing[id] = true;
+        write_begin[id] = event.time_ms;
+        break;
+      case TelemetryEventWriteEnd:
+        if (writing[id]) {
+          prv_add(&s_write, event.time_ms - write_begin[id]);
+        }
+        writing[id] = false;
+        break;
+    }
+  }
+
+  if (histograms) {
+    prv_print_histogram(&s_notify_to_read);
+    prv_print_histogram(&s_read);
+    prv_print_histogram(&s_write);
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool timeline = true;
+  bool histograms = true;
+  int option;
+  while ((option = getopt(argc, argv, "tH")) != -1) {
+    switch (option) {
+      case 't': histograms = false; break;
+      case 'H': timeline = false; break;
+      default:
+        fprintf(stderr, "usage: %s [-t | -H] [LOG]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  FILE *file = optind < argc ? fopen(argv[optind], "r") : stdin;
+  if (!file) {
+    perror(argv[optind]);
+    return 1;
+  }
+  prv_read_log(file);
+  if (file != stdin) {
+    fclose(file);
+  }
+  return prv_decode(timeline, histograms) ? 0 : 1;
+}
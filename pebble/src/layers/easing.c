@@ -0,0 +1,51 @@
+#include "easing.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+// Each table samples its curve at 64 even steps of progress, plus the end point; progress in
+// between is interpolated
+#define TABLE_STEP_SHIFT 10
+#define TABLE_STEP_MASK ((1 << TABLE_STEP_SHIFT) - 1)
+
+// x^2
+static const uint16_t s_ease_in[] = {
+  0, 0, 0, 1, 1, 2, 2, 3, 4, 5, 6, 8, 9, 11, 12, 14, 16, 18, 20, 23, 25, 28, 30, 33, 36, 39, 42,
+  46, 49, 53, 56, 60, 64, 68, 72, 77, 81, 86, 90, 95, 100, 105, 110, 116, 121, 127, 132, 138, 144,
+  150, 156, 163, 169, 176, 182, 189, 196, 203, 210, 218, 225, 233, 240, 248, 256
+};
+
+// 1 - (1 - x)^2
+static const uint16_t s_ease_out[] = {
+  0, 8, 16, 23, 31, 38, 46, 53, 60, 67, 74, 80, 87, 93, 100, 106, 112, 118, 124, 129, 135, 140,
+  146, 151, 156, 161, 166, 170, 175, 179, 184, 188, 192, 196, 200, 203, 207, 210, 214, 217, 220,
+  223, 226, 228, 231, 233, 236, 238, 240, 242, 244, 245, 247, 248, 250, 251, 252, 253, 254, 254,
+  255, 255, 256, 256, 256
+};
+
+int32_t easing_get(Easing easing, AnimationProgress progress) {
+  if (progress <= ANIMATION_NORMALIZED_MIN) {
+    return 0;
+  } else if (progress >= ANIMATION_NORMALIZED_MAX) {
+    return EASING_ONE;
+  }
+
+  const uint16_t *table;
+  switch (easing) {
+    case EasingIn:  table = s_ease_in; break;
+    case EasingOut: table = s_ease_out; break;
+    default:        return progress >> (16 - EASING_SHIFT);
+  }
+  const int step = progress >> TABLE_STEP_SHIFT;
+  const int32_t between = progress & TABLE_STEP_MASK;
+  return table[step] + (((table[step + 1] - table[step]) * between) >> TABLE_STEP_SHIFT);
+}
+
+int32_t easing_get_part(Easing easing, const EasingPart *part, AnimationProgress progress) {
+  if (progress <= part->start) {
+    return 0;
+  } else if (progress >= part->end) {
+    return EASING_ONE;
+  }
+  const uint32_t part_progress = ((uint32_t)(progress - part->start) * part->scale) >> 8;
+  return easing_get(easing, MIN(part_progress, (uint32_t)ANIMATION_NORMALIZED_MAX));
+}
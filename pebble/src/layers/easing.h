@@ -0,0 +1,51 @@
+#pragma once
+
+#include <pebble.h>
+
+// Eased fractions are fixed point, EASING_ONE standing for the whole distance
+#define EASING_SHIFT 8
+#define EASING_ONE (1 << EASING_SHIFT)
+
+// EasingIn and EasingOut are plain quadratics, x^2 and 1 - (1 - x)^2. They are not the curves of
+// the SDK's AnimationCurveEaseIn and AnimationCurveEaseOut, so animations moved over from those
+// accelerate and settle differently than they did
+typedef enum {
+  EasingLinear = 0,
+  EasingIn,
+  EasingOut,
+} Easing;
+
+// The part of an animation that runs from start_ms to end_ms of its total_ms. Build it with
+// EASING_PART() so that the scale is worked out by the compiler
+typedef struct EasingPart {
+  AnimationProgress start;
+  AnimationProgress end;
+  // Total duration over the part's duration, in 24.8 fixed point
+  uint32_t scale;
+} EasingPart;
+
+#define EASING_PART(start_ms, end_ms, total_ms) { \
+  .start = (AnimationProgress)((int64_t)ANIMATION_NORMALIZED_MAX * (start_ms) / (total_ms)), \
+  .end = (AnimationProgress)((int64_t)ANIMATION_NORMALIZED_MAX * (end_ms) / (total_ms)), \
+  .scale = ((uint32_t)(total_ms) << 8) / ((end_ms) - (start_ms)), \
+}
+
+/*
+ * Looks up how far along its curve an animation is. The curves are tables, so this costs a few
+ * shifts and one multiply whatever the curve
+ *  progress: as passed to an AnimationImplementation's update, which should run with
+ *            AnimationCurveLinear
+ *  returns: a fraction from 0 to EASING_ONE
+ */
+int32_t easing_get(Easing easing, AnimationProgress progress);
+
+/*
+ * Same as easing_get(), for one part of an animation running several one after the other
+ *  returns: 0 before the part and EASING_ONE after it
+ */
+int32_t easing_get_part(Easing easing, const EasingPart *part, AnimationProgress progress);
+
+// The value fraction of the way from from to to
+static inline int easing_interpolate(int from, int to, int32_t fraction) {
+  return from + (((to - from) * fraction) >> EASING_SHIFT);
+}
@@ -2,16 +2,21 @@
 
 #include <pebble.h>
 #include "selection_layer.h"
+#include "easing.h"
 
 // Look and feel
 #define DEFAULT_CELL_PADDING 10
 #define DEFAULT_SELECTED_INDEX 0
+#define NO_SELECTED_CELL -1
 #define DEFAULT_FONT FONT_KEY_GOTHIC_28_BOLD
 #ifdef PBL_COLOR
 #define DEFAULT_ACTIVE_COLOR GColorWhite
 #define DEFAULT_INACTIVE_COLOR GColorDarkGray
 #endif
 
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+
 #define BUTTON_HOLD_REPEAT_MS 100
 #define SETTLE_HEIGHT_DIFF 6
 
@@ -20,114 +25,178 @@
 #define BUMP_SETTLE_DURATION_MS 214
 #define SLIDE_DURATION_MS 107
 #define SLIDE_SETTLE_DURATION_MS 179
-
-// Function prototypes
-static Animation* prv_create_bump_settle_animation(Layer *layer);
-static Animation* prv_create_slide_settle_animation(Layer *layer);
-
-static int prv_get_pixels_for_bump_settle(int anim_percent_complete) {
-  if (anim_percent_complete) {
-    return SETTLE_HEIGHT_DIFF - ((SETTLE_HEIGHT_DIFF * anim_percent_complete) / 100);
+#define BUMP_DURATION_MS (BUMP_TEXT_DURATION_MS + BUMP_SETTLE_DURATION_MS)
+#define SLIDE_TOTAL_DURATION_MS (SLIDE_DURATION_MS + SLIDE_SETTLE_DURATION_MS)
+
+static const EasingPart s_bump_text_part = EASING_PART(0, BUMP_TEXT_DURATION_MS, BUMP_DURATION_MS);
+static const EasingPart s_bump_settle_part =
+    EASING_PART(BUMP_TEXT_DURATION_MS, BUMP_DURATION_MS, BUMP_DURATION_MS);
+static const EasingPart s_slide_part = EASING_PART(0, SLIDE_DURATION_MS, SLIDE_TOTAL_DURATION_MS);
+static const EasingPart s_slide_settle_part =
+    EASING_PART(SLIDE_DURATION_MS, SLIDE_TOTAL_DURATION_MS, SLIDE_TOTAL_DURATION_MS);
+
+static int prv_get_pixels_for_bump_settle(int32_t settle_progress) {
+  if (settle_progress) {
+    return easing_interpolate(SETTLE_HEIGHT_DIFF, 0, settle_progress);
   } else {
     return 0;
   }
 }
 
-static int prv_get_font_top_padding(GFont font) {
-  if (font == fonts_get_system_font(FONT_KEY_GOTHIC_28_BOLD)) {
-    return 10;
-  } else if (font == fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD)) {
-    return 10;
-  } else {
-    return 0;
-  }
+// Measures the font once, so that drawing needs no font lookups. The digits are centered by
+// centering the box the SDK measures for them, and bumped a third of its height
+static void prv_update_font_metrics(SelectionLayerData *data) {
+  const GSize size = graphics_text_layout_get_content_size("0", data->font, GRect(0, 0, 1000, 1000),
+                                                           GTextOverflowModeFill, GTextAlignmentLeft);
+  data->font_center_offset = size.h >> 1;
+  data->font_bump_distance = size.h / 3;
 }
 
-static int prv_get_y_offset_which_vertically_centers_font(GFont font, int height) {
-  int font_height = 0;
-  int font_top_padding = prv_get_font_top_padding(font);
-  if (font == fonts_get_system_font(FONT_KEY_GOTHIC_28_BOLD)) {
-    font_height = 18;
-  } else if (font == fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD)) {
-    font_height = 14;
+// Left edge of the viewport, following the running slide
+static int prv_get_scroll_x(SelectionLayerData *data) {
+  if (!data->slide_amin_progress) {
+    return data->scroll_x;
   }
-
-  return (height / 2) - (font_height / 2) - font_top_padding;
+  return easing_interpolate(data->scroll_x, data->slide_scroll_x, data->slide_amin_progress);
 }
 
-static void prv_draw_cell_backgrounds(Layer *layer, GContext *ctx) {
-  SelectionLayerData *data = layer_get_data(layer);
-  // Loop over each cell and draw the background rectangles
-  for (int i = 0, current_x_offset = 0; i < data->num_cells; i++) {
-    if (data->cell_widths[i] == 0) {
-      continue;
-    }
+// Position of a cell in the layer's bounds
+static int prv_get_cell_x_offset(SelectionLayerData *data, int idx) {
+  return data->cells[idx].x_offset - prv_get_scroll_x(data);
+}
 
-    int y_offset = 0;
-    if (data->selected_cell_idx == i && data->bump_is_upwards) {
-      y_offset = -prv_get_pixels_for_bump_settle(data->bump_settle_anim_progress);
+// First cell reaching into a viewport starting at scroll_x
+static int prv_get_first_visible_cell(SelectionLayerData *data, int scroll_x) {
+  int low = 0;
+  int high = data->num_cells - 1;
+  while (low < high) {
+    const int mid = (low + high) >> 1;
+    if (data->cells[mid].x_offset + data->cells[mid].width + data->cell_padding <= scroll_x) {
+      low = mid + 1;
+    } else {
+      high = mid;
     }
+  }
+  return low;
+}
 
-    int height = layer_get_bounds(layer).size.h;
-    if (data->selected_cell_idx == i) {
-      height += prv_get_pixels_for_bump_settle(data->bump_settle_anim_progress);
-    }
+// Viewport position that brings a cell fully into view, moving as little as possible
+static int prv_get_scroll_x_for_cell(Layer *layer, int idx) {
+  SelectionLayerData *data = layer_get_data(layer);
+  const SelectionLayerCell *cell = &data->cells[idx];
+  const int width = layer_get_bounds(layer).size.w;
 
-    const GRect rect = GRect(current_x_offset, y_offset, data->cell_widths[i], height);
+  if (cell->x_offset < data->scroll_x) {
+    return cell->x_offset;
+  } else if (cell->x_offset + cell->width > data->scroll_x + width) {
+    return cell->x_offset + cell->width - width;
+  }
+  return data->scroll_x;
+}
 
-#ifdef PBL_SDK_3
-    GColor bg_color = data->inactive_background_color;
+static void prv_update_cell_offsets(Layer *layer) {
+  SelectionLayerData *data = layer_get_data(layer);
+  int x_offset = 0;
+  for (int i = 0; i < data->num_cells; i++) {
+    data->cells[i].x_offset = x_offset;
+    x_offset += data->cells[i].width + data->cell_padding;
+  }
 
-    if (data->selected_cell_idx == i && !data->slide_amin_progress) {
-      bg_color = data->active_background_color;
-    }
-    graphics_context_set_fill_color(ctx, bg_color);
-    graphics_fill_rect(ctx, rect, 1, GCornerNone);
-#elif PBL_SDK_2
-    graphics_context_set_stroke_color(ctx, GColorBlack);
-    graphics_draw_rect(ctx, rect);
+  // Only cells that overflow need clipping, which would otherwise cut the bump animation
+  const int content_width = x_offset - data->cell_padding;
+  const int width = layer_get_bounds(layer).size.w;
+  layer_set_clips(layer, content_width > width);
+  data->scroll_x = MAX(0, MIN(data->scroll_x, content_width - width));
+}
 
-    if (data->selected_cell_idx == i && !data->slide_amin_progress){
-      layer_set_frame(inverter_layer_get_layer(data->inverter), rect);
-    }
+// Drops the cached cells, so the next frame draws them all again
+static void prv_invalidate_cell_cache(SelectionLayerData *data) {
+#ifdef PBL_COLOR
+  data->cell_cache_valid = false;
 #endif
+}
 
-    current_x_offset += data->cell_widths[i] + data->cell_padding;
+static void prv_invalidate_cell_text(SelectionLayerData *data, int idx) {
+  data->cells[idx].text_stale = true;
+  prv_invalidate_cell_cache(data);
+}
+
+static char* prv_get_cell_text(SelectionLayerData *data, int idx) {
+  SelectionLayerCell *cell = &data->cells[idx];
+  if (cell->text_stale) {
+    cell->text = data->callbacks.get_cell_text ? data->callbacks.get_cell_text(idx, data->context) : NULL;
+    cell->text_stale = false;
   }
+  return cell->text;
 }
 
-static void prv_draw_slider_slide(Layer *layer, GContext *ctx) {
+static void prv_draw_cell_background(Layer *layer, GContext *ctx, int idx, int x_offset, bool selected) {
   SelectionLayerData *data = layer_get_data(layer);
-  
-  int starting_x_offset = 0;
-  for (int i = 0; i < data->num_cells; i++) {
-    if (data->selected_cell_idx == i) {
-      break;
-    }
-    starting_x_offset += data->cell_widths[i] + data->cell_padding;
+
+  int y_offset = 0;
+  if (selected && data->bump_is_upwards) {
+    y_offset = -prv_get_pixels_for_bump_settle(data->bump_settle_anim_progress);
   }
 
-  int next_cell_width = data->cell_widths[data->selected_cell_idx + 1];
-  if (!data->slide_is_forward) {
-    next_cell_width = data->cell_widths[data->selected_cell_idx - 1];
+  int height = layer_get_bounds(layer).size.h;
+  if (selected) {
+    height += prv_get_pixels_for_bump_settle(data->bump_settle_anim_progress);
   }
-  
-  int slide_distance = next_cell_width + data->cell_padding;
-  int current_slide_distance = (slide_distance * data->slide_amin_progress) / 100;
-  if (!data->slide_is_forward) {
-    current_slide_distance = -current_slide_distance;
+
+  const GRect rect = GRect(x_offset, y_offset, data->cells[idx].width, height);
+
+#ifdef PBL_SDK_3
+  GColor bg_color = data->inactive_background_color;
+
+  if (selected && !data->slide_is_moving) {
+    bg_color = data->active_background_color;
   }
+  graphics_context_set_fill_color(ctx, bg_color);
+  graphics_fill_rect(ctx, rect, 1, GCornerNone);
+#elif PBL_SDK_2
+  graphics_context_set_stroke_color(ctx, GColorBlack);
+  graphics_draw_rect(ctx, rect);
 
-  int current_x_offset = starting_x_offset + current_slide_distance;
-  int cur_cell_width = data->cell_widths[data->selected_cell_idx];
-  int total_cell_width_change = next_cell_width - cur_cell_width + data->cell_padding;
-  int current_cell_width_change = (total_cell_width_change * (int) data->slide_amin_progress) / 100;
-  int current_cell_width = cur_cell_width + current_cell_width_change;
-  if (!data->slide_is_forward) {
-    current_x_offset -= current_cell_width_change;
+  if (selected && !data->slide_is_moving){
+    layer_set_frame(inverter_layer_get_layer(data->inverter), rect);
   }
+#endif
+}
+
+// Draws the background rectangle of every cell in view, selected_idx being the one that gets selected
+static void prv_draw_cell_backgrounds(Layer *layer, GContext *ctx, int selected_idx) {
+  SelectionLayerData *data = layer_get_data(layer);
+  const int scroll_x = prv_get_scroll_x(data);
+  const int view_end = scroll_x + layer_get_bounds(layer).size.w;
+  for (int i = prv_get_first_visible_cell(data, scroll_x);
+       i < data->num_cells && data->cells[i].x_offset < view_end; i++) {
+    if (data->cells[i].width != 0) {
+      prv_draw_cell_background(layer, ctx, i, data->cells[i].x_offset - scroll_x, i == selected_idx);
+    }
+  }
+}
+
+// Where the selection box is while it slides to the selected cell, in the cells' coordinates. It
+// overshoots the cell by the padding on the far side, which the settle takes back
+static GRect prv_get_slider_rect(SelectionLayerData *data) {
+  const SelectionLayerCell *cell = &data->cells[data->selected_cell_idx];
+  const int to_x = cell->x_offset - (data->slide_is_forward ? 0 : data->cell_padding);
+  const int to_right = to_x + cell->width + data->cell_padding;
+  const int from_right = data->slide_from_x + data->slide_from_width;
+
+  const int x = easing_interpolate(data->slide_from_x, to_x, data->slide_amin_progress);
+  const int right = easing_interpolate(from_right, to_right, data->slide_amin_progress);
+  return GRect(x, 0, right - x, 0);
+}
 
-  GRect rect = GRect(current_x_offset, 0, current_cell_width, layer_get_bounds(layer).size.h);
+// Draws the selection box on its way to the selected cell
+//  returns: the box, in the layer's bounds
+static GRect prv_draw_slider_slide(Layer *layer, GContext *ctx) {
+  SelectionLayerData *data = layer_get_data(layer);
+
+  GRect rect = prv_get_slider_rect(data);
+  rect.origin.x -= prv_get_scroll_x(data);
+  rect.size.h = layer_get_bounds(layer).size.h;
 
 #ifdef PBL_COLOR
   graphics_context_set_fill_color(ctx, data->active_background_color);
@@ -135,24 +204,19 @@ static void prv_draw_slider_slide(Layer *layer, GContext *ctx) {
 #else
   layer_set_frame(inverter_layer_get_layer(data->inverter), rect);
 #endif
+  return rect;
 }
 
 static void prv_draw_slider_settle(Layer *layer, GContext *ctx) {
   SelectionLayerData *data = layer_get_data(layer);
-  int starting_x_offset = 0;
-  for (int i = 0; i < data->num_cells; i++) {
-    if (data->selected_cell_idx == i) {
-      break;
-    }
-    starting_x_offset += data->cell_widths[i] + data->cell_padding;
-  }
+  int starting_x_offset = prv_get_cell_x_offset(data, data->selected_cell_idx);
 
   int x_offset = starting_x_offset;
   if (data->slide_is_forward) {
-    x_offset += data->cell_widths[data->selected_cell_idx];
+    x_offset += data->cells[data->selected_cell_idx].width;
   }
 
-  int current_width = (data->cell_padding * data->slide_settle_anim_progress) / 100;
+  int current_width = easing_interpolate(0, data->cell_padding, data->slide_settle_anim_progress);
   if (!data->slide_is_forward) {
     x_offset -= current_width;
   }
@@ -164,70 +228,183 @@ static void prv_draw_slider_settle(Layer *layer, GContext *ctx) {
   graphics_fill_rect(ctx, rect, 1, GCornerNone);
 #else
   if (data->slide_is_forward) {
-    rect.origin.x -= data->cell_widths[data->selected_cell_idx];
-    rect.size.w += data->cell_widths[data->selected_cell_idx];
+    rect.origin.x -= data->cells[data->selected_cell_idx].width;
+    rect.size.w += data->cells[data->selected_cell_idx].width;
   }
   else
-  rect.size.w += data->cell_widths[data->selected_cell_idx];
+  rect.size.w += data->cells[data->selected_cell_idx].width;
   layer_set_frame(inverter_layer_get_layer(data->inverter), rect);
 #endif
 }
 
-static void prv_draw_text(Layer *layer, GContext *ctx) {
+static void prv_draw_cell_text(Layer *layer, GContext *ctx, int idx, int x_offset, bool selected) {
+  SelectionLayerData *data = layer_get_data(layer);
+  char *text = prv_get_cell_text(data, idx);
+  if (!text) {
+    return;
+  }
+
+  int height = layer_get_bounds(layer).size.h;
+  if (selected) {
+    height += prv_get_pixels_for_bump_settle(data->bump_settle_anim_progress);
+  }
+  int y_offset = (height >> 1) - data->font_center_offset;
+
+  if (selected && data->bump_is_upwards) {
+    y_offset -= prv_get_pixels_for_bump_settle(data->bump_settle_anim_progress);
+  }
+
+  if (selected) {
+    int delta = easing_interpolate(0, data->font_bump_distance, data->bump_text_anim_progress);
+    if (data->bump_is_upwards) {
+      delta *= -1;
+    }
+    y_offset += delta;
+  }
+
+  GRect rect = GRect(x_offset, y_offset, data->cells[idx].width, height);
+  graphics_draw_text(ctx, text, data->font, rect, GTextOverflowModeFill, GTextAlignmentCenter, NULL);
+}
+
+static void prv_draw_text(Layer *layer, GContext *ctx, int selected_idx) {
 #ifndef PBL_COLOR
   graphics_context_set_text_color(ctx, GColorBlack);
 #endif
 
   SelectionLayerData *data = layer_get_data(layer);
-  for (int i = 0, current_x_offset = 0; i < data->num_cells; i++) {
-    if (data->callbacks.get_cell_text) {
-      char *text = data->callbacks.get_cell_text(i, data->context);
-      if (text) {
-        int height = layer_get_bounds(layer).size.h;
-        if (data->selected_cell_idx == i) {
-          height += prv_get_pixels_for_bump_settle(data->bump_settle_anim_progress);
-        }
-        int y_offset = prv_get_y_offset_which_vertically_centers_font(data->font, height);
-
-        if (data->selected_cell_idx == i && data->bump_is_upwards) {
-          y_offset -= prv_get_pixels_for_bump_settle(data->bump_settle_anim_progress);
-        }
-
-        if (data->selected_cell_idx == i) {
-          int delta = (data->bump_text_anim_progress * prv_get_font_top_padding(data->font)) / 100;
-          if (data->bump_is_upwards) {
-            delta *= -1;
-          }
-          y_offset += delta;
-        }
-
-        GRect rect = GRect(current_x_offset, y_offset, data->cell_widths[i], height);
-        graphics_draw_text(ctx, text, data->font, rect, GTextOverflowModeFill, GTextAlignmentCenter, NULL);
-      }
+  const int scroll_x = prv_get_scroll_x(data);
+  const int view_end = scroll_x + layer_get_bounds(layer).size.w;
+  for (int i = prv_get_first_visible_cell(data, scroll_x);
+       i < data->num_cells && data->cells[i].x_offset < view_end; i++) {
+    prv_draw_cell_text(layer, ctx, i, data->cells[i].x_offset - scroll_x, i == selected_idx);
+  }
+}
+
+#ifdef PBL_COLOR
+// Copies the layer's bounds out of the frame buffer into the cell cache
+static void prv_capture_cell_cache(Layer *layer, GContext *ctx) {
+  SelectionLayerData *data = layer_get_data(layer);
+  const GRect bounds = layer_get_bounds(layer);
+
+  if (data->cell_cache) {
+    const GRect cache_bounds = gbitmap_get_bounds(data->cell_cache);
+    if (!gsize_equal(&cache_bounds.size, &bounds.size)) {
+      gbitmap_destroy(data->cell_cache);
+      data->cell_cache = NULL;
+    }
+  }
+  if (!data->cell_cache) {
+    data->cell_cache = gbitmap_create_blank(bounds.size, GBitmapFormat8Bit);
+    if (!data->cell_cache) {
+      return;
     }
+  }
 
-    current_x_offset += data->cell_widths[i] + data->cell_padding;
+  GBitmap *frame_buffer = graphics_capture_frame_buffer(ctx);
+  if (!frame_buffer) {
+    return;
   }
+  const GPoint origin = layer_convert_point_to_screen(layer, GPointZero);
+  const GRect screen = gbitmap_get_bounds(frame_buffer);
+  uint8_t *cache = gbitmap_get_data(data->cell_cache);
+  const uint16_t cache_row_size = gbitmap_get_bytes_per_row(data->cell_cache);
+  for (int y = MAX(0, -origin.y); y < bounds.size.h && origin.y + y < screen.size.h; y++) {
+    const GBitmapDataRowInfo row = gbitmap_get_data_row_info(frame_buffer, origin.y + y);
+    const int min_x = MAX(origin.x, row.min_x);
+    const int max_x = MIN(origin.x + bounds.size.w - 1, row.max_x);
+    if (min_x <= max_x) {
+      memcpy(&cache[y * cache_row_size + min_x - origin.x], &row.data[min_x], max_x - min_x + 1);
+    }
+  }
+  graphics_release_frame_buffer(ctx, frame_buffer);
+  data->cell_cache_valid = true;
 }
 
-static void prv_draw_selection_layer(Layer *layer, GContext *ctx) {
+// Unselected cells look the same on every frame of an animation, so they are drawn once, at rest,
+// and copied out of the frame buffer. Later frames draw that copy and only draw the selected cell,
+// the selection box and the text it covers on top.
+static void prv_draw_cells_from_cache(Layer *layer, GContext *ctx) {
   SelectionLayerData *data = layer_get_data(layer);
-  prv_draw_cell_backgrounds(layer, ctx);
+  const int scroll_x = prv_get_scroll_x(data);
+  if (data->cell_cache_valid && data->cell_cache_scroll_x == scroll_x) {
+    graphics_draw_bitmap_in_rect(ctx, data->cell_cache, layer_get_bounds(layer));
+  } else {
+    prv_draw_cell_backgrounds(layer, ctx, NO_SELECTED_CELL);
+    prv_draw_text(layer, ctx, NO_SELECTED_CELL);
+    // While a slide scrolls the viewport, every frame would throw the copy away
+    if (scroll_x == data->scroll_x) {
+      prv_capture_cell_cache(layer, ctx);
+      data->cell_cache_scroll_x = scroll_x;
+    }
+  }
+
+  const int selected_idx = data->selected_cell_idx;
+  if (selected_idx < 0 || selected_idx >= data->num_cells) {
+    return;
+  }
+  if (data->slide_is_moving) {
+    // The selection box covers parts of the cells it slides across
+    const GRect slider = prv_draw_slider_slide(layer, ctx);
+    const int scroll_x = prv_get_scroll_x(data);
+    for (int i = prv_get_first_visible_cell(data, scroll_x + slider.origin.x);
+         i < data->num_cells && data->cells[i].x_offset - scroll_x < slider.origin.x + slider.size.w; i++) {
+      prv_draw_cell_text(layer, ctx, i, data->cells[i].x_offset - scroll_x, false);
+    }
+    return;
+  }
+
+  const int x_offset = prv_get_cell_x_offset(data, selected_idx);
+  prv_draw_cell_background(layer, ctx, selected_idx, x_offset, true);
+  if (data->slide_settle_anim_progress) {
+    prv_draw_slider_settle(layer, ctx);
+  }
 
-#ifndef PBL_COLOR 
-  prv_draw_text(layer, ctx);
+  prv_draw_cell_text(layer, ctx, selected_idx, x_offset, true);
+}
 #endif
 
-  if (data->slide_amin_progress) {
+static void prv_draw_selection_layer(Layer *layer, GContext *ctx) {
+#ifdef PBL_COLOR
+  prv_draw_cells_from_cache(layer, ctx);
+#else
+  SelectionLayerData *data = layer_get_data(layer);
+  prv_draw_cell_backgrounds(layer, ctx, data->selected_cell_idx);
+  prv_draw_text(layer, ctx, data->selected_cell_idx);
+
+  if (data->slide_is_moving) {
     prv_draw_slider_slide(layer, ctx);
   }
   if (data->slide_settle_anim_progress) {
     prv_draw_slider_settle(layer, ctx);
   }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//! Animations
 
-#ifdef PBL_COLOR 
-  prv_draw_text(layer, ctx);
+//! Each animation below is a single plain Animation running its two parts one after the other. It
+//! is kept in the layer's data and scheduled again on the next press instead of being recreated.
+//! SDK 3 destroys an animation once it stops, so there a new one is only created when the last one
+//! has finished; earlier SDKs keep it for the life of the layer.
+
+static Animation* prv_get_animation(Layer *layer, Animation **animation, uint32_t duration_ms,
+                                    const AnimationImplementation *implementation,
+                                    AnimationStoppedHandler stopped) {
+#ifdef PBL_SDK_3
+  // A stale handle is refused
+  if (*animation && !animation_is_scheduled(*animation)) {
+    *animation = NULL;
+  }
 #endif
+  if (!*animation) {
+    *animation = animation_create();
+    animation_set_curve(*animation, AnimationCurveLinear);
+    animation_set_duration(*animation, duration_ms);
+    animation_set_implementation(*animation, implementation);
+    animation_set_handlers(*animation, (AnimationHandlers) { .stopped = stopped }, layer);
+  }
+  return *animation;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -245,101 +422,53 @@ static void prv_draw_selection_layer(Layer *layer, GContext *ctx) {
 //! cell making it bigger. The cell then shrinks / settles back to its original height
 //! with the text vertically centered
 
-static void prv_bump_text_impl(struct Animation *animation, const AnimationProgress distance_normalized) {
-  Layer *layer = (Layer*) animation_get_context(animation);
-  SelectionLayerData *data = layer_get_data(layer);
-
-  data->bump_text_anim_progress = (100 * distance_normalized) / ANIMATION_NORMALIZED_MAX;
-  layer_mark_dirty(layer);
-}
-
-static void prv_bump_text_stopped(Animation *animation, bool finished, void *context) {
+static void prv_value_change_update(Animation *animation, const AnimationProgress distance_normalized) {
   Layer *layer = (Layer*)animation_get_context(animation);
   SelectionLayerData *data = layer_get_data(layer);
-  
-  data->bump_text_anim_progress = 0;
 
-  if (data->bump_is_upwards == true) {
-    data->callbacks.increment(data->selected_cell_idx, 1, data->context);
+  if (distance_normalized < s_bump_settle_part.start) {
+    data->bump_text_anim_progress = easing_get_part(EasingIn, &s_bump_text_part, distance_normalized);
   } else {
-    data->callbacks.decrement(data->selected_cell_idx, 1, data->context);
+    data->bump_text_anim_progress = 0;
+    data->bump_settle_anim_progress = easing_get_part(EasingOut, &s_bump_settle_part, distance_normalized);
   }
-
-  animation_destroy(animation);
-
-#ifndef PBL_SDK_3
-  Animation *bump_settle = prv_create_bump_settle_animation(layer);
-  animation_schedule(bump_settle);
-#endif
-}
-
-static void prv_bump_settle_impl(struct Animation *animation, const AnimationProgress distance_normalized) {
-  Layer *layer = (Layer*)animation_get_context(animation);
-  SelectionLayerData *data = layer_get_data(layer);
-
-  data->bump_settle_anim_progress = (100 * distance_normalized) / ANIMATION_NORMALIZED_MAX;
   layer_mark_dirty(layer);
 }
 
-static void prv_bump_settle_stopped(Animation *animation, bool finished, void *context) {
-  Layer *layer = (Layer*)animation_get_context(animation);
+static void prv_value_change_stopped(Animation *animation, bool finished, void *context) {
+  Layer *layer = (Layer*)context;
   SelectionLayerData *data = layer_get_data(layer);
-  
+
+  data->bump_text_anim_progress = 0;
   data->bump_settle_anim_progress = 0;
-  animation_destroy(animation);
 }
 
-static Animation* prv_create_bump_text_animation(Layer *layer) {
-  SelectionLayerData *data = layer_get_data(layer);
-  
-  PropertyAnimation *bump_text_anim = property_animation_create_layer_frame(layer, NULL, NULL);
-  Animation *animation = property_animation_get_animation(bump_text_anim);
-  animation_set_curve(animation, AnimationCurveEaseIn);
-  animation_set_duration(animation, BUMP_TEXT_DURATION_MS);
-  AnimationHandlers anim_handler = {
-      .stopped = prv_bump_text_stopped,
-  };
-  animation_set_handlers(animation, anim_handler, layer);
+static const AnimationImplementation s_value_change_impl = {
+  .update = prv_value_change_update,
+};
 
-  data->bump_text_impl = (AnimationImplementation) {
-    .update = prv_bump_text_impl,
-  };
-  animation_set_implementation(animation, &data->bump_text_impl);
-
-  return animation;
-}
-
-static Animation* prv_create_bump_settle_animation(Layer *layer) {
+// Applies a press at once. Presses in the direction of a bump whose text is still on its way to
+// the edge are folded into that bump rather than starting another one
+static void prv_change_value(Layer *layer, bool is_upwards) {
   SelectionLayerData *data = layer_get_data(layer);
-  
-  PropertyAnimation *bump_settle_anim = property_animation_create_layer_frame(layer, NULL, NULL);
-  Animation *animation = property_animation_get_animation(bump_settle_anim);
-  animation_set_curve(animation, AnimationCurveEaseOut);
-  animation_set_duration(animation, BUMP_SETTLE_DURATION_MS);
-  AnimationHandlers anim_handler = {
-      .stopped = prv_bump_settle_stopped,
-  };
-  animation_set_handlers(animation, anim_handler, layer);
 
-  data->bump_settle_anim_impl = (AnimationImplementation) {
-    .update = prv_bump_settle_impl,
-  };
-  animation_set_implementation(animation, &data->bump_settle_anim_impl);
-
-  return animation;
-}
+  if (is_upwards) {
+    data->callbacks.increment(data->selected_cell_idx, 1, data->context);
+  } else {
+    data->callbacks.decrement(data->selected_cell_idx, 1, data->context);
+  }
+  prv_invalidate_cell_text(data, data->selected_cell_idx);
+  layer_mark_dirty(layer);
 
-static void prv_run_value_change_animation(Layer *layer) {
-  SelectionLayerData *data = layer_get_data(layer);
-  
-  Animation *bump_text = prv_create_bump_text_animation(layer);
-#ifdef PBL_SDK_3
-  Animation *bump_settle = prv_create_bump_settle_animation(layer);
-  data->value_change_animation = animation_sequence_create(bump_text, bump_settle, NULL);
-  animation_schedule(data->value_change_animation);
-#else
-  animation_schedule(bump_text);
-#endif
+  if (data->value_change_animation && animation_is_scheduled(data->value_change_animation) &&
+      data->bump_is_upwards == is_upwards && !data->bump_settle_anim_progress) {
+    return;
+  }
+  Animation *animation = prv_get_animation(layer, &data->value_change_animation,
+                                           BUMP_DURATION_MS,
+                                           &s_value_change_impl, prv_value_change_stopped);
+  animation_schedule(animation);
+  data->bump_is_upwards = is_upwards;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -357,100 +486,68 @@ static void prv_run_value_change_animation(Layer *layer) {
 //! The "settle" (slide_settle) removes the extra width that was added in the "move and expand"
 //! step.
 
-static void prv_slide_impl(struct Animation *animation, const AnimationProgress distance_normalized) {
-  Layer *layer = (Layer*) animation_get_context(animation);
-  SelectionLayerData *data = layer_get_data(layer);
-
-  data->slide_amin_progress = (100 * distance_normalized) / ANIMATION_NORMALIZED_MAX;
-  layer_mark_dirty(layer);
-}
-
-static void prv_slide_stopped(Animation *animation, bool finished, void *context) {
-  Layer *layer = (Layer*)animation_get_context(animation);
-  SelectionLayerData *data = layer_get_data(layer);
-  
-  data->slide_amin_progress = 0;
-  
-  if (data->slide_is_forward) {
-    data->selected_cell_idx++;
-  } else {
-    data->selected_cell_idx--;
+// The selection box reached the selected cell
+static void prv_end_slide_move(SelectionLayerData *data) {
+  if (!data->slide_is_moving) {
+    return;
   }
-
-  animation_destroy(animation);
-
-#ifndef PBL_SDK_3
-  Animation *settle_animation = prv_create_slide_settle_animation(layer);
-  animation_schedule(settle_animation);
-#endif
+  data->slide_is_moving = false;
+  data->slide_amin_progress = 0;
+  data->scroll_x = data->slide_scroll_x;
 }
 
-static void prv_slide_settle_impl(struct Animation *animation, const AnimationProgress distance_normalized) {
+static void prv_slide_update(Animation *animation, const AnimationProgress distance_normalized) {
   Layer *layer = (Layer*)animation_get_context(animation);
   SelectionLayerData *data = layer_get_data(layer);
 
-  data->slide_settle_anim_progress = 100 - ((100 * distance_normalized) / ANIMATION_NORMALIZED_MAX);
+  if (distance_normalized < s_slide_settle_part.start) {
+    data->slide_amin_progress = easing_get_part(EasingIn, &s_slide_part, distance_normalized);
+  } else {
+    prv_end_slide_move(data);
+    data->slide_settle_anim_progress =
+        EASING_ONE - easing_get_part(EasingOut, &s_slide_settle_part, distance_normalized);
+  }
   layer_mark_dirty(layer);
 }
 
-static void prv_slide_settle_stopped(Animation *animation, bool finished, void *context) {
-  Layer *layer = (Layer*) animation_get_context(animation);
+static void prv_slide_stopped(Animation *animation, bool finished, void *context) {
+  Layer *layer = (Layer*)context;
   SelectionLayerData *data = layer_get_data(layer);
-  
+
+  prv_end_slide_move(data);
   data->slide_settle_anim_progress = 0;
-  animation_destroy(animation);
 }
 
-static Animation* prv_create_slide_animation(Layer *layer) {
-  SelectionLayerData *data = layer_get_data(layer);
-  
-  PropertyAnimation *slide_amin = property_animation_create_layer_frame(layer, NULL, NULL);
-  Animation *animation = property_animation_get_animation(slide_amin);
-  animation_set_curve(animation, AnimationCurveEaseIn);
-  animation_set_duration(animation, SLIDE_DURATION_MS);
-  AnimationHandlers anim_handler = {
-      .stopped = prv_slide_stopped,
-  };
-  animation_set_handlers(animation, anim_handler, layer);
-
-  data->slide_amin_impl = (AnimationImplementation) {
-    .update = prv_slide_impl,
-  };
-  animation_set_implementation(animation, &data->slide_amin_impl);
+static const AnimationImplementation s_slide_impl = {
+  .update = prv_slide_update,
+};
 
-  return animation;
-}
-
-static Animation* prv_create_slide_settle_animation(Layer *layer) {
+// Selects the next or previous cell at once. The selection box slides there from wherever it is, so
+// a press during a slide turns the box around or sends it further rather than restarting it
+static void prv_select_cell(Layer *layer, bool is_forward) {
   SelectionLayerData *data = layer_get_data(layer);
-  PropertyAnimation *slide_settle_anim = property_animation_create_layer_frame(layer, NULL, NULL);
-  Animation *animation = property_animation_get_animation(slide_settle_anim);
-  animation_set_curve(animation, AnimationCurveEaseOut);
-  animation_set_duration(animation, SLIDE_SETTLE_DURATION_MS);
-  AnimationHandlers anim_handler = {
-      .stopped = prv_slide_settle_stopped,
-  };
-  animation_set_handlers(animation, anim_handler, layer);
 
-  data->slide_settle_anim_impl = (AnimationImplementation) {
-    .update = prv_slide_settle_impl,
-  };
-  animation_set_implementation(animation, &data->slide_settle_anim_impl);
-
-  return animation;
-}
+  const int scroll_x = prv_get_scroll_x(data);
+  GRect from = prv_get_slider_rect(data);
+  if (!data->slide_is_moving) {
+    const SelectionLayerCell *cell = &data->cells[data->selected_cell_idx];
+    from = GRect(cell->x_offset, 0, cell->width, 0);
+  }
 
-static void prv_run_slide_animation(Layer *layer) {
-  SelectionLayerData *data = layer_get_data(layer);
-  
-  Animation *over_animation = prv_create_slide_animation(layer);
-#ifdef PBL_SDK_3
-  Animation *settle_animation = prv_create_slide_settle_animation(layer);
-  data->next_cell_animation = animation_sequence_create(over_animation, settle_animation, NULL);
-  animation_schedule(data->next_cell_animation);
-#else
-  animation_schedule(over_animation);
-#endif
+  Animation *animation = prv_get_animation(layer, &data->next_cell_animation,
+                                           SLIDE_TOTAL_DURATION_MS,
+                                           &s_slide_impl, prv_slide_stopped);
+  animation_schedule(animation);
+
+  data->selected_cell_idx += is_forward ? 1 : -1;
+  // A box turned around mid-slide may still have to travel the other way
+  data->slide_is_forward = data->cells[data->selected_cell_idx].x_offset >= from.origin.x;
+  data->slide_is_moving = true;
+  data->slide_from_x = from.origin.x;
+  data->slide_from_width = from.size.w;
+  data->scroll_x = scroll_x;
+  data->slide_scroll_x = prv_get_scroll_x_for_cell(layer, data->selected_cell_idx);
+  layer_mark_dirty(layer);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -464,10 +561,10 @@ void prv_up_click_handler(ClickRecognizerRef recognizer, void *context) {
     if (click_recognizer_is_repeating(recognizer)) {
       // Don't animate if the button is being held down. Just update the text
       data->callbacks.increment(data->selected_cell_idx, click_number_of_clicks_counted(recognizer), data->context);
+      prv_invalidate_cell_text(data, data->selected_cell_idx);
       layer_mark_dirty(layer);
     } else {
-      data->bump_is_upwards = true;
-      prv_run_value_change_animation(layer);
+      prv_change_value(layer, true);
     }
   }
 }
@@ -480,10 +577,10 @@ void prv_down_click_handler(ClickRecognizerRef recognizer, void *context) {
     if (click_recognizer_is_repeating(recognizer)) {
       // Don't animate if the button is being held down. Just update the text
       data->callbacks.decrement(data->selected_cell_idx, click_number_of_clicks_counted(recognizer), data->context);
+      prv_invalidate_cell_text(data, data->selected_cell_idx);
       layer_mark_dirty(layer);
     } else {
-      data->bump_is_upwards = false;
-      prv_run_value_change_animation(layer);
+      prv_change_value(layer, false);
     }
   }
 }
@@ -493,13 +590,13 @@ void prv_select_click_handler(ClickRecognizerRef recognizer, void *context) {
   SelectionLayerData *data = layer_get_data(layer);
   
   if (data->is_active) {
-    animation_unschedule(data->next_cell_animation);
     if (data->selected_cell_idx >= data->num_cells - 1) {
+      animation_unschedule(data->next_cell_animation);
       data->selected_cell_idx = 0;
+      data->scroll_x = 0;
       data->callbacks.complete(data->context);
     } else {
-      data->slide_is_forward = true;
-      prv_run_slide_animation(layer);
+      prv_select_cell(layer, true);
     }
   }
 }
@@ -509,13 +606,12 @@ void prv_back_click_handler(ClickRecognizerRef recognizer, void *context) {
   SelectionLayerData *data = layer_get_data(layer);
   
   if (data->is_active) {
-    animation_unschedule(data->next_cell_animation);
     if (data->selected_cell_idx == 0) {
+      animation_unschedule(data->next_cell_animation);
       data->selected_cell_idx = 0;
       window_stack_pop(true);
     } else {
-      data->slide_is_forward = false;
-      prv_run_slide_animation(layer);
+      prv_select_cell(layer, false);
     }
   }
 }
@@ -539,8 +635,9 @@ static Layer* selection_layer_init(SelectionLayerData *selection_layer_, GRect f
   Layer *layer = layer_create_with_data(frame, sizeof(SelectionLayerData));
   SelectionLayerData *selection_layer_data = layer_get_data(layer);
 
-  if (num_cells > MAX_SELECTION_LAYER_CELLS) {
-    num_cells = MAX_SELECTION_LAYER_CELLS;
+  SelectionLayerCell *cells = num_cells > 0 ? calloc(num_cells, sizeof(SelectionLayerCell)) : NULL;
+  if (!cells) {
+    num_cells = 0;
   }
   
   // Set layer defaults
@@ -552,14 +649,16 @@ static Layer* selection_layer_init(SelectionLayerData *selection_layer_, GRect f
     .inverter = inverter_layer_create(GRect(0, 0, 0, frame.size.h)),
 #endif
     .num_cells = num_cells,
+    .cells = cells,
     .cell_padding = DEFAULT_CELL_PADDING,
     .selected_cell_idx = DEFAULT_SELECTED_INDEX,
     .font = fonts_get_system_font(DEFAULT_FONT),
     .is_active = true,
   };
   for (int i = 0; i < num_cells; i++) {
-    selection_layer_data->cell_widths[i] = 0;
+    selection_layer_data->cells[i].text_stale = true;
   }
+  prv_update_font_metrics(selection_layer_data);
   layer_set_frame(layer, frame);
   layer_set_clips(layer, false);
   layer_set_update_proc(layer, (LayerUpdateProc)prv_draw_selection_layer);
@@ -577,10 +676,23 @@ Layer* selection_layer_create(GRect frame, int num_cells) {
 }
 
 static void selection_layer_deinit(Layer* layer) {
-#ifndef PBL_COLOR
   SelectionLayerData *data = layer_get_data(layer);
+#ifdef PBL_COLOR
+  if (data->cell_cache) {
+    gbitmap_destroy(data->cell_cache);
+  }
+#else
   inverter_layer_destroy(data->inverter);
 #endif
+#ifndef PBL_SDK_3
+  if (data->value_change_animation) {
+    animation_destroy(data->value_change_animation);
+  }
+  if (data->next_cell_animation) {
+    animation_destroy(data->next_cell_animation);
+  }
+#endif
+  free(data->cells);
 
   layer_destroy(layer);
 }
@@ -598,7 +710,9 @@ void selection_layer_set_cell_width(Layer *layer, int idx, int width) {
   SelectionLayerData *data = layer_get_data(layer);
   
   if (data && idx < data->num_cells) {
-    data->cell_widths[idx] = width;
+    data->cells[idx].width = width;
+    prv_update_cell_offsets(layer);
+    prv_invalidate_cell_cache(data);
   }
 #ifndef PBL_COLOR
   layer_set_bounds(inverter_layer_get_layer(data->inverter), GRect(0, 0, width, layer_get_bounds(inverter_layer_get_layer(data->inverter)).size.h));
@@ -610,6 +724,8 @@ void selection_layer_set_font(Layer *layer, GFont font) {
   
   if (data) {
     data->font = font;
+    prv_update_font_metrics(data);
+    prv_invalidate_cell_cache(data);
   }
 }
 
@@ -618,6 +734,7 @@ void selection_layer_set_inactive_bg_color(Layer *layer, GColor color) {
   
   if (data) {
     data->inactive_background_color = color;
+    prv_invalidate_cell_cache(data);
   }
 }
 
@@ -626,6 +743,7 @@ void selection_layer_set_active_bg_color(Layer *layer, GColor color) {
   
   if (data) {
     data->active_background_color = color;
+    prv_invalidate_cell_cache(data);
   }
 }
 
@@ -634,6 +752,8 @@ void selection_layer_set_cell_padding(Layer *layer, int padding) {
   
   if (data) {
     data->cell_padding = padding;
+    prv_update_cell_offsets(layer);
+    prv_invalidate_cell_cache(data);
   }
 }
 
@@ -643,11 +763,14 @@ void selection_layer_set_active(Layer *layer, bool is_active) {
   if (data) {
     if (is_active && !data->is_active) {
       data->selected_cell_idx = 0;
+      data->scroll_x = 0;
     } if (!is_active && data->is_active) {
-      data->selected_cell_idx = MAX_SELECTION_LAYER_CELLS + 1;
+      data->selected_cell_idx = NO_SELECTED_CELL;
+      data->slide_is_moving = false;
     }
     
     data->is_active = is_active;
+    prv_invalidate_cell_cache(data);
     layer_mark_dirty(layer);
   }
 }
@@ -662,4 +785,17 @@ void selection_layer_set_callbacks(Layer *layer, void *context, SelectionLayerCa
   SelectionLayerData *data = layer_get_data(layer);
   data->callbacks = callbacks;
   data->context = context;
+  for (int i = 0; i < data->num_cells; i++) {
+    data->cells[i].text_stale = true;
+  }
+  prv_invalidate_cell_cache(data);
+}
+
+void selection_layer_invalidate_cell(Layer *layer, int cell_idx) {
+  SelectionLayerData *data = layer_get_data(layer);
+
+  if (data && cell_idx >= 0 && cell_idx < data->num_cells) {
+    prv_invalidate_cell_text(data, cell_idx);
+    layer_mark_dirty(layer);
+  }
 }
@@ -2,8 +2,8 @@
 
 #include <pebble.h>
 
-#define MAX_SELECTION_LAYER_CELLS 3
-
+// The text must stay valid until the cell is invalidated: the layer keeps the pointer and only asks
+// again after selection_layer_invalidate_cell(), or after the cell was incremented or decremented
 typedef char* (*SelectionLayerGetCellText)(int index, void *context);
 
 typedef void (*SelectionLayerCompleteCallback)(void *context);
@@ -19,41 +19,69 @@ typedef struct SelectionLayerCallbacks {
   SelectionLayerDecrementCallback decrement;
 } SelectionLayerCallbacks;
 
+typedef struct SelectionLayerCell {
+  int width;
+  // Distance from the left edge of the first cell, kept up to date as widths and padding change
+  int x_offset;
+  // Text as last returned by get_cell_text, asked again when text_stale is set
+  char *text;
+  bool text_stale;
+} SelectionLayerCell;
+
 typedef struct SelectionLayerData {
 #ifndef PBL_COLOR
   InverterLayer *inverter;
 #endif
   int num_cells;
-  int cell_widths[MAX_SELECTION_LAYER_CELLS];
+  SelectionLayerCell *cells;
   int cell_padding;
   int selected_cell_idx;
 
+  // Left edge of the viewport over the cells, and where the running slide takes it
+  int scroll_x;
+  int slide_scroll_x;
+
   // If is_active = false the the selected cell will become invalid, and any clicks will be ignored
   bool is_active;
 
   GFont font;
+  // How far above the middle of the cell the text starts so that it is centered, and how far a
+  // value change bumps it; measured when the font is set
+  int font_center_offset;
+  int font_bump_distance;
   GColor inactive_background_color;
   GColor active_background_color;
 
   SelectionLayerCallbacks callbacks;
   void *context;
 
-  // Animation stuff
+#ifdef PBL_COLOR
+  // Every cell drawn at rest, unselected, over the layer's bounds, with the viewport at cell_cache_scroll_x
+  GBitmap *cell_cache;
+  bool cell_cache_valid;
+  int cell_cache_scroll_x;
+#endif
+
+  // Animation stuff. Each animation is reused from one press to the next, and the *_progress
+  // fields are eased fractions of EASING_ONE
   Animation *value_change_animation;
   bool bump_is_upwards;
   int bump_text_anim_progress;
-  AnimationImplementation bump_text_impl;
   int bump_settle_anim_progress;
-  AnimationImplementation bump_settle_anim_impl;
 
   Animation *next_cell_animation;
   bool slide_is_forward;
+  // The selected cell changes on the press; the selection box then slides to it from where it was,
+  // slide_from_x and slide_from_width in the cells' coordinates
+  bool slide_is_moving;
+  int slide_from_x;
+  int slide_from_width;
   int slide_amin_progress;
-  AnimationImplementation slide_amin_impl;
   int slide_settle_anim_progress;
-  AnimationImplementation slide_settle_anim_impl;
 } SelectionLayerData;
 
+// Cells wider than the frame scroll to keep the selected one in view. They are then clipped to the
+// frame, bump animation included
 Layer* selection_layer_create(GRect frame, int num_cells);
 
 void selection_layer_destroy(Layer* layer);
@@ -74,3 +102,6 @@ void selection_layer_set_active(Layer *layer, bool is_active);
 void selection_layer_set_click_config_onto_window(Layer *layer, struct Window *window);
 
 void selection_layer_set_callbacks(Layer *layer, void *context, SelectionLayerCallbacks callbacks);
+
+// Asks get_cell_text for the text of a cell again before it is next drawn
+void selection_layer_invalidate_cell(Layer *layer, int cell_idx);
@@ -0,0 +1,112 @@
+#include <pebble.h>
+#include "binlog.h"
+
+#if BINLOG_LEVEL > BINLOG_LEVEL_NONE
+
+#define NUM_RECORDS 64
+// Records per log line; APP_LOG truncates long messages
+#define RECORDS_PER_LINE 4
+// Records written within this long of the first one share its flush
+#define FLUSH_DELAY_MS 500
+
+typedef struct {
+  uint32_t time_ms;
+  uint8_t event;
+  uint8_t level;
+  int16_t args[3];
+} BinlogRecord;
+
+_Static_assert(sizeof(BinlogRecord) == BINLOG_RECORD_LENGTH, "binary log records are 12 bytes");
+
+static BinlogRecord s_records[NUM_RECORDS];
+static uint16_t s_first;
+static uint16_t s_count;
+// Records refused since the last flush because the ring was full
+static uint16_t s_dropped;
+static AppTimer *s_flush_timer;
+
+static uint32_t prv_now_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+static char *prv_put_hex(char *line, uint32_t value, int num_bytes) {
+  static const char HEX[] = "0123456789abcdef";
+  for (int i = 0; i < num_bytes; i++, value >>= 8) {
+    *line++ = HEX[(value >> 4) & 0xf];
+    *line++ = HEX[value & 0xf];
+  }
+  return line;
+}
+
+static char *prv_put_record(char *line, const BinlogRecord *record) {
+  line = prv_put_hex(line, record->time_ms, 4);
+  line = prv_put_hex(line, record->event, 1);
+  line = prv_put_hex(line, record->level, 1);
+  for (int i = 0; i < 3; i++) {
+    line = prv_put_hex(line, (uint16_t)record->args[i], 2);
+  }
+  return line;
+}
+
+static void prv_flush_callback(void *context) {
+  s_flush_timer = NULL;
+  binlog_flush();
+}
+
+void binlog_write(uint8_t level, BinlogEvent event, int32_t a, int32_t b, int32_t c) {
+  if (s_count == NUM_RECORDS) {
+    s_dropped++;
+  } else {
+    s_records[(s_first + s_count) % NUM_RECORDS] = (BinlogRecord) {
+      .time_ms = prv_now_ms(),
+      .event = event,
+      .level = level,
+      .args = { a, b, c },
+    };
+    s_count++;
+  }
+  if (!s_flush_timer) {
+    s_flush_timer = app_timer_register(FLUSH_DELAY_MS, prv_flush_callback, NULL);
+  }
+}
+
+// Writes out the ring, oldest first
+static void prv_log_records(void) {
+  char line[2 * BINLOG_RECORD_LENGTH * RECORDS_PER_LINE + 1];
+  while (s_count) {
+    char *end = line;
+    for (int i = 0; i < RECORDS_PER_LINE && s_count; i++) {
+      end = prv_put_record(end, &s_records[s_first]);
+      s_first = (s_first + 1) % NUM_RECORDS;
+      s_count--;
+    }
+    *end = '\0';
+    APP_LOG(APP_LOG_LEVEL_INFO, "BLG %s", line);
+  }
+}
+
+void binlog_flush(void) {
+  if (s_flush_timer) {
+    app_timer_cancel(s_flush_timer);
+    s_flush_timer = NULL;
+  }
+
+  prv_log_records();
+  if (s_dropped) {
+    // Reported after the records that filled the ring
+    s_records[s_first] = (BinlogRecord) {
+      .time_ms = prv_now_ms(),
+      .event = BinlogEventDropped,
+      .level = BINLOG_LEVEL_WARNING,
+      .args = { s_dropped },
+    };
+    s_count = 1;
+    s_dropped = 0;
+    prv_log_records();
+  }
+}
+
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <pebble.h>
+#include "binlog_events.h"
+
+// Logging for the paths that run per sample. A record is an event ID and up to three integer
+// arguments, stored in a RAM ring with no formatting; a timer writes the ring to the app log as
+// hex "BLG" lines in batches, and host/tools/binlog_decode turns them back into messages.
+//
+// Levels are chosen at compile time: records above BINLOG_LEVEL compile to nothing, arguments
+// included, so they must not have side effects. Release builds (RELEASE defined, by the wscript
+// --release option) log nothing unless BINLOG_LEVEL says otherwise.
+//
+// Record layout, little endian:
+//  [0..3] time in milliseconds, from time_ms()
+//  [4] BinlogEvent
+//  [5] level
+//  [6..11] three int16 arguments
+
+#define BINLOG_LEVEL_NONE 0
+#define BINLOG_LEVEL_ERROR 1
+#define BINLOG_LEVEL_WARNING 2
+#define BINLOG_LEVEL_INFO 3
+#define BINLOG_LEVEL_DEBUG 4
+
+#ifndef BINLOG_LEVEL
+#ifdef RELEASE
+#define BINLOG_LEVEL BINLOG_LEVEL_NONE
+#else
+#define BINLOG_LEVEL BINLOG_LEVEL_INFO
+#endif
+#endif
+
+#define BINLOG_RECORD_LENGTH 12
+
+#define BINLOG_EVENT(id, format) id,
+typedef enum {
+  BINLOG_EVENTS
+  BinlogEventCount,
+} BinlogEvent;
+#undef BINLOG_EVENT
+
+// Pads the arguments to three
+#define BINLOG_WRITE_(level, event, a, b, c, ...) binlog_write(level, event, a, b, c)
+
+/*
+ * BINLOG_ERROR(event, args...) and friends record an event with up to three arguments, which are
+ * truncated to 16 bits
+ */
+#if BINLOG_LEVEL >= BINLOG_LEVEL_ERROR
+#define BINLOG_ERROR(...) BINLOG_WRITE_(BINLOG_LEVEL_ERROR, __VA_ARGS__, 0, 0, 0, 0)
+#else
+#define BINLOG_ERROR(...) ((void)0)
+#endif
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_WARNING
+#define BINLOG_WARNING(...) BINLOG_WRITE_(BINLOG_LEVEL_WARNING, __VA_ARGS__, 0, 0, 0, 0)
+#else
+#define BINLOG_WARNING(...) ((void)0)
+#endif
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_INFO
+#define BINLOG_INFO(...) BINLOG_WRITE_(BINLOG_LEVEL_INFO, __VA_ARGS__, 0, 0, 0, 0)
+#else
+#define BINLOG_INFO(...) ((void)0)
+#endif
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_DEBUG
+#define BINLOG_DEBUG(...) BINLOG_WRITE_(BINLOG_LEVEL_DEBUG, __VA_ARGS__, 0, 0, 0, 0)
+#else
+#define BINLOG_DEBUG(...) ((void)0)
+#endif
+
+#if BINLOG_LEVEL > BINLOG_LEVEL_NONE
+
+/*
+ * Stores a record, called through the BINLOG_* macros
+ */
+void binlog_write(uint8_t level, BinlogEvent event, int32_t a, int32_t b, int32_t c);
+
+/*
+ * Writes the stored records to the app log now, rather than when the flush timer fires
+ */
+void binlog_flush(void);
+
+#else
+
+#define binlog_flush() ((void)0)
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+
+// Every binary log event, as BINLOG_EVENT(id, format). The watchapp only compiles the IDs; the
+// formats are for host/tools/binlog_decode, which fills in the record's arguments in order:
+//  %d decimal, %x hex, %r SmartstrapResult name, %a strap attribute name
+// Append new events at the end, so logs from older builds still decode.
+
+#define BINLOG_EVENTS \
+  BINLOG_EVENT(BinlogEventDropped, "%d records dropped, the log was full") \
+  BINLOG_EVENT(BinlogEventServiceAvailability, "Service %x available: %d") \
+  BINLOG_EVENT(BinlogEventBeginWriteFailed, "Begin write of %a failed with %r") \
+  BINLOG_EVENT(BinlogEventEndWriteFailed, "End write of %a failed with %r") \
+  BINLOG_EVENT(BinlogEventWriteFailed, "Write of %a failed with %r") \
+  BINLOG_EVENT(BinlogEventReadFailed, "Read of %a failed with %r") \
+  BINLOG_EVENT(BinlogEventResponseLength, "Got response of %a of unexpected length (%d)") \
+  BINLOG_EVENT(BinlogEventStreamLength, "Got stream block of unexpected length (%d)") \
+  BINLOG_EVENT(BinlogEventPinEntered, "Pin was %d %d %d") \
+  BINLOG_EVENT(BinlogEventControlRejected, "Strap rejected the data written to %a")
@@ -1,168 +1,156 @@
 #include <pebble.h>
 #include "windows/pin_window.h"
-
-static const SmartstrapServiceId SERVICE_ID = 0x1001;
-static const SmartstrapAttributeId TOP_INPUT_ATTRIBUTE_ID = 0x0001;
-static const SmartstrapAttributeId TOP_OUTPUT_ATTRIBUTE_ID = 0x0002;
-static const SmartstrapAttributeId CENTER_INPUT_ATTRIBUTE_ID = 0x0003;
-static const SmartstrapAttributeId CENTER_OUTPUT_ATTRIBUTE_ID = 0x0004;
-static const SmartstrapAttributeId BOTTOM_INPUT_ATTRIBUTE_ID = 0x0005;
-static const SmartstrapAttributeId BOTTOM_OUTPUT_ATTRIBUTE_ID = 0x0006;
-
-static const size_t ATTRIBUTE_LENGTH = 1;
-
-static SmartstrapAttribute *top_input_attribute;
-static SmartstrapAttribute *top_output_attribute;
-static SmartstrapAttribute *center_input_attribute;
-static SmartstrapAttribute *center_output_attribute;
-static SmartstrapAttribute *bottom_input_attribute;
-static SmartstrapAttribute *bottom_output_attribute;
+#include "strap/router.h"
+#include "strap/telemetry.h"
+#include "strap/recipe.h"
+#include "log/binlog.h"
 
 static Window *s_main_window;
 static MenuLayer *s_menu_layer;
 // static TextLayer *s_output_layer;
 
-static SmartstrapAttribute *selected_input_attribute;
-static SmartstrapAttribute *selected_output_attribute;
-static int selected_input_attribute_index;
-static int selected_output_attribute_index;
-
-#define NUM_WINDOWS 1
-#define CELL_HEIGHT 30
-
-/******************************** Smartstraps *********************************/
-
-static char* smartstrap_result_to_string(SmartstrapResult result) {
-  switch(result) {
-    case SmartstrapResultOk:                   return "SmartstrapResultOk";
-    case SmartstrapResultInvalidArgs:          return "SmartstrapResultInvalidArgs";
-    case SmartstrapResultNotPresent:           return "SmartstrapResultNotPresent";
-    case SmartstrapResultBusy:                 return "SmartstrapResultBusy";
-    case SmartstrapResultServiceUnavailable:   return "SmartstrapResultServiceUnavailable";
-    case SmartstrapResultAttributeUnsupported: return "SmartstrapResultAttributeUnsupported";
-    case SmartstrapResultTimeOut:              return "SmartstrapResultTimeOut";
-    default: return "Not a SmartstrapResult value!";
-  }
-}
-
-static void strap_availability_handler(SmartstrapServiceId service_id, bool is_available) {
-  // A service's availability has changed
-  APP_LOG(APP_LOG_LEVEL_INFO, "Service %d is %s available", (int)service_id, is_available ? "now" : "NOT");
-}
-
-/********************************** Output ************************************/
+static Recipe s_recipe;
+static bool s_adding_route;
+// Events in the last telemetry dump, -1 before the first one
+static int s_telemetry_dumped = -1;
+
+#define NUM_WINDOWS 6
+#define CELL_HEIGHT 44
+
+// PIN digits 0-2 pick the top, center or bottom channel. Input digits 3 and 4 merge all
+// inputs by max and min, input digits 5-7 replace the inputs with a square, saw or sine wave
+// made on the watch, output digit 3 drives all outputs.
+#define PIN_ALL_INPUTS_MAX 3
+#define PIN_ALL_INPUTS_MIN 4
+#define PIN_FIRST_WAVE 5
+#define PIN_ALL_OUTPUTS 3
+#define WAVE_PERIOD_MS 2000
+
+// The middle PIN digit picks the transform of the route
+static const RouterTransform TRANSFORMS[] = {
+  { .type = RouterTransformNone },
+  { .type = RouterTransformInvert },
+  { .type = RouterTransformGate, .threshold = 128, .binary = true },
+  { .type = RouterTransformGainOffset, .gain = 32, .offset = -64 },
+  { .type = RouterTransformCurve, .steepness = 40 },
+  { .type = RouterTransformHysteresis, .threshold = 96, .threshold_high = 160 },
+  { .type = RouterTransformQuantize, .steps = 4 },
+};
+
+// Middle digits past the transforms pick when the route writes instead
+static const RouterOperator OPERATORS[] = {
+  { .type = RouterOperatorDelay, .period_ms = 500 },
+  { .type = RouterOperatorSampleHold, .period_ms = 1000 },
+  { .type = RouterOperatorPulseStretch, .period_ms = 300 },
+};
+
+typedef struct {
+  char *name;
+  // 0 keeps the strap notifying changes only
+  uint8_t sample_period_ms;
+  uint8_t samples_per_block;
+} SampleRate;
+
+// Blocks are sized so the strap notifies about every 40 ms whatever the rate
+static const SampleRate SAMPLE_RATES[] = {
+  { "On change", 0, 0 },
+  { "50 Hz", 20, 2 },
+  { "100 Hz", 10, 4 },
+  { "200 Hz", 5, 8 },
+};
+
+typedef struct {
+  char *name;
+  RouterNotifyConfig config;
+} Response;
+
+// How eagerly the strap notifies changes when it is not streaming. The top channel is digital,
+// so it has no deadband and nothing to settle.
+static const Response RESPONSES[] = {
+  { "Balanced", { .channels = { { 0, 50, 0 }, { 2, 50, 500 }, { 2, 50, 500 } },
+                  .notifies_per_second = 20, .burst = 4 } },
+  { "Fast", { .channels = { { 0, 20, 0 }, { 1, 20, 200 }, { 1, 20, 200 } },
+              .notifies_per_second = 50, .burst = 8 } },
+  { "Low power", { .channels = { { 0, 100, 0 }, { 4, 200, 1000 }, { 4, 200, 1000 } },
+                   .notifies_per_second = 5, .burst = 2 } },
+};
 
-static void prv_set_attribute_value(SmartstrapAttribute *attribute, uint8_t value) {
-  //updateUIValue(value);
-
-  SmartstrapResult result;
-  uint8_t *buffer;
-  size_t length;
-  result = smartstrap_attribute_begin_write(attribute, &buffer, &length);
-  if (result != SmartstrapResultOk) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Begin write failed with error %s", smartstrap_result_to_string(result));
-    return;
-  }
-
-  buffer[0] = value;
-
-  result = smartstrap_attribute_end_write(attribute, 1, false);
-  if (result != SmartstrapResultOk) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "End write failed with error %s", smartstrap_result_to_string(result));
-    return;
-  }
-}
-
-/********************************** Input *************************************/
+/************************************* UI *************************************/
 
-static void strap_notify_handler(SmartstrapAttribute *attribute) {
-  if (attribute != selected_input_attribute) {
-    return;
+static uint8_t get_channel_mask(int index) {
+  // PIN digits past the bottom channel fall back to the top one
+  if (index < 0 || index > 2) {
+    return ROUTER_CHANNEL(0);
   }
-
-  smartstrap_attribute_read(attribute);
+  return ROUTER_CHANNEL(index);
 }
 
-static void strap_did_read(SmartstrapAttribute *attribute, SmartstrapResult result,
-                         const uint8_t *data, size_t length) {
-  if (attribute != selected_input_attribute) {
-    return;
-  }
-  if (result != SmartstrapResultOk) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Read failed with result %s", smartstrap_result_to_string(result));
-    return;
-  }
-  if (length != ATTRIBUTE_LENGTH) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Got response of unexpected length (%s)", smartstrap_result_to_string(result));
-    return;
+static RouterRouteConfig get_route_config(PIN pin) {
+  RouterRouteConfig config = {
+    .inputs = get_channel_mask(pin.digits[0]),
+    .outputs = get_channel_mask(pin.digits[2]),
+    .combine = RouterCombineMax,
+  };
+  const int middle = pin.digits[1];
+  if (middle >= 0 && middle < (int)ARRAY_LENGTH(TRANSFORMS)) {
+    config.transform = TRANSFORMS[middle];
+  } else if (middle >= (int)ARRAY_LENGTH(TRANSFORMS) &&
+             middle < (int)(ARRAY_LENGTH(TRANSFORMS) + ARRAY_LENGTH(OPERATORS))) {
+    config.operator = OPERATORS[middle - ARRAY_LENGTH(TRANSFORMS)];
   }
 
-  prv_set_attribute_value(selected_output_attribute, *data);
-}
-
-/************************************* UI *************************************/
-
-static void updateUIValue(uint8_t value) {
-  // static char s_buffer[128];
-  // snprintf(s_buffer, sizeof(s_buffer), "%d", value);
-  // text_layer_set_text(s_output_layer, s_buffer);
-}
-
-static SmartstrapAttribute* get_input_attribute(int index) {
-  switch(index) {
-    case 0:
-      return top_input_attribute;
-      break;
-    case 1:
-      return center_input_attribute;
-      break;
-    case 2:
-      return bottom_input_attribute;
-      break;
-    default:
-      return top_input_attribute;
-      break;
+  if (pin.digits[0] == PIN_ALL_INPUTS_MAX || pin.digits[0] == PIN_ALL_INPUTS_MIN) {
+    config.inputs = ROUTER_ALL_CHANNELS;
+    config.combine = (pin.digits[0] == PIN_ALL_INPUTS_MAX) ? RouterCombineMax : RouterCombineMin;
+  } else if (pin.digits[0] >= PIN_FIRST_WAVE && pin.digits[0] <= PIN_FIRST_WAVE + RouterWaveSine) {
+    config.inputs = 0;
+    config.operator = (RouterOperator) {
+      .type = RouterOperatorLfo,
+      .period_ms = WAVE_PERIOD_MS,
+      .wave = pin.digits[0] - PIN_FIRST_WAVE,
+    };
   }
-}
-
-static SmartstrapAttribute* get_output_attribute(int index) {
-  switch(index) {
-    case 0:
-      return top_output_attribute;
-      break;
-    case 1:
-      return center_output_attribute;
-      break;
-    case 2:
-      return bottom_output_attribute;
-      break;
-    default:
-      return top_output_attribute;
-      break;
+  if (pin.digits[2] == PIN_ALL_OUTPUTS) {
+    config.outputs = ROUTER_ALL_CHANNELS;
   }
+  return config;
 }
 
 static void play_recipe() {
   // reset all outputs
-  prv_set_attribute_value(top_output_attribute, 0);
-  prv_set_attribute_value(center_output_attribute, 0);
-  prv_set_attribute_value(bottom_output_attribute, 0);
+  router_write_outputs(ROUTER_ALL_CHANNELS, 0);
 
-  selected_input_attribute = get_input_attribute(selected_input_attribute_index);
-  selected_output_attribute = get_output_attribute(selected_output_attribute_index);
-  smartstrap_attribute_read(selected_input_attribute);
+  router_clear_routes();
+  for (int i = 0; i < s_recipe.num_routes; i++) {
+    router_add_route(s_recipe.routes[i]);
+  }
+  router_start();
 }
 
 static void pin_complete_callback(PIN pin, void *context) {
-  selected_input_attribute_index = pin.digits[0];
-  selected_output_attribute_index = pin.digits[2];
+  if (!s_adding_route) {
+    s_recipe.num_routes = 0;
+  }
+  if (s_recipe.num_routes < ROUTER_MAX_ROUTES) {
+    s_recipe.routes[s_recipe.num_routes++] = get_route_config(pin);
+  }
+  recipe_save(&s_recipe);
 
-  APP_LOG(APP_LOG_LEVEL_INFO, "Pin was %d %d %d", pin.digits[0], pin.digits[1], pin.digits[2]);
+  BINLOG_INFO(BinlogEventPinEntered, pin.digits[0], pin.digits[1], pin.digits[2]);
   pin_window_pop((PinWindow*)context, true);
+  menu_layer_reload_data(s_menu_layer);
 
   play_recipe();
 }
 
+static void edit_recipe(bool adding_route) {
+  s_adding_route = adding_route;
+  PinWindow *pin_window = pin_window_create((PinWindowCallbacks) {
+    .pin_complete = pin_complete_callback
+  });
+  pin_window_push(pin_window, true);
+}
+
 static uint16_t get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *context) {
   return NUM_WINDOWS;
 }
@@ -172,6 +160,31 @@ static void draw_row_callback(GContext *ctx, Layer *cell_layer, MenuIndex *cell_
     case 0:
       menu_cell_basic_draw(ctx, cell_layer, "Edit Recipe", NULL, NULL);
       break;
+    case 1: {
+        static char s_subtitle[16];
+        snprintf(s_subtitle, sizeof(s_subtitle), "%d of %d", s_recipe.num_routes, ROUTER_MAX_ROUTES);
+        menu_cell_basic_draw(ctx, cell_layer, "Add Route", s_subtitle, NULL);
+      }
+      break;
+    case 2:
+      menu_cell_basic_draw(ctx, cell_layer, "Clear Recipe", NULL, NULL);
+      break;
+    case 3:
+      menu_cell_basic_draw(ctx, cell_layer, "Sampling", SAMPLE_RATES[s_recipe.sample_rate_idx].name, NULL);
+      break;
+    case 4:
+      menu_cell_basic_draw(ctx, cell_layer, "Response", RESPONSES[s_recipe.response_idx].name, NULL);
+      break;
+    case 5: {
+        static char s_subtitle[24];
+        if (s_telemetry_dumped < 0) {
+          snprintf(s_subtitle, sizeof(s_subtitle), "Select to save");
+        } else {
+          snprintf(s_subtitle, sizeof(s_subtitle), "Saved %d events", s_telemetry_dumped);
+        }
+        menu_cell_basic_draw(ctx, cell_layer, "Telemetry", s_subtitle, NULL);
+      }
+      break;
     default:
       break;
   }
@@ -183,13 +196,40 @@ static int16_t get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex
 
 static void select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *context) {
   switch(cell_index->row) {
-    case 0: {
-        PinWindow *pin_window = pin_window_create((PinWindowCallbacks) {
-          .pin_complete = pin_complete_callback
-        });
-        pin_window_push(pin_window, true);
+    case 0:
+      edit_recipe(false);
+      break;
+    case 1:
+      if (s_recipe.num_routes < ROUTER_MAX_ROUTES) {
+        edit_recipe(true);
+      }
+      break;
+    case 2:
+      s_recipe.num_routes = 0;
+      recipe_save(&s_recipe);
+      menu_layer_reload_data(s_menu_layer);
+      play_recipe();
+      break;
+    case 3: {
+        s_recipe.sample_rate_idx = (s_recipe.sample_rate_idx + 1) % ARRAY_LENGTH(SAMPLE_RATES);
+        const SampleRate *rate = &SAMPLE_RATES[s_recipe.sample_rate_idx];
+        router_set_streaming(rate->sample_period_ms, rate->samples_per_block);
+        recipe_save(&s_recipe);
+        menu_layer_reload_data(s_menu_layer);
       }
       break;
+    case 4:
+      s_recipe.response_idx = (s_recipe.response_idx + 1) % ARRAY_LENGTH(RESPONSES);
+      router_set_notify_config(&RESPONSES[s_recipe.response_idx].config);
+      recipe_save(&s_recipe);
+      menu_layer_reload_data(s_menu_layer);
+      break;
+    case 5:
+      // Saved for later, and logged for whoever is connected now
+      s_telemetry_dumped = telemetry_dump();
+      telemetry_log_dump();
+      menu_layer_reload_data(s_menu_layer);
+      break;
     default:
       break;
   }
@@ -269,6 +309,23 @@ static void click_config_provider(void *context) {
 /************************************ App *************************************/
 
 static void init() {
+  router_init();
+
+  // Resume the last recipe before the UI loads, so the bridge is live straight away
+  if (!recipe_load(&s_recipe) || s_recipe.sample_rate_idx >= ARRAY_LENGTH(SAMPLE_RATES) ||
+      s_recipe.response_idx >= ARRAY_LENGTH(RESPONSES)) {
+    s_recipe = (Recipe) { 0 };
+  }
+  // The strap may still hold the pacing of a previous run of the app
+  router_set_notify_config(&RESPONSES[s_recipe.response_idx].config);
+  const SampleRate *rate = &SAMPLE_RATES[s_recipe.sample_rate_idx];
+  if (rate->sample_period_ms) {
+    router_set_streaming(rate->sample_period_ms, rate->samples_per_block);
+  }
+  if (s_recipe.num_routes) {
+    play_recipe();
+  }
+
   s_main_window = window_create();
   window_set_click_config_provider(s_main_window, click_config_provider);
   window_set_window_handlers(s_main_window, (WindowHandlers) {
@@ -276,28 +333,11 @@ static void init() {
     .unload = main_window_unload,
   });
   window_stack_push(s_main_window, true);
-
-  SmartstrapHandlers handlers = (SmartstrapHandlers) {
-    .availability_did_change = strap_availability_handler,
-    .did_read = strap_did_read,
-    .notified = strap_notify_handler
-  };
-  smartstrap_subscribe(handlers);
-  top_input_attribute = smartstrap_attribute_create(SERVICE_ID, TOP_INPUT_ATTRIBUTE_ID, ATTRIBUTE_LENGTH);
-  top_output_attribute = smartstrap_attribute_create(SERVICE_ID, TOP_OUTPUT_ATTRIBUTE_ID, ATTRIBUTE_LENGTH);
-  center_input_attribute = smartstrap_attribute_create(SERVICE_ID, CENTER_INPUT_ATTRIBUTE_ID, ATTRIBUTE_LENGTH);
-  center_output_attribute = smartstrap_attribute_create(SERVICE_ID, CENTER_OUTPUT_ATTRIBUTE_ID, ATTRIBUTE_LENGTH);
-  bottom_input_attribute = smartstrap_attribute_create(SERVICE_ID, BOTTOM_INPUT_ATTRIBUTE_ID, ATTRIBUTE_LENGTH);
-  bottom_output_attribute = smartstrap_attribute_create(SERVICE_ID, BOTTOM_OUTPUT_ATTRIBUTE_ID, ATTRIBUTE_LENGTH);
 }
 
 static void deinit() {
-  smartstrap_attribute_destroy(top_input_attribute);
-  smartstrap_attribute_destroy(top_output_attribute);
-  smartstrap_attribute_destroy(center_input_attribute);
-  smartstrap_attribute_destroy(center_output_attribute);
-  smartstrap_attribute_destroy(bottom_input_attribute);
-  smartstrap_attribute_destroy(bottom_output_attribute);
+  router_deinit();
+  binlog_flush();
 }
 
 int main() {
@@ -0,0 +1,280 @@
+#include <pebble.h>
+#include "operator.h"
+
+// Values a delay holds at once; a value produced while it is full replaces the newest one
+#define DELAY_QUEUE_SIZE 32
+// How often generated waves other than square move to their next value
+#define LFO_STEP_MS 40
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+
+typedef struct {
+  uint32_t due_ms;
+  uint32_t origin_ms;
+  uint8_t value;
+} DelayedValue;
+
+typedef struct {
+  RouterOperator config;
+  // Delay: values waiting for their time, oldest first
+  DelayedValue *queue;
+  uint8_t queue_first;
+  uint8_t queue_count;
+  // Sample and hold: value produced since the last sample. Pulse stretch: 0 waiting for the end
+  // of the pulse
+  bool has_value;
+  uint8_t value;
+  uint32_t origin_ms;
+  // Pulse stretch: end of the pulse. Sample and hold, LFO: start of the first period
+  uint32_t mark_ms;
+  // Generator: last value written
+  uint8_t last_value;
+  // Next time the operator needs to run
+  bool waiting;
+  uint32_t deadline_ms;
+} Operator;
+
+static Operator s_operators[ROUTER_MAX_ROUTES];
+static OperatorCallbacks s_callbacks;
+static AppTimer *s_timer;
+
+static uint32_t prv_now_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+// Whether time a is at or after time b, across the wrap of the millisecond counter
+static bool prv_reached(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) >= 0;
+}
+
+static void prv_wait_until(Operator *op, uint32_t deadline_ms) {
+  op->waiting = true;
+  op->deadline_ms = deadline_ms;
+}
+
+// Start of the next period after now, periods counted from mark_ms
+static uint32_t prv_next_period(const Operator *op, uint32_t now_ms, uint32_t period_ms) {
+  return now_ms + period_ms - (now_ms - op->mark_ms) % period_ms;
+}
+
+/********************************* Generators *********************************/
+
+static uint8_t prv_wave_value(const Operator *op, uint32_t now_ms) {
+  const uint32_t period = op->config.period_ms;
+  const uint32_t phase = (now_ms - op->mark_ms) % period;
+  switch (op->config.wave) {
+    case RouterWaveSaw:
+      return phase * 255 / MAX(period - 1, 1);
+    case RouterWaveSine:
+      return 128 + sin_lookup(phase * TRIG_MAX_ANGLE / period) * 127 / TRIG_MAX_RATIO;
+    case RouterWaveSquare:
+    default:
+      return (phase < period / 2) ? 255 : 0;
+  }
+}
+
+static void prv_run_generator(int route_idx, Operator *op, uint32_t now_ms) {
+  const uint8_t value = prv_wave_value(op, now_ms);
+  if (value != op->last_value) {
+    op->last_value = value;
+    s_callbacks.emit(route_idx, value, now_ms);
+  }
+
+  const uint32_t period = op->config.period_ms;
+  if (op->config.wave == RouterWaveSquare) {
+    // Only the edges change anything
+    prv_wait_until(op, prv_next_period(op, now_ms, MAX(period / 2, 1)));
+  } else {
+    prv_wait_until(op, now_ms + MIN(LFO_STEP_MS, MAX(period / 2, 1)));
+  }
+}
+
+/********************************* Scheduling *********************************/
+
+static void prv_run(int route_idx, Operator *op, uint32_t now_ms) {
+  op->waiting = false;
+  switch (op->config.type) {
+    case RouterOperatorDelay:
+      while (op->queue_count && prv_reached(now_ms, op->queue[op->queue_first].due_ms)) {
+        const DelayedValue *delayed = &op->queue[op->queue_first];
+        op->queue_first = (op->queue_first + 1) % DELAY_QUEUE_SIZE;
+        op->queue_count--;
+        s_callbacks.emit(route_idx, delayed->value, delayed->origin_ms);
+      }
+      if (op->queue_count) {
+        prv_wait_until(op, op->queue[op->queue_first].due_ms);
+      }
+      break;
+    case RouterOperatorSampleHold:
+    case RouterOperatorPulseStretch:
+      if (op->has_value) {
+        op->has_value = false;
+        s_callbacks.emit(route_idx, op->value, op->origin_ms);
+      }
+      break;
+    case RouterOperatorLfo:
+      prv_run_generator(route_idx, op, now_ms);
+      break;
+    default:
+      break;
+  }
+}
+
+static void prv_schedule(uint32_t now_ms);
+
+static void prv_timer_callback(void *context) {
+  s_timer = NULL;
+  const uint32_t now = prv_now_ms();
+  for (int r = 0; r < ROUTER_MAX_ROUTES; r++) {
+    Operator *op = &s_operators[r];
+    if (op->waiting && prv_reached(now, op->deadline_ms)) {
+      prv_run(r, op, now);
+    }
+  }
+  s_callbacks.flush();
+  prv_schedule(now);
+}
+
+// Sets the shared timer for the earliest deadline, or stops it when nothing is waiting
+static void prv_schedule(uint32_t now_ms) {
+  bool waiting = false;
+  uint32_t earliest = 0;
+  for (int r = 0; r < ROUTER_MAX_ROUTES; r++) {
+    const Operator *op = &s_operators[r];
+    if (op->waiting && (!waiting || !prv_reached(op->deadline_ms, earliest))) {
+      earliest = op->deadline_ms;
+      waiting = true;
+    }
+  }
+
+  if (!waiting) {
+    if (s_timer) {
+      app_timer_cancel(s_timer);
+      s_timer = NULL;
+    }
+    return;
+  }
+
+  const uint32_t timeout = prv_reached(now_ms, earliest) ? 0 : earliest - now_ms;
+  if (!s_timer || !app_timer_reschedule(s_timer, timeout)) {
+    s_timer = app_timer_register(timeout, prv_timer_callback, NULL);
+  }
+}
+
+/*********************************** API **************************************/
+
+void operator_init(OperatorCallbacks callbacks) {
+  s_callbacks = callbacks;
+}
+
+void operator_deinit(void) {
+  operator_clear();
+}
+
+bool operator_configure(int route_idx, const RouterOperator *config) {
+  Operator *op = &s_operators[route_idx];
+  free(op->queue);
+  *op = (Operator) {
+    .config = *config,
+  };
+  op->config.period_ms = MAX(op->config.period_ms, 1);
+
+  if (config->type == RouterOperatorDelay) {
+    op->queue = malloc(DELAY_QUEUE_SIZE * sizeof(DelayedValue));
+    if (!op->queue) {
+      op->config.type = RouterOperatorNone;
+      return false;
+    }
+  }
+  return true;
+}
+
+void operator_clear(void) {
+  for (int r = 0; r < ROUTER_MAX_ROUTES; r++) {
+    free(s_operators[r].queue);
+    s_operators[r] = (Operator) { 0 };
+  }
+  prv_schedule(0);
+}
+
+void operator_start(uint32_t now_ms) {
+  for (int r = 0; r < ROUTER_MAX_ROUTES; r++) {
+    Operator *op = &s_operators[r];
+    op->queue_count = 0;
+    op->has_value = false;
+    op->waiting = false;
+    op->mark_ms = now_ms;
+    if (op->config.type == RouterOperatorLfo) {
+      // The first value of the wave goes out straight away
+      op->last_value = ~prv_wave_value(op, now_ms);
+      prv_wait_until(op, now_ms);
+    }
+  }
+  prv_schedule(now_ms);
+}
+
+void operator_feed(int route_idx, uint8_t value, uint32_t origin_ms) {
+  Operator *op = &s_operators[route_idx];
+  const uint32_t now = prv_now_ms();
+  const uint32_t period = op->config.period_ms;
+
+  switch (op->config.type) {
+    case RouterOperatorDelay:
+      if (op->queue_count == DELAY_QUEUE_SIZE) {
+        DelayedValue *newest = &op->queue[(op->queue_first + op->queue_count - 1) % DELAY_QUEUE_SIZE];
+        newest->value = value;
+        newest->origin_ms = origin_ms;
+        return;
+      }
+      op->queue[(op->queue_first + op->queue_count) % DELAY_QUEUE_SIZE] = (DelayedValue) {
+        .due_ms = now + period,
+        .origin_ms = origin_ms,
+        .value = value,
+      };
+      if (op->queue_count++) {
+        // The timer is already set for an older value
+        return;
+      }
+      prv_wait_until(op, now + period);
+      break;
+    case RouterOperatorSampleHold:
+      op->has_value = true;
+      op->value = value;
+      op->origin_ms = origin_ms;
+      if (op->waiting) {
+        return;
+      }
+      prv_wait_until(op, prv_next_period(op, now, period));
+      break;
+    case RouterOperatorPulseStretch:
+      if (value || prv_reached(now, op->mark_ms)) {
+        if (value) {
+          op->mark_ms = now + period;
+        }
+        op->has_value = false;
+        op->waiting = false;
+        s_callbacks.emit(route_idx, value, origin_ms);
+      } else {
+        // The pulse is not over yet
+        op->has_value = true;
+        op->value = 0;
+        op->origin_ms = origin_ms;
+        if (op->waiting) {
+          return;
+        }
+        prv_wait_until(op, op->mark_ms);
+      }
+      break;
+    case RouterOperatorLfo:
+      // Generators ignore the inputs
+      return;
+    default:
+      s_callbacks.emit(route_idx, value, origin_ms);
+      return;
+  }
+  prv_schedule(now);
+}
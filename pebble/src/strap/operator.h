@@ -0,0 +1,47 @@
+#pragma once
+
+#include <pebble.h>
+#include "router.h"
+
+// Time-based stage of the routes: delays, samples and stretches the values a route produces, or
+// generates them. Every operator runs from one shared timer, set for the earliest thing any of them
+// has to do, so adding operators does not add wakeups.
+
+typedef struct OperatorCallbacks {
+  // Receives the values the operators let through
+  void (*emit)(int route_idx, uint8_t value, uint32_t origin_ms);
+  // Called once the values due on a wakeup of the timer are all emitted
+  void (*flush)(void);
+} OperatorCallbacks;
+
+/*
+ * Sets where the operators send their values
+ */
+void operator_init(OperatorCallbacks callbacks);
+
+/*
+ * Removes every operator and stops the timer
+ */
+void operator_deinit(void);
+
+/*
+ * Sets the operator of a route, replacing any previous one
+ *  returns: false if the operator's state could not be allocated
+ */
+bool operator_configure(int route_idx, const RouterOperator *config);
+
+/*
+ * Removes every operator
+ */
+void operator_clear(void);
+
+/*
+ * Restarts every operator: values still waiting are forgotten and generators start their wave
+ */
+void operator_start(uint32_t now_ms);
+
+/*
+ * Hands an operator a value its route produced
+ *  origin_ms: when the input change behind the value was notified
+ */
+void operator_feed(int route_idx, uint8_t value, uint32_t origin_ms);
@@ -0,0 +1,118 @@
+#include <pebble.h>
+#include "recipe.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+#define RECIPE_MAX_LENGTH (RECIPE_HEADER_LENGTH + ROUTER_MAX_ROUTES * RECIPE_ROUTE_LENGTH)
+
+_Static_assert(RECIPE_MAX_LENGTH <= PERSIST_DATA_MAX_LENGTH, "a recipe fits in one persistent key");
+
+// Route length saved by each version, indexed by version. Add an entry with every new version
+static const uint8_t s_route_lengths[] = {
+  [1] = 17,
+};
+
+_Static_assert(ARRAY_LENGTH(s_route_lengths) == RECIPE_VERSION + 1, "every version has a route length");
+_Static_assert(RECIPE_ROUTE_LENGTH == 17, "the current route length is listed above");
+
+static void prv_write_uint16(uint8_t *data, uint16_t value) {
+  data[0] = value & 0xff;
+  data[1] = value >> 8;
+}
+
+static uint16_t prv_read_uint16(const uint8_t *data) {
+  return data[0] | (data[1] << 8);
+}
+
+static void prv_write_route(uint8_t *data, const RouterRouteConfig *route) {
+  data[0] = route->inputs;
+  data[1] = route->outputs;
+  data[2] = route->combine;
+  data[3] = route->transform.type;
+  data[4] = route->transform.threshold;
+  data[5] = route->transform.threshold_high;
+  data[6] = route->transform.binary;
+  prv_write_uint16(&data[7], route->transform.gain);
+  prv_write_uint16(&data[9], route->transform.offset);
+  data[11] = route->transform.steepness;
+  data[12] = route->transform.steps;
+  data[13] = route->operator.type;
+  prv_write_uint16(&data[14], route->operator.period_ms);
+  data[16] = route->operator.wave;
+}
+
+static void prv_read_route(const uint8_t *data, RouterRouteConfig *route) {
+  *route = (RouterRouteConfig) {
+    .inputs = data[0],
+    .outputs = data[1],
+    .combine = data[2],
+    .transform = {
+      .type = data[3],
+      .threshold = data[4],
+      .threshold_high = data[5],
+      .binary = data[6],
+      .gain = (int16_t)prv_read_uint16(&data[7]),
+      .offset = (int16_t)prv_read_uint16(&data[9]),
+      .steepness = (int8_t)data[11],
+      .steps = data[12],
+    },
+    .operator = {
+      .type = data[13],
+      .period_ms = prv_read_uint16(&data[14]),
+      .wave = data[16],
+    },
+  };
+}
+
+// Enum bytes come from storage, which may hold anything
+static bool prv_is_route_valid(const RouterRouteConfig *route) {
+  return route->combine <= RouterCombineMin &&
+         route->transform.type <= RouterTransformQuantize &&
+         route->operator.type <= RouterOperatorLfo &&
+         route->operator.wave <= RouterWaveSine;
+}
+
+bool recipe_save(const Recipe *recipe) {
+  uint8_t data[RECIPE_MAX_LENGTH];
+  const int num_routes = MIN(recipe->num_routes, ROUTER_MAX_ROUTES);
+  data[0] = RECIPE_VERSION;
+  data[1] = num_routes;
+  data[2] = recipe->sample_rate_idx;
+  data[3] = recipe->response_idx;
+  for (int r = 0; r < num_routes; r++) {
+    prv_write_route(&data[RECIPE_HEADER_LENGTH + r * RECIPE_ROUTE_LENGTH], &recipe->routes[r]);
+  }
+
+  const int length = RECIPE_HEADER_LENGTH + num_routes * RECIPE_ROUTE_LENGTH;
+  return persist_write_data(RECIPE_PERSIST_KEY, data, length) == length;
+}
+
+bool recipe_load(Recipe *recipe) {
+  uint8_t data[RECIPE_MAX_LENGTH];
+  const int length = persist_read_data(RECIPE_PERSIST_KEY, data, sizeof(data));
+  if (length < RECIPE_HEADER_LENGTH || data[0] == 0 || data[0] > RECIPE_VERSION ||
+      data[1] > ROUTER_MAX_ROUTES) {
+    return false;
+  }
+  const int route_length = s_route_lengths[data[0]];
+  if (length != RECIPE_HEADER_LENGTH + data[1] * route_length) {
+    return false;
+  }
+
+  RouterRouteConfig routes[ROUTER_MAX_ROUTES];
+  for (int r = 0; r < data[1]; r++) {
+    // Fields newer than the saved version read as 0
+    uint8_t route_data[RECIPE_ROUTE_LENGTH] = { 0 };
+    memcpy(route_data, &data[RECIPE_HEADER_LENGTH + r * route_length], route_length);
+    prv_read_route(route_data, &routes[r]);
+    if (!prv_is_route_valid(&routes[r])) {
+      return false;
+    }
+  }
+
+  recipe->num_routes = data[1];
+  recipe->sample_rate_idx = data[2];
+  recipe->response_idx = data[3];
+  memcpy(recipe->routes, routes, data[1] * sizeof(RouterRouteConfig));
+  return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <pebble.h>
+#include "router.h"
+
+// The routes the user built and the strap settings they picked, saved under one persistent key so
+// the next launch can start routing before its UI loads.
+//
+// Saved layout, little endian:
+//  [0] RECIPE_VERSION
+//  [1] number of routes
+//  [2] sample rate index
+//  [3] response index
+//  [4..] routes, RECIPE_ROUTE_LENGTH bytes each:
+//    [0] inputs
+//    [1] outputs
+//    [2] RouterCombine
+//    [3] RouterTransformType
+//    [4] threshold
+//    [5] threshold_high
+//    [6] binary
+//    [7..8] gain
+//    [9..10] offset
+//    [11] steepness
+//    [12] steps
+//    [13] RouterOperatorType
+//    [14..15] period_ms
+//    [16] RouterWave
+// Fields are only ever appended to a route, with a new version, so every earlier version can be
+// loaded: fields it did not save read as 0, which must keep the behaviour they had before.
+
+#define RECIPE_PERSIST_KEY 0x5100
+#define RECIPE_VERSION 1
+#define RECIPE_HEADER_LENGTH 4
+#define RECIPE_ROUTE_LENGTH 17
+
+typedef struct Recipe {
+  RouterRouteConfig routes[ROUTER_MAX_ROUTES];
+  uint8_t num_routes;
+  // Indices into the app's sample rate and response tables
+  uint8_t sample_rate_idx;
+  uint8_t response_idx;
+} Recipe;
+
+/*
+ * Saves a recipe, replacing the previous one
+ *  returns: false if storage failed
+ */
+bool recipe_save(const Recipe *recipe);
+
+/*
+ * Loads the saved recipe
+ *  returns: false, leaving recipe untouched, if there is none or it cannot be read
+ */
+bool recipe_load(Recipe *recipe);
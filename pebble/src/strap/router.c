@@ -0,0 +1,1045 @@
+#include <pebble.h>
+#include "router.h"
+#include "strap_protocol.h"
+#include "telemetry.h"
+#include "transform.h"
+#include "operator.h"
+#include "../log/binlog.h"
+
+#define NO_ROUTE -1
+
+// Attribute IDs are small, so notifies and completions are dispatched through a flat table
+#define ATTRIBUTE_INDEX_SIZE 16
+#define NO_CHANNEL -1
+
+// Longest payload of a control write
+#define CONTROL_MAX_LENGTH STRAP_LOCAL_ROUTES_MAX_LENGTH
+
+// The firmware runs the routes by itself this long after the watch last renewed its lease, so
+// they keep running once the app is closed
+#define LOCAL_ROUTES_LEASE_MS 5000
+#define LOCAL_ROUTES_RENEW_MS 2000
+
+// A transfer that failed on the strap side (timed out, or answered with an error) is attempted
+// again this many times before it is given up
+#define TRANSFER_MAX_RETRIES 3
+// Work left behind by a busy strap is retried after this long if no transfer completes first
+#define RETRY_INTERVAL_MS 20
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+
+typedef struct {
+  SmartstrapAttribute *attribute;
+  bool read_in_flight;
+  // A notify arrived (or a read could not be issued) and the attribute still has to be read
+  bool read_pending;
+  // Time of the oldest notify that has not been answered by a read yet
+  uint32_t notified_ms;
+  uint32_t in_flight_notified_ms;
+  // Failed reads in a row
+  uint8_t retries;
+} RouterReader;
+
+typedef struct {
+  RouterReader reader;
+
+  // Last value read, used by routes that merge several inputs
+  bool has_value;
+  uint8_t value;
+} RouterInput;
+
+// The all-inputs attribute delivers every input in one read. Per-input attributes are only used
+// with firmware that does not support it.
+typedef struct {
+  RouterReader reader;
+  bool unsupported;
+  bool has_sequence;
+  uint16_t sequence;
+  uint32_t timestamp_ms;
+} RouterFrame;
+
+// Sample blocks delivered by the firmware in streaming mode
+typedef struct {
+  RouterReader reader;
+  bool has_sequence;
+  uint16_t sequence;
+} RouterStream;
+
+typedef struct {
+  SmartstrapAttribute *attribute;
+  bool write_in_flight;
+  uint8_t in_flight_value;
+  int8_t in_flight_route;
+  uint32_t in_flight_origin_ms;
+
+  // Latest value waiting for the in-flight write to complete. Older values are dropped.
+  bool has_pending;
+  uint8_t pending_value;
+  int8_t pending_route;
+  uint32_t pending_origin_ms;
+  // Times the pending value was already sent without being acknowledged
+  uint8_t pending_retries;
+  uint8_t in_flight_retries;
+} RouterOutput;
+
+// The all-outputs attribute carries every pending output value in one write. Per-output attributes
+// are only used with firmware that does not support it.
+typedef struct {
+  SmartstrapAttribute *attribute;
+  bool write_in_flight;
+  bool unsupported;
+} RouterOutputBatch;
+
+// Writes that configure the firmware rather than drive an output
+typedef struct {
+  SmartstrapAttribute *attribute;
+  bool has_pending;
+  // The firmware answered AttributeUnsupported before acknowledging any write, nothing more is sent
+  bool unsupported;
+  // The firmware acknowledged a write, so a later AttributeUnsupported rejects the data rather than
+  // the attribute. Should the first write fail to start, the first answer may be to real data
+  bool accepted;
+  // Failed writes of the current data
+  uint8_t retries;
+  size_t length;
+  uint8_t data[CONTROL_MAX_LENGTH];
+} RouterControl;
+
+static RouterInput s_inputs[STRAP_NUM_CHANNELS];
+static RouterOutput s_outputs[STRAP_NUM_CHANNELS];
+static RouterFrame s_frame;
+static RouterOutputBatch s_output_batch;
+static RouterStream s_stream;
+static RouterControl s_stream_config;
+static RouterControl s_notify_config;
+static RouterControl s_local_routes;
+
+static RouterRouteConfig s_routes[ROUTER_MAX_ROUTES];
+static int s_num_routes;
+static RouterRouteStats s_route_stats[ROUTER_MAX_ROUTES];
+// Transform of each route, compiled to a table indexed by the merged input value
+static uint8_t s_route_luts[ROUTER_MAX_ROUTES][TRANSFORM_LUT_SIZE];
+// Mask of the routes whose table holds TRANSFORM_HOLD, and the value each route last produced
+static uint8_t s_route_holds;
+static uint8_t s_route_values[ROUTER_MAX_ROUTES];
+
+// Compiled route table: the routes fed by each input
+static uint8_t s_input_routes[STRAP_NUM_CHANNELS][ROUTER_MAX_ROUTES];
+static uint8_t s_input_num_routes[STRAP_NUM_CHANNELS];
+
+// Channel index of every input and output attribute, keyed by attribute ID
+static int8_t s_attribute_channels[ATTRIBUTE_INDEX_SIZE];
+
+// Input whose pending read is serviced first next time, so every input gets its turn
+static int s_next_input_read;
+static AppTimer *s_retry_timer;
+static AppTimer *s_lease_timer;
+// A transfer could not start because no strap is attached. Pending work then waits for the strap
+// to become available rather than for the retry timer
+static bool s_strap_unavailable;
+
+static uint32_t prv_now_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+static int prv_get_channel_index(SmartstrapAttribute *attribute) {
+  SmartstrapAttributeId attribute_id = smartstrap_attribute_get_attribute_id(attribute);
+  if (attribute_id >= ATTRIBUTE_INDEX_SIZE) {
+    return NO_CHANNEL;
+  }
+  return s_attribute_channels[attribute_id];
+}
+
+static SmartstrapAttribute* prv_create_attribute(SmartstrapAttributeId attribute_id, int channel_idx,
+                                                 size_t length) {
+  s_attribute_channels[attribute_id] = channel_idx;
+  return smartstrap_attribute_create(STRAP_SERVICE_ID, attribute_id, length);
+}
+
+static void prv_record(TelemetryEventType type, SmartstrapAttribute *attribute, SmartstrapResult result,
+                       uint8_t value) {
+  telemetry_record(type, smartstrap_attribute_get_attribute_id(attribute), result, value);
+}
+
+static uint16_t prv_read_uint16(const uint8_t *data) {
+  return data[0] | (data[1] << 8);
+}
+
+static uint32_t prv_read_uint32(const uint8_t *data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/********************************** Stats *************************************/
+
+static void prv_count_dropped(int route_idx) {
+  if (route_idx != NO_ROUTE) {
+    s_route_stats[route_idx].dropped++;
+  }
+}
+
+static void prv_count_retry(int route_idx) {
+  if (route_idx != NO_ROUTE) {
+    s_route_stats[route_idx].retries++;
+  }
+}
+
+static void prv_count_delivered(int route_idx, uint32_t origin_ms) {
+  if (route_idx == NO_ROUTE) {
+    return;
+  }
+
+  RouterRouteStats *stats = &s_route_stats[route_idx];
+  uint32_t latency = prv_now_ms() - origin_ms;
+  stats->samples++;
+  stats->latency_last_ms = latency;
+  stats->latency_total_ms += latency;
+  if (latency > stats->latency_max_ms) {
+    stats->latency_max_ms = latency;
+  }
+}
+
+/********************************** Output ************************************/
+
+// Sorts out a transfer that could not be started
+//  returns: true if it is worth trying again later
+static bool prv_should_retry_begin(SmartstrapResult result) {
+  if (result == SmartstrapResultNotPresent || result == SmartstrapResultServiceUnavailable) {
+    s_strap_unavailable = true;
+    return true;
+  }
+  return result == SmartstrapResultBusy;
+}
+
+// Starts a write. A busy strap is not an error: the caller keeps the data and tries again later.
+static SmartstrapResult prv_write_attribute(SmartstrapAttribute *attribute, const uint8_t *data,
+                                            size_t data_length) {
+  SmartstrapResult result;
+  uint8_t *buffer;
+  size_t length;
+  result = smartstrap_attribute_begin_write(attribute, &buffer, &length);
+  if (result != SmartstrapResultOk) {
+    prv_record(TelemetryEventBusy, attribute, result, data[0]);
+    if (result != SmartstrapResultBusy) {
+      BINLOG_ERROR(BinlogEventBeginWriteFailed, smartstrap_attribute_get_attribute_id(attribute), result);
+    }
+    return result;
+  }
+
+  s_strap_unavailable = false;
+  memcpy(buffer, data, data_length);
+
+  result = smartstrap_attribute_end_write(attribute, data_length, false);
+  if (result != SmartstrapResultOk && result != SmartstrapResultBusy) {
+    BINLOG_ERROR(BinlogEventEndWriteFailed, smartstrap_attribute_get_attribute_id(attribute), result);
+  }
+  prv_record(result == SmartstrapResultOk ? TelemetryEventWriteBegin : TelemetryEventBusy, attribute,
+             result, data[0]);
+  return result;
+}
+
+// Moves the pending value of an output in flight, returning it
+static uint8_t prv_take_pending(RouterOutput *output) {
+  output->has_pending = false;
+  output->write_in_flight = true;
+  output->in_flight_route = output->pending_route;
+  output->in_flight_origin_ms = output->pending_origin_ms;
+  output->in_flight_value = output->pending_value;
+  output->in_flight_retries = output->pending_retries;
+  return output->in_flight_value;
+}
+
+// Puts the in-flight value back in the pending slot, unless a newer value already took it
+static void prv_requeue_in_flight(RouterOutput *output) {
+  output->write_in_flight = false;
+  if (output->has_pending) {
+    prv_count_dropped(output->in_flight_route);
+    return;
+  }
+  output->has_pending = true;
+  output->pending_value = output->in_flight_value;
+  output->pending_route = output->in_flight_route;
+  output->pending_origin_ms = output->in_flight_origin_ms;
+  output->pending_retries = output->in_flight_retries;
+}
+
+// Handles a write that could not be started
+static void prv_fail_in_flight(RouterOutput *output, SmartstrapResult result) {
+  if (result == SmartstrapResultBusy) {
+    prv_requeue_in_flight(output);
+    return;
+  }
+  output->write_in_flight = false;
+  prv_count_dropped(output->in_flight_route);
+}
+
+static void prv_flush_output_batch(void) {
+  if (s_output_batch.write_in_flight) {
+    return;
+  }
+
+  uint8_t data[STRAP_ALL_OUTPUTS_LENGTH] = { 0 };
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    if (s_outputs[i].has_pending) {
+      data[0] |= ROUTER_CHANNEL(i);
+      data[1 + i] = prv_take_pending(&s_outputs[i]);
+    }
+  }
+  if (!data[0]) {
+    return;
+  }
+
+  SmartstrapResult result = prv_write_attribute(s_output_batch.attribute, data, sizeof(data));
+  if (result == SmartstrapResultOk) {
+    s_output_batch.write_in_flight = true;
+    return;
+  }
+
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    if (data[0] & ROUTER_CHANNEL(i)) {
+      prv_fail_in_flight(&s_outputs[i], result);
+    }
+  }
+}
+
+static void prv_flush_control(RouterControl *control) {
+  if (!control->has_pending || control->unsupported) {
+    return;
+  }
+
+  const SmartstrapResult result = prv_write_attribute(control->attribute, control->data, control->length);
+  if (result == SmartstrapResultOk) {
+    control->has_pending = false;
+  } else if (!prv_should_retry_begin(result) && ++control->retries > TRANSFER_MAX_RETRIES) {
+    control->has_pending = false;
+  }
+}
+
+static void prv_set_control_pending(RouterControl *control) {
+  control->has_pending = !control->unsupported;
+  control->retries = 0;
+}
+
+// Handles the ACK of a control write, returning false if it was not one
+static bool prv_complete_control(SmartstrapAttribute *attribute, SmartstrapResult result) {
+  RouterControl *control = NULL;
+  if (attribute == s_stream_config.attribute) {
+    control = &s_stream_config;
+  } else if (attribute == s_notify_config.attribute) {
+    control = &s_notify_config;
+  } else if (attribute == s_local_routes.attribute) {
+    control = &s_local_routes;
+  } else {
+    return false;
+  }
+
+  if (result == SmartstrapResultOk) {
+    control->accepted = true;
+  } else if (result == SmartstrapResultAttributeUnsupported) {
+    if (control->accepted) {
+      // Retrying the same data would be rejected again; the next change is still written
+      BINLOG_ERROR(BinlogEventControlRejected, smartstrap_attribute_get_attribute_id(attribute));
+    } else {
+      // Older firmware
+      control->unsupported = true;
+      control->has_pending = false;
+    }
+    return true;
+  }
+
+  // Data changed since the write went out is already pending
+  if (result != SmartstrapResultOk && !control->has_pending && control->retries < TRANSFER_MAX_RETRIES) {
+    control->has_pending = true;
+    control->retries++;
+    prv_record(TelemetryEventRetry, attribute, result, control->data[0]);
+  }
+  return true;
+}
+
+// Writes every pending output value that is not waiting behind an in-flight write
+static void prv_flush_outputs(void) {
+  prv_flush_control(&s_stream_config);
+  prv_flush_control(&s_notify_config);
+  prv_flush_control(&s_local_routes);
+
+  if (!s_output_batch.unsupported) {
+    prv_flush_output_batch();
+    return;
+  }
+
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    RouterOutput *output = &s_outputs[i];
+    if (output->has_pending && !output->write_in_flight) {
+      uint8_t value = prv_take_pending(output);
+      SmartstrapResult result = prv_write_attribute(output->attribute, &value, STRAP_ATTRIBUTE_LENGTH);
+      if (result != SmartstrapResultOk) {
+        prv_fail_in_flight(output, result);
+      }
+    }
+  }
+}
+
+// Queues a value for an output. Nothing is sent until prv_flush_outputs() so that values produced
+// together share one write.
+static void prv_submit_output(int output_idx, uint8_t value, int route_idx, uint32_t origin_ms) {
+  RouterOutput *output = &s_outputs[output_idx];
+
+  // Only the newest value matters; whatever was waiting is now stale
+  if (output->has_pending) {
+    prv_count_dropped(output->pending_route);
+  }
+  output->has_pending = true;
+  output->pending_value = value;
+  output->pending_route = route_idx;
+  output->pending_origin_ms = origin_ms;
+  output->pending_retries = 0;
+}
+
+static void prv_complete_output(RouterOutput *output, SmartstrapResult result) {
+  if (result == SmartstrapResultOk) {
+    output->write_in_flight = false;
+    prv_count_delivered(output->in_flight_route, output->in_flight_origin_ms);
+  } else if (result != SmartstrapResultAttributeUnsupported &&
+             output->in_flight_retries < TRANSFER_MAX_RETRIES && !output->has_pending) {
+    // The output may still hold an older value, so the write goes out again
+    output->in_flight_retries++;
+    prv_count_retry(output->in_flight_route);
+    prv_record(TelemetryEventRetry, output->attribute, result, output->in_flight_value);
+    prv_requeue_in_flight(output);
+  } else {
+    output->write_in_flight = false;
+    prv_count_dropped(output->in_flight_route);
+  }
+}
+
+/********************************** Routes ************************************/
+
+// Transforms a value the route's operator let through and hands it to the outputs
+static void prv_emit_route(int route_idx, uint8_t value, uint32_t origin_ms) {
+  const RouterRouteConfig *route = &s_routes[route_idx];
+
+  value = s_route_luts[route_idx][value];
+  if ((s_route_holds & (1 << route_idx)) && value == TRANSFORM_HOLD) {
+    value = s_route_values[route_idx];
+  }
+  s_route_values[route_idx] = value;
+
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    if (route->outputs & ROUTER_CHANNEL(i)) {
+      prv_submit_output(i, value, route_idx, origin_ms);
+    }
+  }
+}
+
+static void prv_run_route(int route_idx, uint32_t origin_ms) {
+  const RouterRouteConfig *route = &s_routes[route_idx];
+
+  // Merge every input of the route that has been read at least once
+  bool has_value = false;
+  uint8_t value = 0;
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    if (!(route->inputs & ROUTER_CHANNEL(i)) || !s_inputs[i].has_value) {
+      continue;
+    }
+    uint8_t input_value = s_inputs[i].value;
+    if (!has_value ||
+        (route->combine == RouterCombineMax && input_value > value) ||
+        (route->combine == RouterCombineMin && input_value < value)) {
+      value = input_value;
+    }
+    has_value = true;
+  }
+  if (!has_value) {
+    return;
+  }
+
+  if (route->operator.type == RouterOperatorNone) {
+    prv_emit_route(route_idx, value, origin_ms);
+  } else {
+    operator_feed(route_idx, value, origin_ms);
+  }
+}
+
+// Hands the route table to the firmware along with a lease. Generated waves need the watch, so LFO
+// routes are left out, and the other routes lose their operator.
+static void prv_write_local_routes(uint16_t lease_ms) {
+  uint8_t *data = s_local_routes.data;
+  data[0] = lease_ms & 0xff;
+  data[1] = lease_ms >> 8;
+  data[2] = 0;
+
+  uint8_t *route_data = &data[STRAP_LOCAL_ROUTES_HEADER_LENGTH];
+  for (int r = 0; r < s_num_routes && data[2] < STRAP_LOCAL_ROUTES_MAX; r++) {
+    const RouterRouteConfig *route = &s_routes[r];
+    if (route->operator.type == RouterOperatorLfo) {
+      continue;
+    }
+    const RouterTransform *transform = &route->transform;
+    route_data[0] = route->inputs;
+    route_data[1] = route->outputs;
+    route_data[2] = route->combine;
+    route_data[3] = transform->type;
+    route_data[4] = transform->threshold;
+    route_data[5] = transform->threshold_high;
+    route_data[6] = transform->binary;
+    route_data[7] = transform->steps;
+    route_data[8] = (uint8_t)transform->steepness;
+    route_data[9] = (uint16_t)transform->gain & 0xff;
+    route_data[10] = (uint16_t)transform->gain >> 8;
+    route_data[11] = (uint16_t)transform->offset & 0xff;
+    route_data[12] = (uint16_t)transform->offset >> 8;
+    route_data += STRAP_LOCAL_ROUTE_LENGTH;
+    data[2]++;
+  }
+  s_local_routes.length = route_data - data;
+  prv_set_control_pending(&s_local_routes);
+}
+
+/********************************** Input *************************************/
+
+static bool prv_begin_read(RouterReader *reader) {
+  SmartstrapResult result = smartstrap_attribute_read(reader->attribute);
+  if (result != SmartstrapResultOk) {
+    prv_record(TelemetryEventBusy, reader->attribute, result, 0);
+    if (!prv_should_retry_begin(result)) {
+      // The next notify asks again
+      reader->read_pending = false;
+    }
+    return false;
+  }
+  s_strap_unavailable = false;
+  prv_record(TelemetryEventReadBegin, reader->attribute, result, 0);
+
+  reader->read_in_flight = true;
+  reader->read_pending = false;
+  reader->in_flight_notified_ms = reader->notified_ms;
+  return true;
+}
+
+// Handles a failed read. The value on the strap may have changed since the last good read, so the
+// read is attempted again, for the same notify, unless a newer notify already asked for one.
+static void prv_retry_read(RouterReader *reader, SmartstrapResult result) {
+  if (result == SmartstrapResultAttributeUnsupported || reader->read_pending ||
+      reader->retries >= TRANSFER_MAX_RETRIES) {
+    reader->retries = 0;
+    return;
+  }
+  reader->retries++;
+  reader->read_pending = true;
+  prv_record(TelemetryEventRetry, reader->attribute, result, 0);
+  reader->notified_ms = reader->in_flight_notified_ms;
+}
+
+// Marks the attribute for reading. Returns false if a read was already pending, in which case the
+// notify is coalesced into it.
+static bool prv_request_read(RouterReader *reader, uint32_t notified_ms) {
+  bool coalesced = reader->read_pending;
+  if (!coalesced) {
+    reader->notified_ms = notified_ms;
+    reader->read_pending = true;
+  }
+
+  if (!reader->read_in_flight) {
+    prv_begin_read(reader);
+  }
+  return !coalesced;
+}
+
+// Issues the reads that were deferred while the strap was busy. Inputs take turns, otherwise a
+// busy top input would keep the others from ever being read.
+static void prv_service_pending_reads(void) {
+  RouterReader *block_readers[] = { &s_stream.reader, &s_frame.reader };
+  for (size_t i = 0; i < ARRAY_LENGTH(block_readers); i++) {
+    RouterReader *reader = block_readers[i];
+    if (reader->read_pending && !reader->read_in_flight) {
+      if (!prv_begin_read(reader)) {
+        return;
+      }
+    }
+  }
+
+  for (int n = 0; n < STRAP_NUM_CHANNELS; n++) {
+    int input_idx = (s_next_input_read + n) % STRAP_NUM_CHANNELS;
+    RouterReader *reader = &s_inputs[input_idx].reader;
+    if (reader->read_pending && !reader->read_in_flight) {
+      if (!prv_begin_read(reader)) {
+        return;
+      }
+      s_next_input_read = (input_idx + 1) % STRAP_NUM_CHANNELS;
+    }
+  }
+}
+
+static bool prv_has_pending_work(void) {
+  if (s_stream_config.has_pending || s_notify_config.has_pending || s_local_routes.has_pending) {
+    return true;
+  }
+  if (s_stream.reader.read_pending || s_frame.reader.read_pending) {
+    return true;
+  }
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    if (s_outputs[i].has_pending || s_inputs[i].reader.read_pending) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void prv_retry_timer_callback(void *context);
+
+// Writes whatever is pending, then reads. Anything the strap was too busy to take is retried on
+// the next completed transfer, or by a timer should none come. Without a strap, it waits for one.
+static void prv_service(void) {
+  prv_flush_outputs();
+  prv_service_pending_reads();
+
+  if (!s_retry_timer && !s_strap_unavailable && prv_has_pending_work()) {
+    s_retry_timer = app_timer_register(RETRY_INTERVAL_MS, prv_retry_timer_callback, NULL);
+  }
+}
+
+static void prv_retry_timer_callback(void *context) {
+  s_retry_timer = NULL;
+  prv_service();
+}
+
+// Renews the lease while the app runs; the firmware takes over once renewals stop
+static void prv_lease_timer_callback(void *context) {
+  s_lease_timer = NULL;
+  if (s_local_routes.unsupported) {
+    return;
+  }
+  prv_set_control_pending(&s_local_routes);
+  prv_service();
+  s_lease_timer = app_timer_register(LOCAL_ROUTES_RENEW_MS, prv_lease_timer_callback, NULL);
+}
+
+static void prv_request_input(int input_idx, uint32_t notified_ms) {
+  if (!prv_request_read(&s_inputs[input_idx].reader, notified_ms)) {
+    // The pending read returns the latest value, so every route loses a sample
+    for (int i = 0; i < s_input_num_routes[input_idx]; i++) {
+      prv_count_dropped(s_input_routes[input_idx][i]);
+    }
+  }
+}
+
+// Fetches every routed input, in one read if the firmware supports it
+static void prv_request_all_inputs(uint32_t notified_ms) {
+  if (!s_frame.unsupported) {
+    prv_request_read(&s_frame.reader, notified_ms);
+    return;
+  }
+
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    if (s_input_num_routes[i]) {
+      prv_request_read(&s_inputs[i].reader, notified_ms);
+    }
+  }
+}
+
+// Stores a new input value and returns the mask of routes that have to be re-evaluated
+static uint8_t prv_update_input(int input_idx, uint8_t value) {
+  RouterInput *input = &s_inputs[input_idx];
+  if (input->has_value && input->value == value) {
+    return 0;
+  }
+
+  input->has_value = true;
+  input->value = value;
+
+  uint8_t route_mask = 0;
+  for (int i = 0; i < s_input_num_routes[input_idx]; i++) {
+    route_mask |= (1 << s_input_routes[input_idx][i]);
+  }
+  return route_mask;
+}
+
+static void prv_run_routes(uint8_t route_mask, uint32_t origin_ms) {
+  for (int r = 0; r < s_num_routes; r++) {
+    if (route_mask & (1 << r)) {
+      prv_run_route(r, origin_ms);
+    }
+  }
+  prv_flush_outputs();
+}
+
+static void prv_handle_frame(const uint8_t *data, uint32_t origin_ms) {
+  uint16_t sequence = prv_read_uint16(&data[STRAP_ALL_INPUTS_SEQUENCE_OFFSET]);
+  uint32_t timestamp_ms = prv_read_uint32(&data[STRAP_ALL_INPUTS_TIMESTAMP_OFFSET]);
+
+  uint8_t route_mask = 0;
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    route_mask |= prv_update_input(i, data[i]);
+  }
+
+  // Every notify bumps the sequence, so a gap means frames were overwritten before we read them.
+  // A timestamp going backwards means the firmware restarted.
+  if (s_frame.has_sequence && timestamp_ms >= s_frame.timestamp_ms && sequence != s_frame.sequence) {
+    uint16_t missed = sequence - s_frame.sequence - 1;
+    for (int r = 0; r < s_num_routes; r++) {
+      if (route_mask & (1 << r)) {
+        s_route_stats[r].dropped += missed;
+      }
+    }
+  }
+  s_frame.has_sequence = true;
+  s_frame.sequence = sequence;
+  s_frame.timestamp_ms = timestamp_ms;
+
+  prv_run_routes(route_mask, origin_ms);
+}
+
+static void prv_handle_stream_block(const uint8_t *data, size_t length, uint32_t origin_ms) {
+  uint16_t sequence = prv_read_uint16(&data[0]);
+  uint8_t num_samples = data[2];
+  uint8_t overflowed = data[3];
+  if (length != (size_t)(STRAP_STREAM_HEADER_LENGTH + num_samples * STRAP_STREAM_SAMPLE_LENGTH)) {
+    BINLOG_ERROR(BinlogEventStreamLength, length);
+    return;
+  }
+
+  // Samples lost on the strap side count against every route. A missed block is assumed full.
+  uint16_t missed = overflowed;
+  if (s_stream.has_sequence && sequence != (uint16_t)(s_stream.sequence + 1)) {
+    missed += STRAP_STREAM_MAX_SAMPLES * (uint16_t)(sequence - s_stream.sequence - 1);
+  }
+  s_stream.has_sequence = true;
+  s_stream.sequence = sequence;
+  for (int r = 0; r < s_num_routes; r++) {
+    s_route_stats[r].dropped += missed;
+  }
+
+  // Every sample goes through the routes; the outputs only keep the last one
+  const uint8_t *sample = &data[STRAP_STREAM_HEADER_LENGTH];
+  for (int n = 0; n < num_samples; n++, sample += STRAP_STREAM_SAMPLE_LENGTH) {
+    uint8_t route_mask = 0;
+    for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+      route_mask |= prv_update_input(i, sample[i]);
+    }
+    for (int r = 0; r < s_num_routes; r++) {
+      if (route_mask & (1 << r)) {
+        prv_run_route(r, origin_ms);
+      }
+    }
+  }
+  prv_flush_outputs();
+}
+
+/******************************** Smartstraps *********************************/
+
+static void strap_availability_handler(SmartstrapServiceId service_id, bool is_available) {
+  // A service's availability has changed
+  BINLOG_INFO(BinlogEventServiceAvailability, service_id, is_available);
+  if (is_available && s_strap_unavailable) {
+    s_strap_unavailable = false;
+    prv_service();
+  }
+}
+
+static void strap_notify_handler(SmartstrapAttribute *attribute) {
+  prv_record(TelemetryEventNotify, attribute, SmartstrapResultOk, 0);
+
+  if (smartstrap_attribute_get_attribute_id(attribute) == STRAP_STREAM_ATTRIBUTE_ID) {
+    // Blocks are read even without routes, otherwise the firmware keeps notifying
+    prv_request_read(&s_stream.reader, prv_now_ms());
+    return;
+  }
+
+  if (smartstrap_attribute_get_attribute_id(attribute) == STRAP_ALL_INPUTS_ATTRIBUTE_ID) {
+    if (s_num_routes) {
+      s_frame.unsupported = false;
+      prv_request_read(&s_frame.reader, prv_now_ms());
+    }
+    return;
+  }
+
+  int input_idx = prv_get_channel_index(attribute);
+  if (input_idx == NO_CHANNEL || !s_input_num_routes[input_idx]) {
+    return;
+  }
+
+  prv_request_input(input_idx, prv_now_ms());
+}
+
+static void strap_did_read(SmartstrapAttribute *attribute, SmartstrapResult result,
+                           const uint8_t *data, size_t length) {
+  prv_record(TelemetryEventReadEnd, attribute, result, length ? data[0] : 0);
+
+  if (smartstrap_attribute_get_attribute_id(attribute) == STRAP_STREAM_ATTRIBUTE_ID) {
+    s_stream.reader.read_in_flight = false;
+    if (result != SmartstrapResultOk) {
+      BINLOG_ERROR(BinlogEventReadFailed, STRAP_STREAM_ATTRIBUTE_ID, result);
+      prv_retry_read(&s_stream.reader, result);
+    } else if (length >= STRAP_STREAM_HEADER_LENGTH) {
+      s_stream.reader.retries = 0;
+      prv_handle_stream_block(data, length, s_stream.reader.in_flight_notified_ms);
+    }
+    prv_service();
+    return;
+  }
+
+  bool is_frame = smartstrap_attribute_get_attribute_id(attribute) == STRAP_ALL_INPUTS_ATTRIBUTE_ID;
+  int input_idx = prv_get_channel_index(attribute);
+  if (!is_frame && input_idx == NO_CHANNEL) {
+    return;
+  }
+
+  RouterReader *reader = is_frame ? &s_frame.reader : &s_inputs[input_idx].reader;
+  reader->read_in_flight = false;
+
+  size_t expected_length = is_frame ? STRAP_ALL_INPUTS_LENGTH : STRAP_ATTRIBUTE_LENGTH;
+  if (is_frame && result == SmartstrapResultAttributeUnsupported) {
+    // Older firmware: fall back to reading the inputs one by one
+    s_frame.unsupported = true;
+    prv_request_all_inputs(reader->in_flight_notified_ms);
+  } else if (result != SmartstrapResultOk) {
+    BINLOG_ERROR(BinlogEventReadFailed, smartstrap_attribute_get_attribute_id(attribute), result);
+    prv_retry_read(reader, result);
+  } else if (length != expected_length) {
+    BINLOG_ERROR(BinlogEventResponseLength, smartstrap_attribute_get_attribute_id(attribute), length);
+  } else if (is_frame) {
+    reader->retries = 0;
+    prv_handle_frame(data, reader->in_flight_notified_ms);
+  } else {
+    reader->retries = 0;
+    prv_run_routes(prv_update_input(input_idx, data[0]), reader->in_flight_notified_ms);
+  }
+
+  prv_service();
+}
+
+static void strap_did_write(SmartstrapAttribute *attribute, SmartstrapResult result) {
+  prv_record(TelemetryEventWriteEnd, attribute, result, 0);
+
+  if (result != SmartstrapResultOk && result != SmartstrapResultAttributeUnsupported) {
+    BINLOG_ERROR(BinlogEventWriteFailed, smartstrap_attribute_get_attribute_id(attribute), result);
+  }
+
+  if (smartstrap_attribute_get_attribute_id(attribute) == STRAP_ALL_OUTPUTS_ATTRIBUTE_ID) {
+    s_output_batch.write_in_flight = false;
+    for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+      RouterOutput *output = &s_outputs[i];
+      if (!output->write_in_flight) {
+        continue;
+      }
+      if (result == SmartstrapResultAttributeUnsupported && !output->has_pending) {
+        // Older firmware: resend the value through the per-output attribute
+        prv_requeue_in_flight(output);
+      } else {
+        prv_complete_output(output, result);
+      }
+    }
+    if (result == SmartstrapResultAttributeUnsupported) {
+      s_output_batch.unsupported = true;
+    }
+  } else if (!prv_complete_control(attribute, result)) {
+    int output_idx = prv_get_channel_index(attribute);
+    if (output_idx != NO_CHANNEL) {
+      prv_complete_output(&s_outputs[output_idx], result);
+    }
+  }
+
+  prv_service();
+}
+
+/************************************ API *************************************/
+
+void router_init(void) {
+  SmartstrapHandlers handlers = (SmartstrapHandlers) {
+    .availability_did_change = strap_availability_handler,
+    .did_read = strap_did_read,
+    .did_write = strap_did_write,
+    .notified = strap_notify_handler
+  };
+  smartstrap_subscribe(handlers);
+  operator_init((OperatorCallbacks) {
+    .emit = prv_emit_route,
+    .flush = prv_service,
+  });
+
+  for (int i = 0; i < ATTRIBUTE_INDEX_SIZE; i++) {
+    s_attribute_channels[i] = NO_CHANNEL;
+  }
+
+  static const SmartstrapAttributeId input_ids[STRAP_NUM_CHANNELS] = {
+    STRAP_TOP_INPUT_ATTRIBUTE_ID, STRAP_CENTER_INPUT_ATTRIBUTE_ID, STRAP_BOTTOM_INPUT_ATTRIBUTE_ID
+  };
+  static const SmartstrapAttributeId output_ids[STRAP_NUM_CHANNELS] = {
+    STRAP_TOP_OUTPUT_ATTRIBUTE_ID, STRAP_CENTER_OUTPUT_ATTRIBUTE_ID, STRAP_BOTTOM_OUTPUT_ATTRIBUTE_ID
+  };
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    s_inputs[i] = (RouterInput) {
+      .reader.attribute = prv_create_attribute(input_ids[i], i, STRAP_ATTRIBUTE_LENGTH),
+    };
+    s_outputs[i] = (RouterOutput) {
+      .attribute = prv_create_attribute(output_ids[i], i, STRAP_ATTRIBUTE_LENGTH),
+      .in_flight_route = NO_ROUTE,
+      .pending_route = NO_ROUTE,
+    };
+  }
+  s_frame = (RouterFrame) {
+    .reader.attribute = prv_create_attribute(STRAP_ALL_INPUTS_ATTRIBUTE_ID, NO_CHANNEL,
+                                             STRAP_ALL_INPUTS_LENGTH),
+  };
+  s_output_batch = (RouterOutputBatch) {
+    .attribute = prv_create_attribute(STRAP_ALL_OUTPUTS_ATTRIBUTE_ID, NO_CHANNEL,
+                                      STRAP_ALL_OUTPUTS_LENGTH),
+  };
+  s_stream = (RouterStream) {
+    .reader.attribute = prv_create_attribute(STRAP_STREAM_ATTRIBUTE_ID, NO_CHANNEL, STRAP_STREAM_LENGTH),
+  };
+  s_stream_config = (RouterControl) {
+    .attribute = prv_create_attribute(STRAP_STREAM_CONFIG_ATTRIBUTE_ID, NO_CHANNEL,
+                                      STRAP_STREAM_CONFIG_LENGTH),
+    .length = STRAP_STREAM_CONFIG_LENGTH,
+  };
+  s_notify_config = (RouterControl) {
+    .attribute = prv_create_attribute(STRAP_NOTIFY_CONFIG_ATTRIBUTE_ID, NO_CHANNEL,
+                                      STRAP_NOTIFY_CONFIG_LENGTH),
+    .length = STRAP_NOTIFY_CONFIG_LENGTH,
+  };
+  s_local_routes = (RouterControl) {
+    .attribute = prv_create_attribute(STRAP_LOCAL_ROUTES_ATTRIBUTE_ID, NO_CHANNEL,
+                                      STRAP_LOCAL_ROUTES_MAX_LENGTH),
+    .length = STRAP_LOCAL_ROUTES_HEADER_LENGTH,
+  };
+  // Firmware that knows the attribute accepts an empty table, so its answer tells older firmware
+  // apart from a rejected table later on. It goes out first, ahead of the table router_start()
+  // writes, and also stops the routes a previous run of the app left on the strap
+  prv_set_control_pending(&s_local_routes);
+  prv_flush_control(&s_local_routes);
+
+  router_clear_routes();
+
+  // The firmware may still be streaming for a previous run of the app
+  router_set_streaming(0, 0);
+}
+
+void router_deinit(void) {
+  // No write is sent here: the attributes are destroyed before it could complete. The firmware
+  // takes the routes over once the lease written by the last renewal runs out
+  if (s_retry_timer) {
+    app_timer_cancel(s_retry_timer);
+    s_retry_timer = NULL;
+  }
+  if (s_lease_timer) {
+    app_timer_cancel(s_lease_timer);
+    s_lease_timer = NULL;
+  }
+  operator_deinit();
+  smartstrap_unsubscribe();
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    smartstrap_attribute_destroy(s_inputs[i].reader.attribute);
+    smartstrap_attribute_destroy(s_outputs[i].attribute);
+  }
+  smartstrap_attribute_destroy(s_frame.reader.attribute);
+  smartstrap_attribute_destroy(s_output_batch.attribute);
+  smartstrap_attribute_destroy(s_stream.reader.attribute);
+  smartstrap_attribute_destroy(s_stream_config.attribute);
+  smartstrap_attribute_destroy(s_notify_config.attribute);
+  smartstrap_attribute_destroy(s_local_routes.attribute);
+}
+
+void router_clear_routes(void) {
+  s_num_routes = 0;
+  operator_clear();
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    s_input_num_routes[i] = 0;
+    s_inputs[i].reader.read_pending = false;
+  }
+  s_frame.reader.read_pending = false;
+}
+
+int router_add_route(RouterRouteConfig config) {
+  config.inputs &= ROUTER_ALL_CHANNELS;
+  config.outputs &= ROUTER_ALL_CHANNELS;
+  const bool generated = (config.operator.type == RouterOperatorLfo);
+  if (s_num_routes >= ROUTER_MAX_ROUTES || (!config.inputs && !generated) || !config.outputs ||
+      !operator_configure(s_num_routes, &config.operator)) {
+    return NO_ROUTE;
+  }
+
+  s_routes[s_num_routes] = config;
+  if (transform_compile(&config.transform, s_route_luts[s_num_routes])) {
+    s_route_holds |= 1 << s_num_routes;
+  } else {
+    s_route_holds &= ~(1 << s_num_routes);
+  }
+  return s_num_routes++;
+}
+
+void router_start(void) {
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    s_input_num_routes[i] = 0;
+    s_inputs[i].has_value = false;
+  }
+  for (int r = 0; r < s_num_routes; r++) {
+    for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+      if (s_routes[r].inputs & ROUTER_CHANNEL(i)) {
+        s_input_routes[i][s_input_num_routes[i]++] = r;
+      }
+    }
+    s_route_stats[r] = (RouterRouteStats) { 0 };
+    s_route_values[r] = 0;
+  }
+
+  // Outputs should reflect the inputs straight away rather than on the next change
+  const uint32_t now = prv_now_ms();
+  if (s_num_routes) {
+    prv_request_all_inputs(now);
+  }
+  operator_start(now);
+
+  prv_write_local_routes(LOCAL_ROUTES_LEASE_MS);
+  if (!s_lease_timer) {
+    s_lease_timer = app_timer_register(LOCAL_ROUTES_RENEW_MS, prv_lease_timer_callback, NULL);
+  }
+  prv_service();
+}
+
+void router_write_outputs(uint8_t outputs, uint8_t value) {
+  uint32_t now = prv_now_ms();
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    if (outputs & ROUTER_CHANNEL(i)) {
+      prv_submit_output(i, value, NO_ROUTE, now);
+    }
+  }
+  prv_service();
+}
+
+void router_set_streaming(uint8_t sample_period_ms, uint8_t samples_per_block) {
+  s_stream_config.data[0] = sample_period_ms;
+  s_stream_config.data[1] = MIN(MAX(samples_per_block, 1), STRAP_STREAM_MAX_SAMPLES);
+  prv_set_control_pending(&s_stream_config);
+  s_stream.has_sequence = false;
+  prv_service();
+}
+
+void router_set_notify_config(const RouterNotifyConfig *config) {
+  uint8_t *data = s_notify_config.data;
+  for (int i = 0; i < STRAP_NUM_CHANNELS; i++) {
+    const RouterNotifySchedule *schedule = &config->channels[i];
+    data[0] = schedule->deadband;
+    data[1] = schedule->min_interval_ms & 0xff;
+    data[2] = schedule->min_interval_ms >> 8;
+    data[3] = schedule->max_interval_ms & 0xff;
+    data[4] = schedule->max_interval_ms >> 8;
+    data += STRAP_NOTIFY_SCHEDULE_LENGTH;
+  }
+  data[0] = config->notifies_per_second;
+  data[1] = MAX(config->burst, 1);
+  prv_set_control_pending(&s_notify_config);
+  prv_service();
+}
+
+bool router_get_route_stats(int route_idx, RouterRouteStats *stats) {
+  if (route_idx < 0 || route_idx >= s_num_routes || !stats) {
+    return false;
+  }
+
+  *stats = s_route_stats[route_idx];
+  return true;
+}
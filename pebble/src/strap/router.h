@@ -0,0 +1,172 @@
+#pragma once
+
+#include <pebble.h>
+
+#define ROUTER_MAX_ROUTES 8
+
+// Channel masks for RouterRouteConfig
+#define ROUTER_CHANNEL(idx) (1 << (idx))
+#define ROUTER_ALL_CHANNELS 0x07
+
+// How a route merges its inputs when it has more than one
+typedef enum {
+  RouterCombineMax = 0,
+  RouterCombineMin,
+} RouterCombine;
+
+// How a route maps its merged input value to the value it writes
+typedef enum {
+  RouterTransformNone = 0,
+  RouterTransformInvert,
+  // Values below threshold become 0; with binary set, the others become 255
+  RouterTransformGate,
+  // value * gain / 16 + offset, clamped to 0-255
+  RouterTransformGainOffset,
+  // Exponential curve through 0 and 255; steepness in tenths, negative bends the other way
+  RouterTransformCurve,
+  // Switches to 255 above threshold_high and back to 0 below threshold, holding in between
+  RouterTransformHysteresis,
+  // Rounds to one of steps evenly spaced levels, from 0 to 255
+  RouterTransformQuantize,
+} RouterTransformType;
+
+typedef struct RouterTransform {
+  RouterTransformType type;
+  uint8_t threshold;
+  uint8_t threshold_high;
+  bool binary;
+  int16_t gain;
+  int16_t offset;
+  int8_t steepness;
+  uint8_t steps;
+} RouterTransform;
+
+// When a route writes the values it produces
+typedef enum {
+  // As soon as they are produced
+  RouterOperatorNone = 0,
+  // period_ms after they are produced
+  RouterOperatorDelay,
+  // Once every period_ms, the latest value only
+  RouterOperatorSampleHold,
+  // As soon as they are produced, except that a 0 waits until period_ms after the last non-zero
+  // value, so short pulses are not lost
+  RouterOperatorPulseStretch,
+  // The route ignores its inputs and produces a wave of period_ms
+  RouterOperatorLfo,
+} RouterOperatorType;
+
+typedef enum {
+  RouterWaveSquare = 0,
+  RouterWaveSaw,
+  RouterWaveSine,
+} RouterWave;
+
+typedef struct RouterOperator {
+  RouterOperatorType type;
+  uint16_t period_ms;
+  // Wave of RouterOperatorLfo
+  RouterWave wave;
+} RouterOperator;
+
+typedef struct RouterRouteConfig {
+  // Mask of the input channels feeding the route, may be empty with RouterOperatorLfo
+  uint8_t inputs;
+  // Mask of the output channels driven by the route
+  uint8_t outputs;
+  RouterCombine combine;
+  RouterTransform transform;
+  RouterOperator operator;
+} RouterRouteConfig;
+
+// Counters kept per route since the last router_start()
+typedef struct RouterRouteStats {
+  // Values acknowledged by the output
+  uint32_t samples;
+  // Values superseded by a newer one, or lost to a failed transfer, before reaching the output
+  uint32_t dropped;
+  // Writes sent again because the output did not acknowledge them
+  uint32_t retries;
+  // End-to-end latency, measured from the input notify to the output write ACK
+  uint32_t latency_last_ms;
+  uint32_t latency_max_ms;
+  uint32_t latency_total_ms;
+} RouterRouteStats;
+
+// When the strap notifies a changed input
+typedef struct RouterNotifySchedule {
+  // Changes no larger than this are held back until max_interval_ms
+  uint8_t deadband;
+  // Shortest time between two notifies of the input
+  uint16_t min_interval_ms;
+  // Longest time a change inside the deadband is held back, 0 to hold it back for good
+  uint16_t max_interval_ms;
+} RouterNotifySchedule;
+
+typedef struct RouterNotifyConfig {
+  // Indexed top, center, bottom
+  RouterNotifySchedule channels[3];
+  // Token bucket shared by every notify: average notifies per second (0 unlimited) and burst size
+  uint8_t notifies_per_second;
+  uint8_t burst;
+} RouterNotifyConfig;
+
+/*
+ * Creates the smartstrap attributes and takes over the smartstrap handlers
+ */
+void router_init(void);
+
+/*
+ * Destroys the smartstrap attributes and stops routing. The firmware takes the routes over when
+ * the lease last written by the app runs out, a few seconds later
+ */
+void router_deinit(void);
+
+/*
+ * Removes every route. Routing stops until router_start() is called again
+ */
+void router_clear_routes(void);
+
+/*
+ * Adds a route. Any number of routes may share inputs (fan-out) or outputs; a route with several
+ * inputs merges them with its combine function (fan-in). Its operator then decides when the value
+ * is written, and its transform maps the value on the way out. The transform is compiled into a
+ * lookup table here, so it costs the same per sample whatever it is
+ *  config: the channels, combine function, transform and operator of the route
+ *  returns: the index of the new route, or -1 if the table is full, the masks are empty or the
+ *           operator could not be set up
+ */
+int router_add_route(RouterRouteConfig config);
+
+/*
+ * Compiles the route table, resets the counters and fetches the current value of every routed input.
+ * The table is also handed to the firmware, which runs it by itself a few seconds after the app
+ * stops renewing its lease: routes keep running while the app is closed, without their operators
+ * and without LFO routes
+ */
+void router_start(void);
+
+/*
+ * Writes a value to several outputs outside of any route, in a single strap write
+ *  outputs: mask of the output channels to set
+ */
+void router_write_outputs(uint8_t outputs, uint8_t value);
+
+/*
+ * Switches the strap between notifying changes and streaming every sample
+ *  sample_period_ms: sampling period of the firmware, 0 to stop streaming
+ *  samples_per_block: samples the firmware collects before notifying, up to 16
+ */
+void router_set_streaming(uint8_t sample_period_ms, uint8_t samples_per_block);
+
+/*
+ * Sets how eagerly the strap notifies changed inputs outside of streaming mode. The firmware
+ * keeps the last value it notified, so a value held back by the schedule is never lost
+ */
+void router_set_notify_config(const RouterNotifyConfig *config);
+
+/*
+ * Gets the counters of a route
+ *  returns: false if route_idx does not refer to a route
+ */
+bool router_get_route_stats(int route_idx, RouterRouteStats *stats);
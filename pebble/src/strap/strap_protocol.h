@@ -0,0 +1,82 @@
+#pragma once
+
+#include <pebble.h>
+
+// Smartstrap service and attributes exposed by arduino/smartstrap/smartstrap.ino.
+// Keep in sync with the firmware.
+#define STRAP_SERVICE_ID 0x1001
+
+#define STRAP_TOP_INPUT_ATTRIBUTE_ID 0x0001
+#define STRAP_TOP_OUTPUT_ATTRIBUTE_ID 0x0002
+#define STRAP_CENTER_INPUT_ATTRIBUTE_ID 0x0003
+#define STRAP_CENTER_OUTPUT_ATTRIBUTE_ID 0x0004
+#define STRAP_BOTTOM_INPUT_ATTRIBUTE_ID 0x0005
+#define STRAP_BOTTOM_OUTPUT_ATTRIBUTE_ID 0x0006
+#define STRAP_ALL_INPUTS_ATTRIBUTE_ID 0x0007
+#define STRAP_ALL_OUTPUTS_ATTRIBUTE_ID 0x0008
+#define STRAP_STREAM_ATTRIBUTE_ID 0x0009
+#define STRAP_STREAM_CONFIG_ATTRIBUTE_ID 0x000A
+#define STRAP_NOTIFY_CONFIG_ATTRIBUTE_ID 0x000B
+#define STRAP_LOCAL_ROUTES_ATTRIBUTE_ID 0x000C
+
+// Analog values are mapped to 0-255 by the firmware and travel as a single byte.
+#define STRAP_ATTRIBUTE_LENGTH 1
+
+// Channels are indexed top, center, bottom.
+#define STRAP_NUM_CHANNELS 3
+
+// The all-inputs attribute packs every input into one frame, little endian:
+//  [0..2] top, center and bottom values
+//  [3..4] sequence number, incremented on every notify
+//  [5..8] firmware millis() at the time of the notify
+#define STRAP_ALL_INPUTS_LENGTH 9
+#define STRAP_ALL_INPUTS_SEQUENCE_OFFSET 3
+#define STRAP_ALL_INPUTS_TIMESTAMP_OFFSET 5
+
+// The all-outputs attribute sets several outputs in one write, acknowledged once:
+//  [0] mask of the outputs to set, bit 0 top, bit 1 center, bit 2 bottom
+//  [1..3] top, center and bottom values; values outside the mask are ignored
+#define STRAP_ALL_OUTPUTS_LENGTH 4
+
+// In streaming mode the firmware samples every input at a fixed period and delivers blocks of
+// samples through the stream attribute:
+//  [0..1] sequence number of the block
+//  [2] number of samples in the block
+//  [3] samples lost to a full ring buffer since the previous block
+//  [4..] samples, each one top, center, bottom
+#define STRAP_STREAM_HEADER_LENGTH 4
+#define STRAP_STREAM_SAMPLE_LENGTH 3
+#define STRAP_STREAM_MAX_SAMPLES 16
+#define STRAP_STREAM_LENGTH (STRAP_STREAM_HEADER_LENGTH + STRAP_STREAM_SAMPLE_LENGTH * STRAP_STREAM_MAX_SAMPLES)
+
+// Stream configuration, written by the watch:
+//  [0] sample period in milliseconds, 0 turns streaming off
+//  [1] samples per block, up to STRAP_STREAM_MAX_SAMPLES
+#define STRAP_STREAM_CONFIG_LENGTH 2
+
+// Notify pacing, written by the watch, little endian. For each of top, center and bottom:
+//  [0] deadband, changes no larger than this wait for the maximum interval
+//  [1..2] minimum interval between notifies in milliseconds
+//  [3..4] maximum interval after which a change inside the deadband is notified anyway, 0 never
+// followed by the token bucket shared by every notify:
+//  [15] notifies per second on average, 0 unlimited
+//  [16] notifies allowed in a burst
+#define STRAP_NOTIFY_SCHEDULE_LENGTH 5
+#define STRAP_NOTIFY_CONFIG_LENGTH (STRAP_NOTIFY_SCHEDULE_LENGTH * STRAP_NUM_CHANNELS + 2)
+
+// Routes the firmware runs by itself once the watch stops driving the outputs, written by the
+// watch, little endian:
+//  [0..1] lease in milliseconds: the firmware leaves routing to the watch until it runs out, and
+//         takes over unless another write renews it. 0 hands routing over straight away
+//  [2] number of routes, up to STRAP_LOCAL_ROUTES_MAX
+// followed by, for each route:
+//  [0] input mask, [1] output mask, bit 0 top, bit 1 center, bit 2 bottom
+//  [2] combine function, 0 max, 1 min
+//  [3] transform type, [4] threshold, [5] high threshold, [6] binary, [7] steps, [8] steepness
+//  [9..10] gain in sixteenths, [11..12] offset, both signed
+// The firmware has no operators, and approximates the curve transform with a parabola.
+#define STRAP_LOCAL_ROUTES_HEADER_LENGTH 3
+#define STRAP_LOCAL_ROUTE_LENGTH 13
+#define STRAP_LOCAL_ROUTES_MAX 8
+#define STRAP_LOCAL_ROUTES_MAX_LENGTH \
+  (STRAP_LOCAL_ROUTES_HEADER_LENGTH + STRAP_LOCAL_ROUTE_LENGTH * STRAP_LOCAL_ROUTES_MAX)
@@ -0,0 +1,145 @@
+#include <pebble.h>
+#include "telemetry.h"
+
+// Bytes of the dump per log line; APP_LOG truncates long messages
+#define LOG_BYTES_PER_LINE 32
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+typedef struct {
+  uint32_t time_ms;
+  uint8_t type;
+  uint8_t attribute_id;
+  uint8_t result;
+  uint8_t value;
+} TelemetryEvent;
+
+_Static_assert(sizeof(TelemetryEvent) == TELEMETRY_EVENT_LENGTH, "telemetry events are 8 bytes");
+
+static TelemetryEvent s_events[TELEMETRY_NUM_EVENTS];
+// Events ever recorded; the newest is at (s_count - 1) % TELEMETRY_NUM_EVENTS
+static uint32_t s_count;
+
+static uint32_t prv_now_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+static void prv_write_uint16(uint8_t *data, uint16_t value) {
+  data[0] = value & 0xff;
+  data[1] = value >> 8;
+}
+
+static void prv_write_uint32(uint8_t *data, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    data[i] = (value >> (8 * i)) & 0xff;
+  }
+}
+
+void telemetry_record(TelemetryEventType type, SmartstrapAttributeId attribute_id, uint8_t result,
+                      uint8_t value) {
+  s_events[s_count % TELEMETRY_NUM_EVENTS] = (TelemetryEvent) {
+    .time_ms = prv_now_ms(),
+    .type = type,
+    .attribute_id = attribute_id,
+    .result = result,
+    .value = value,
+  };
+  s_count++;
+}
+
+void telemetry_clear(void) {
+  s_count = 0;
+}
+
+// Cuts the dump into persisted chunks as it is produced, so it never sits whole on the stack
+typedef struct {
+  uint8_t chunk[PERSIST_DATA_MAX_LENGTH];
+  size_t length;
+  int key;
+  bool failed;
+} DumpWriter;
+
+static void prv_flush_chunk(DumpWriter *writer) {
+  if (!writer->length) {
+    return;
+  }
+  if (persist_write_data(TELEMETRY_PERSIST_KEY + writer->key, writer->chunk, writer->length) < 0) {
+    writer->failed = true;
+  }
+  writer->key++;
+  writer->length = 0;
+}
+
+static void prv_put_bytes(DumpWriter *writer, const uint8_t *bytes, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    writer->chunk[writer->length++] = bytes[i];
+    if (writer->length == sizeof(writer->chunk)) {
+      prv_flush_chunk(writer);
+    }
+  }
+}
+
+int telemetry_dump(void) {
+  const uint32_t num_events = MIN(s_count, TELEMETRY_NUM_EVENTS);
+  const uint32_t first = s_count - num_events;
+  DumpWriter writer = { .length = 0 };
+
+  uint8_t header[TELEMETRY_HEADER_LENGTH];
+  prv_write_uint32(&header[0], TELEMETRY_MAGIC);
+  header[4] = TELEMETRY_VERSION;
+  header[5] = TELEMETRY_EVENT_LENGTH;
+  prv_write_uint16(&header[6], num_events);
+  prv_write_uint32(&header[8], first);
+  prv_write_uint32(&header[12], prv_now_ms());
+  prv_put_bytes(&writer, header, sizeof(header));
+
+  for (uint32_t i = first; i < s_count; i++) {
+    const TelemetryEvent *event = &s_events[i % TELEMETRY_NUM_EVENTS];
+    uint8_t packed[TELEMETRY_EVENT_LENGTH];
+    prv_write_uint32(&packed[0], event->time_ms);
+    packed[4] = event->type;
+    packed[5] = event->attribute_id;
+    packed[6] = event->result;
+    packed[7] = event->value;
+    prv_put_bytes(&writer, packed, sizeof(packed));
+  }
+  prv_flush_chunk(&writer);
+
+  // A shorter dump leaves no stale chunks behind
+  for (int key = writer.key; key < TELEMETRY_PERSIST_NUM_KEYS; key++) {
+    persist_delete(TELEMETRY_PERSIST_KEY + key);
+  }
+  return writer.failed ? -1 : (int)num_events;
+}
+
+bool telemetry_log_dump(void) {
+  if (!persist_exists(TELEMETRY_PERSIST_KEY)) {
+    return false;
+  }
+
+  static const char HEX[] = "0123456789abcdef";
+  uint8_t chunk[PERSIST_DATA_MAX_LENGTH];
+  char line[2 * LOG_BYTES_PER_LINE + 1];
+  uint32_t offset = 0;
+  for (int key = 0; key < TELEMETRY_PERSIST_NUM_KEYS; key++) {
+    const int chunk_length = persist_read_data(TELEMETRY_PERSIST_KEY + key, chunk, sizeof(chunk));
+    if (chunk_length <= 0) {
+      break;
+    }
+    for (int i = 0; i < chunk_length; i += LOG_BYTES_PER_LINE) {
+      const int line_bytes = MIN(chunk_length - i, LOG_BYTES_PER_LINE);
+      for (int b = 0; b < line_bytes; b++) {
+        line[2 * b] = HEX[chunk[i + b] >> 4];
+        line[2 * b + 1] = HEX[chunk[i + b] & 0xf];
+      }
+      line[2 * line_bytes] = '\0';
+      // The offset lets the decoder spot lines the log dropped
+      APP_LOG(APP_LOG_LEVEL_INFO, "TLM %04x %s", (unsigned)offset, line);
+      offset += line_bytes;
+    }
+  }
+  return true;
+}
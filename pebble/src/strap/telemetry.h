@@ -0,0 +1,71 @@
+#pragma once
+
+#include <pebble.h>
+
+// Fixed-size binary recorder of smartstrap traffic. Recording an event stores 8 bytes in a ring
+// buffer, with no formatting and no allocation; once the ring is full the oldest events are
+// overwritten. A dump copies the ring to persistent storage, where it survives the app being
+// closed, and can be written to the app log for host/tools/telemetry_decode to turn into
+// timelines and latency histograms.
+//
+// Dump layout, little endian, split into PERSIST_DATA_MAX_LENGTH chunks stored under consecutive
+// keys from TELEMETRY_PERSIST_KEY:
+//  [0..3] TELEMETRY_MAGIC
+//  [4] TELEMETRY_VERSION
+//  [5] size of an event, 8
+//  [6..7] number of events
+//  [8..11] events overwritten before the dump
+//  [12..15] time of the dump in milliseconds
+//  [16..] events, oldest first, each:
+//    [0..3] time in milliseconds, from time_ms()
+//    [4] TelemetryEventType
+//    [5] attribute ID
+//    [6] SmartstrapResult, or 0
+//    [7] first byte written or read, or 0
+
+#define TELEMETRY_MAGIC 0x4c544250 // "PBTL"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_NUM_EVENTS 128
+#define TELEMETRY_HEADER_LENGTH 16
+#define TELEMETRY_EVENT_LENGTH 8
+#define TELEMETRY_DUMP_LENGTH (TELEMETRY_HEADER_LENGTH + TELEMETRY_NUM_EVENTS * TELEMETRY_EVENT_LENGTH)
+#define TELEMETRY_PERSIST_KEY 0x5000
+#define TELEMETRY_PERSIST_NUM_KEYS \
+  ((TELEMETRY_DUMP_LENGTH + PERSIST_DATA_MAX_LENGTH - 1) / PERSIST_DATA_MAX_LENGTH)
+
+typedef enum {
+  TelemetryEventNotify = 1,
+  TelemetryEventReadBegin,
+  TelemetryEventReadEnd,
+  TelemetryEventWriteBegin,
+  TelemetryEventWriteEnd,
+  // A read or write the smartstrap API refused to start, usually with SmartstrapResultBusy
+  TelemetryEventBusy,
+  // A failed read or write queued to be attempted again
+  TelemetryEventRetry,
+} TelemetryEventType;
+
+/*
+ * Records an event
+ *  result: the SmartstrapResult of an end or busy event, 0 otherwise
+ *  value: first byte written or read, 0 if there is none
+ */
+void telemetry_record(TelemetryEventType type, SmartstrapAttributeId attribute_id, uint8_t result,
+                      uint8_t value);
+
+/*
+ * Forgets every recorded event
+ */
+void telemetry_clear(void);
+
+/*
+ * Copies the recorded events to persistent storage, replacing the previous dump
+ *  returns: the number of events saved, or -1 if storage failed
+ */
+int telemetry_dump(void);
+
+/*
+ * Writes the saved dump to the app log as hex lines tagged "TLM", for the host decoder
+ *  returns: false if there is no dump
+ */
+bool telemetry_log_dump(void);
@@ -0,0 +1,96 @@
+#include <pebble.h>
+#include "transform.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+
+static uint8_t prv_clamp(int32_t value) {
+  return MIN(MAX(value, 0), 255);
+}
+
+// e^x for the few dozen calls a table takes: halve x into range, Taylor series, square back up
+static float prv_exp(float x) {
+  int halvings = 0;
+  while (x > 0.5f || x < -0.5f) {
+    x /= 2;
+    halvings++;
+  }
+  float term = 1;
+  float sum = 1;
+  for (int n = 1; n < 8; n++) {
+    term *= x / n;
+    sum += term;
+  }
+  while (halvings--) {
+    sum *= sum;
+  }
+  return sum;
+}
+
+// Curve through (0, 0) and (255, 255); bends down for a positive rate and up for a negative one
+static void prv_compile_curve(int8_t steepness, uint8_t *lut) {
+  const float rate = (steepness < 0 ? -steepness : steepness) / 10.0f;
+  if (rate == 0) {
+    for (int v = 0; v < TRANSFORM_LUT_SIZE; v++) {
+      lut[v] = v;
+    }
+    return;
+  }
+
+  // Consecutive entries of e^(rate * v / 255) differ by a constant factor
+  const float step = prv_exp(rate / 255);
+  const float scale = 255 / (prv_exp(rate) - 1);
+  float power = 1;
+  for (int v = 0; v < TRANSFORM_LUT_SIZE; v++, power *= step) {
+    const uint8_t value = prv_clamp((int32_t)((power - 1) * scale + 0.5f));
+    if (steepness > 0) {
+      lut[v] = value;
+    } else {
+      lut[255 - v] = 255 - value;
+    }
+  }
+}
+
+bool transform_compile(const RouterTransform *transform, uint8_t lut[TRANSFORM_LUT_SIZE]) {
+  switch (transform->type) {
+    case RouterTransformInvert:
+      for (int v = 0; v < TRANSFORM_LUT_SIZE; v++) {
+        lut[v] = 255 - v;
+      }
+      return false;
+    case RouterTransformGate:
+      for (int v = 0; v < TRANSFORM_LUT_SIZE; v++) {
+        lut[v] = (v < transform->threshold) ? 0 : (transform->binary ? 255 : v);
+      }
+      return false;
+    case RouterTransformGainOffset:
+      for (int v = 0; v < TRANSFORM_LUT_SIZE; v++) {
+        lut[v] = prv_clamp(v * transform->gain / 16 + transform->offset);
+      }
+      return false;
+    case RouterTransformCurve:
+      prv_compile_curve(transform->steepness, lut);
+      return false;
+    case RouterTransformHysteresis: {
+        const uint8_t low = MIN(transform->threshold, transform->threshold_high);
+        const uint8_t high = MAX(transform->threshold, transform->threshold_high);
+        for (int v = 0; v < TRANSFORM_LUT_SIZE; v++) {
+          lut[v] = (v < low) ? 0 : (v > high) ? 255 : TRANSFORM_HOLD;
+        }
+      }
+      return true;
+    case RouterTransformQuantize: {
+        const int intervals = MAX(transform->steps, 2) - 1;
+        for (int v = 0; v < TRANSFORM_LUT_SIZE; v++) {
+          lut[v] = (v * intervals + 127) / 255 * 255 / intervals;
+        }
+      }
+      return false;
+    case RouterTransformNone:
+    default:
+      for (int v = 0; v < TRANSFORM_LUT_SIZE; v++) {
+        lut[v] = v;
+      }
+      return false;
+  }
+}
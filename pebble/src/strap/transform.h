@@ -0,0 +1,17 @@
+#pragma once
+
+#include <pebble.h>
+#include "router.h"
+
+#define TRANSFORM_LUT_SIZE 256
+
+// Table entry that keeps the previous output. Only hysteresis tables use it, and they otherwise
+// hold nothing but 0 and 255
+#define TRANSFORM_HOLD 1
+
+/*
+ * Compiles a transform into a lookup table from input value to output value
+ *  returns: true if the table has TRANSFORM_HOLD entries, which the caller must resolve to the
+ *           value it last wrote
+ */
+bool transform_compile(const RouterTransform *transform, uint8_t lut[TRANSFORM_LUT_SIZE]);